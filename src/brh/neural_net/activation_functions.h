@@ -4,16 +4,140 @@
 #include <cmath>
 
 #include "common.h"
+#include "activation_kernels.h"
 
 namespace brh {
 	namespace neural {
 
-FloatType softStep(FloatType value) {
+inline FloatType softStep(FloatType value) {
 	//std::cout << value << '\n';
-	return static_cast<FloatType>(1.0 / (1 + std::pow(MATH_E, -value)));
+	return activation::sigmoid<activation::Accuracy::exact>(value);
 }
 
 
+/// Activation functors, passed as a type so the call inlines into the
+/// layer loops instead of going through a FunctionType per neuron.
+/// Each applies to a single value or in place to a whole layer at once.
+/// derivative takes the activated outputs, as a backward pass has them.
+struct SoftStep
+{
+	FloatType operator()(FloatType value) const {
+		return softStep(value);
+	}
+
+	void operator()(FloatType * values, std::size_t count) const {
+		activation::sigmoid<activation::Accuracy::exact>(values, count);
+	}
+
+	void derivative(FloatType const * outputs,
+	                FloatType       * derivatives,
+	                std::size_t       count) const {
+		activation::sigmoidDerivative(outputs, derivatives, count);
+	}
+};
+
+template <activation::Accuracy t_ACCURACY = activation::Accuracy::polynomial>
+struct Sigmoid
+{
+	FloatType operator()(FloatType value) const {
+		return activation::sigmoid<t_ACCURACY>(value);
+	}
+
+	void operator()(FloatType * values, std::size_t count) const {
+		activation::sigmoid<t_ACCURACY>(values, count);
+	}
+
+	void derivative(FloatType const * outputs,
+	                FloatType       * derivatives,
+	                std::size_t       count) const {
+		activation::sigmoidDerivative(outputs, derivatives, count);
+	}
+};
+
+template <activation::Accuracy t_ACCURACY = activation::Accuracy::polynomial>
+struct Tanh
+{
+	FloatType operator()(FloatType value) const {
+		return activation::tanh<t_ACCURACY>(value);
+	}
+
+	void operator()(FloatType * values, std::size_t count) const {
+		activation::tanh<t_ACCURACY>(values, count);
+	}
+
+	void derivative(FloatType const * outputs,
+	                FloatType       * derivatives,
+	                std::size_t       count) const {
+		activation::tanhDerivative(outputs, derivatives, count);
+	}
+};
+
+struct Relu
+{
+	FloatType operator()(FloatType value) const {
+		return value > 0 ? value : 0;
+	}
+
+	void operator()(FloatType * values, std::size_t count) const {
+		activation::relu(values, count);
+	}
+
+	void derivative(FloatType const * outputs,
+	                FloatType       * derivatives,
+	                std::size_t       count) const {
+		activation::reluDerivative(outputs, derivatives, count);
+	}
+};
+
+class LeakyRelu
+{
+	public:
+		LeakyRelu(FloatType slope = 0.01f) : slope_ {slope} {}
+
+		FloatType operator()(FloatType value) const {
+			return value > 0 ? value : value * slope_;
+		}
+
+		void operator()(FloatType * values, std::size_t count) const {
+			activation::leakyRelu(values, count, slope_);
+		}
+
+		void derivative(FloatType const * outputs,
+		                FloatType       * derivatives,
+		                std::size_t       count) const {
+			activation::leakyReluDerivative(outputs, derivatives, count, slope_);
+		}
+
+
+	private:
+		FloatType slope_;
+};
+
+
+/// Type-erased adapter for callers that only know the activation at
+/// runtime. Every call goes through the wrapped FunctionType.
+class RuntimeActivation
+{
+	public:
+		RuntimeActivation() : RuntimeActivation(softStep) {}
+		RuntimeActivation(FunctionType function) :
+			function_ (std::move(function)) {}
+
+		FloatType operator()(FloatType value) const {
+			return function_(value);
+		}
+
+		void operator()(FloatType * values, std::size_t count) const {
+			for (std::size_t i {0}; i < count; ++i)
+				values[i] = function_(values[i]);
+		}
+
+
+	private:
+		FunctionType function_;
+};
+
+
 
 	}
 }
@@ -0,0 +1,259 @@
+#ifndef NEURAL_NET_TESTING_ACTIVATION_KERNELS_H
+#define NEURAL_NET_TESTING_ACTIVATION_KERNELS_H
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "cpu_dispatch.h"
+
+namespace brh {
+	namespace neural {
+		namespace activation {
+
+/// Activations applied in place over a whole layer's values at once.
+///
+/// Accuracy tiers, max absolute error against the double precision result
+/// measured over [-20, 20]:
+///  exact      - std::exp / std::tanh.
+///               sigmoid 9e-8, tanh 1.1e-7.
+///  polynomial - range-reduced exp with a degree 6 polynomial, vectorized
+///               for the host's instruction set, see cpu_dispatch.h.
+///               sigmoid 9e-8, tanh 1.8e-7.
+///  table      - linear interpolation in a 4097 entry sigmoid table over
+///               [-16, 16], inputs outside are clamped.
+///               sigmoid 7.8e-7, tanh 1.6e-6.
+enum class Accuracy
+{
+	exact,
+	polynomial,
+	table
+};
+
+
+namespace detail {
+
+constexpr float EXP_MAX  { 88.3762626647949f};
+constexpr float EXP_MIN  {-87.3365478515625f};
+constexpr float LOG2E    {1.44269504088896341f};
+constexpr float LN2_HIGH {0.693359375f};
+constexpr float LN2_LOW  {-2.12194440e-4f};
+
+constexpr float EXP_P0 {1.9875691500E-4f};
+constexpr float EXP_P1 {1.3981999507E-3f};
+constexpr float EXP_P2 {8.3334519073E-3f};
+constexpr float EXP_P3 {4.1665795894E-2f};
+constexpr float EXP_P4 {1.6666665459E-1f};
+constexpr float EXP_P5 {5.0000001201E-1f};
+
+constexpr float       TABLE_RANGE      {16.0f};
+constexpr std::size_t TABLE_STEPS_PER_UNIT {128};
+constexpr std::size_t TABLE_SIZE {
+	static_cast<std::size_t>(2 * TABLE_RANGE) * TABLE_STEPS_PER_UNIT
+};
+
+
+/// Scalar version of the polynomial exp. The vectorized kernels in
+/// kernels_<isa>.cpp repeat it operation for operation, so they give
+/// bit-identical results.
+inline float expPolynomial(float x) {
+	x = std::min(std::max(x, EXP_MIN), EXP_MAX);
+
+	float const n {std::floor(x * LOG2E + 0.5f)};
+	x -= n * LN2_HIGH;
+	x -= n * LN2_LOW;
+
+	float const z {x * x};
+	float y {EXP_P0};
+	y = y * x + EXP_P1;
+	y = y * x + EXP_P2;
+	y = y * x + EXP_P3;
+	y = y * x + EXP_P4;
+	y = y * x + EXP_P5;
+	y = y * z + x + 1.0f;
+
+	std::int32_t const bits {(static_cast<std::int32_t>(n) + 127) << 23};
+	float scale;
+	std::memcpy(&scale, &bits, sizeof scale);
+
+	return y * scale;
+}
+
+inline float sigmoidPolynomial(float x) {
+	return 1.0f / (1.0f + expPolynomial(-x));
+}
+
+
+struct SigmoidTable
+{
+	SigmoidTable() {
+		for (std::size_t i {0}; i <= TABLE_SIZE; ++i) {
+			double const x {
+				-TABLE_RANGE + static_cast<double>(i) / TABLE_STEPS_PER_UNIT
+			};
+			values[i] = static_cast<float>(1.0 / (1.0 + std::exp(-x)));
+		}
+	}
+
+	std::array<float, TABLE_SIZE + 1> values;
+};
+
+inline SigmoidTable const & getSigmoidTable() {
+	static SigmoidTable const table;
+	return table;
+}
+
+inline float sigmoidTable(float const * table, float x) {
+	x = std::min(std::max(x, -TABLE_RANGE), TABLE_RANGE);
+
+	float const position {(x + TABLE_RANGE) * TABLE_STEPS_PER_UNIT};
+	std::size_t const index {
+		std::min(static_cast<std::size_t>(position), TABLE_SIZE - 1)
+	};
+	float const fraction {position - static_cast<float>(index)};
+
+	return table[index] + fraction * (table[index + 1] - table[index]);
+}
+
+}
+
+
+/// Scalar sigmoid, for single values and the tails of the array kernels.
+template <Accuracy t_ACCURACY = Accuracy::polynomial>
+float sigmoid(float x) {
+	switch (t_ACCURACY) {
+		case Accuracy::exact:
+			return 1.0f / (1.0f + std::exp(-x));
+		case Accuracy::polynomial:
+			return detail::sigmoidPolynomial(x);
+		case Accuracy::table:
+			return detail::sigmoidTable(detail::getSigmoidTable().values.data(), x);
+	}
+
+	return 0;
+}
+
+template <Accuracy t_ACCURACY = Accuracy::polynomial>
+float tanh(float x) {
+	if (t_ACCURACY == Accuracy::exact)
+		return std::tanh(x);
+
+	return 2.0f * sigmoid<t_ACCURACY>(2.0f * x) - 1.0f;
+}
+
+
+/// The polynomial tier runs the kernel getKernels() picked for the host.
+template <Accuracy t_ACCURACY = Accuracy::polynomial>
+void sigmoid(float * values, std::size_t count) {
+	std::size_t i {0};
+
+	if (t_ACCURACY == Accuracy::polynomial) {
+		getKernels().sigmoid(values, count);
+		return;
+	}
+
+	if (t_ACCURACY == Accuracy::table) {
+		float const * table {detail::getSigmoidTable().values.data()};
+
+		for (; i < count; ++i)
+			values[i] = detail::sigmoidTable(table, values[i]);
+	}
+
+	for (; i < count; ++i)
+		values[i] = sigmoid<t_ACCURACY>(values[i]);
+}
+
+template <Accuracy t_ACCURACY = Accuracy::polynomial>
+void tanh(float * values, std::size_t count) {
+	if (t_ACCURACY == Accuracy::exact) {
+		for (std::size_t i {0}; i < count; ++i)
+			values[i] = std::tanh(values[i]);
+
+		return;
+	}
+
+	// tanh(x) = 2 * sigmoid(2x) - 1
+	for (std::size_t i {0}; i < count; ++i)
+		values[i] *= 2.0f;
+
+	sigmoid<t_ACCURACY>(values, count);
+
+	for (std::size_t i {0}; i < count; ++i)
+		values[i] = 2.0f * values[i] - 1.0f;
+}
+
+inline void relu(float * values, std::size_t count) {
+	std::size_t i {0};
+
+#ifdef __SSE2__
+	__m128 const zero = _mm_setzero_ps();
+
+	for (; i + 4 <= count; i += 4) {
+		_mm_storeu_ps(values + i, _mm_max_ps(_mm_loadu_ps(values + i), zero));
+	}
+#endif
+
+	for (; i < count; ++i)
+		values[i] = std::max(values[i], 0.0f);
+}
+
+/// @param slope Gradient for negative inputs, expected to be in [0, 1].
+inline void leakyRelu(float * values, std::size_t count, float slope) {
+	std::size_t i {0};
+
+#ifdef __SSE2__
+	__m128 const slopes = _mm_set1_ps(slope);
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 const x = _mm_loadu_ps(values + i);
+		_mm_storeu_ps(values + i, _mm_max_ps(x, _mm_mul_ps(x, slopes)));
+	}
+#endif
+
+	for (; i < count; ++i)
+		values[i] = std::max(values[i], values[i] * slope);
+}
+
+
+/// Derivatives are computed from the activated outputs, which is what a
+/// backward pass has at hand.
+inline void sigmoidDerivative(float const * outputs,
+                              float       * derivatives,
+                              std::size_t   count) {
+	for (std::size_t i {0}; i < count; ++i)
+		derivatives[i] = outputs[i] * (1.0f - outputs[i]);
+}
+
+inline void tanhDerivative(float const * outputs,
+                           float       * derivatives,
+                           std::size_t   count) {
+	for (std::size_t i {0}; i < count; ++i)
+		derivatives[i] = 1.0f - outputs[i] * outputs[i];
+}
+
+inline void reluDerivative(float const * outputs,
+                           float       * derivatives,
+                           std::size_t   count) {
+	for (std::size_t i {0}; i < count; ++i)
+		derivatives[i] = outputs[i] > 0.0f ? 1.0f : 0.0f;
+}
+
+inline void leakyReluDerivative(float const * outputs,
+                                float       * derivatives,
+                                std::size_t   count,
+                                float         slope) {
+	for (std::size_t i {0}; i < count; ++i)
+		derivatives[i] = outputs[i] > 0.0f ? 1.0f : slope;
+}
+
+		}
+	}
+}
+
+#endif
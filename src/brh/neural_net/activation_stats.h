@@ -0,0 +1,325 @@
+#ifndef NEURAL_NET_TESTING_ACTIVATION_STATS_H
+#define NEURAL_NET_TESTING_ACTIVATION_STATS_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "common.h"
+
+namespace brh {
+	namespace neural {
+
+/// Plain snapshot of the values seen at one point, mergeable across threads.
+struct ValueSummary
+{
+	static constexpr std::size_t BIN_COUNT {64};
+
+	ValueSummary(FloatType rangeMin, FloatType rangeMax) :
+		histogramMin {rangeMin},
+		histogramMax {rangeMax},
+		count        {0},
+		sum          {0},
+		min          {std::numeric_limits<FloatType>::max()},
+		max          {std::numeric_limits<FloatType>::lowest()},
+		underflow    {0},
+		overflow     {0},
+		bins         {} {}
+
+	double getMean() const {
+		return count == 0 ? 0 : sum / static_cast<double>(count);
+	}
+
+	void merge(ValueSummary const & other) {
+		count     += other.count;
+		sum       += other.sum;
+		min        = std::min(min, other.min);
+		max        = std::max(max, other.max);
+		underflow += other.underflow;
+		overflow  += other.overflow;
+
+		for (std::size_t i {0}; i < BIN_COUNT; ++i)
+			bins[i] += other.bins[i];
+	}
+
+	void print(std::ostream & stream) const {
+		stream << "count " << count << " mean " << getMean()
+		       << " min " << min << " max " << max << '\n';
+
+		auto const binWidth = (histogramMax - histogramMin) / BIN_COUNT;
+
+		stream << "  < " << histogramMin << ": " << underflow << '\n';
+
+		for (std::size_t i {0}; i < BIN_COUNT; ++i) {
+			if (bins[i] == 0)
+				continue;
+
+			stream << "  [" << histogramMin + binWidth * i << ", "
+			       << histogramMin + binWidth * (i + 1) << "): " << bins[i] << '\n';
+		}
+
+		stream << "  >= " << histogramMax << ": " << overflow << '\n';
+	}
+
+	FloatType histogramMin;
+	FloatType histogramMax;
+
+	std::uint64_t count;
+	double        sum;
+	FloatType     min;
+	FloatType     max;
+	std::uint64_t underflow;
+	std::uint64_t overflow;
+
+	std::array<std::uint64_t, BIN_COUNT> bins;
+};
+
+
+/// Counters written by a single thread and read by any.
+/// Updates are relaxed loads and stores rather than read-modify-writes,
+/// the owning thread being the only writer.
+class ValueStats
+{
+	public:
+		using Counter = std::atomic<std::uint64_t>;
+
+		ValueStats(FloatType histogramMin, FloatType histogramMax) :
+			histogramMin_ {histogramMin},
+			histogramMax_ {histogramMax},
+			binScale_     {ValueSummary::BIN_COUNT / (histogramMax - histogramMin)} {
+			reset();
+		}
+
+		void record(FloatType value) {
+			increment(count_);
+			sum_.store(sum_.load(std::memory_order_relaxed) + value,
+			           std::memory_order_relaxed);
+
+			if (value < min_.load(std::memory_order_relaxed))
+				min_.store(value, std::memory_order_relaxed);
+
+			if (value > max_.load(std::memory_order_relaxed))
+				max_.store(value, std::memory_order_relaxed);
+
+			if (value < histogramMin_) {
+				increment(underflow_);
+			}
+			else if (value >= histogramMax_) {
+				increment(overflow_);
+			}
+			else {
+				auto bin = static_cast<std::size_t>((value - histogramMin_) * binScale_);
+				increment(bins_[std::min(bin, ValueSummary::BIN_COUNT - 1)]);
+			}
+		}
+
+		void addTo(ValueSummary & summary) const {
+			ValueSummary own {histogramMin_, histogramMax_};
+
+			own.count     = count_.load(std::memory_order_relaxed);
+			own.sum       = sum_.load(std::memory_order_relaxed);
+			own.min       = min_.load(std::memory_order_relaxed);
+			own.max       = max_.load(std::memory_order_relaxed);
+			own.underflow = underflow_.load(std::memory_order_relaxed);
+			own.overflow  = overflow_.load(std::memory_order_relaxed);
+
+			for (std::size_t i {0}; i < ValueSummary::BIN_COUNT; ++i)
+				own.bins[i] = bins_[i].load(std::memory_order_relaxed);
+
+			summary.merge(own);
+		}
+
+		void reset() {
+			count_.store(0, std::memory_order_relaxed);
+			sum_.store(0, std::memory_order_relaxed);
+			min_.store(std::numeric_limits<FloatType>::max(), std::memory_order_relaxed);
+			max_.store(std::numeric_limits<FloatType>::lowest(), std::memory_order_relaxed);
+			underflow_.store(0, std::memory_order_relaxed);
+			overflow_.store(0, std::memory_order_relaxed);
+
+			for (auto & i : bins_)
+				i.store(0, std::memory_order_relaxed);
+		}
+
+
+	private:
+		static void increment(Counter & counter) {
+			counter.store(counter.load(std::memory_order_relaxed) + 1,
+			              std::memory_order_relaxed);
+		}
+
+		FloatType histogramMin_;
+		FloatType histogramMax_;
+		FloatType binScale_;
+
+		Counter                  count_;
+		std::atomic<double>      sum_;
+		std::atomic<FloatType>   min_;
+		std::atomic<FloatType>   max_;
+		Counter                  underflow_;
+		Counter                  overflow_;
+
+		std::array<Counter, ValueSummary::BIN_COUNT> bins_;
+};
+
+
+/// Sampled statistics of pre- and post-activation values.
+///
+/// Each thread records into its own ValueStats, registered the first time
+/// the thread records anything, so the hot path takes no lock. collect()
+/// merges every thread's counters and is safe to call at any time, although
+/// it's only exact once the recording threads are idle (after execute).
+///
+/// Recording is compiled in only when BRH_NEURAL_NET_TRACE_ACTIVATIONS is
+/// defined, otherwise isEnabled() is a constant false and callers drop the
+/// tracing code entirely. At runtime it's off until a sample rate is set.
+class ActivationTracer
+{
+	public:
+#ifdef BRH_NEURAL_NET_TRACE_ACTIVATIONS
+		static constexpr bool COMPILED_IN {true};
+#else
+		static constexpr bool COMPILED_IN {false};
+#endif
+
+		static constexpr FloatType PRE_HISTOGRAM_MIN  {-16};
+		static constexpr FloatType PRE_HISTOGRAM_MAX  { 16};
+		static constexpr FloatType POST_HISTOGRAM_MIN {-1};
+		static constexpr FloatType POST_HISTOGRAM_MAX { 1};
+
+		struct Summary
+		{
+			Summary() :
+				pre  {PRE_HISTOGRAM_MIN,  PRE_HISTOGRAM_MAX},
+				post {POST_HISTOGRAM_MIN, POST_HISTOGRAM_MAX} {}
+
+			ValueSummary pre;
+			ValueSummary post;
+		};
+
+
+		static bool isEnabled() {
+			return COMPILED_IN && getSampleRate() != 0;
+		}
+
+		/// @param rate Records every rate-th value per thread, 0 disables.
+		static void setSampleRate(std::size_t rate) {
+			getState().sampleRate.store(rate, std::memory_order_relaxed);
+		}
+
+		static std::size_t getSampleRate() {
+			return getState().sampleRate.load(std::memory_order_relaxed);
+		}
+
+		/// Records the sampled subset of count pre/post activation pairs.
+		static void record(FloatType const * pre,
+		                   FloatType const * post,
+		                   std::size_t       count) {
+			auto const rate = getSampleRate();
+
+			if (!COMPILED_IN || rate == 0)
+				return;
+
+			auto & stats = getThreadStats();
+
+			std::size_t i {stats.untilNext};
+
+			for (; i < count; i += rate) {
+				stats.pre.record(pre[i]);
+				stats.post.record(post[i]);
+			}
+
+			stats.untilNext = i - count;
+		}
+
+		static Summary collect() {
+			auto & state = getState();
+			std::lock_guard<std::mutex> guard (state.mutex);
+
+			Summary summary;
+
+			for (auto const & i : state.threadStats) {
+				i->pre.addTo(summary.pre);
+				i->post.addTo(summary.post);
+			}
+
+			return summary;
+		}
+
+		static void reset() {
+			auto & state = getState();
+			std::lock_guard<std::mutex> guard (state.mutex);
+
+			for (auto & i : state.threadStats) {
+				i->pre.reset();
+				i->post.reset();
+			}
+		}
+
+		static void dump(std::ostream & stream) {
+			auto summary = collect();
+
+			stream << "pre-activation:  ";
+			summary.pre.print(stream);
+			stream << "post-activation: ";
+			summary.post.print(stream);
+		}
+
+
+	private:
+		struct ThreadStats
+		{
+			ThreadStats() :
+				pre       {PRE_HISTOGRAM_MIN,  PRE_HISTOGRAM_MAX},
+				post      {POST_HISTOGRAM_MIN, POST_HISTOGRAM_MAX},
+				untilNext {0} {}
+
+			ValueStats  pre;
+			ValueStats  post;
+
+			/// Owning thread only.
+			std::size_t untilNext;
+		};
+
+		struct State
+		{
+			State() : sampleRate {0} {}
+
+			std::atomic<std::size_t> sampleRate;
+
+			std::mutex mutex;
+			std::vector<std::unique_ptr<ThreadStats> > threadStats;
+		};
+
+		static State & getState() {
+			static State state;
+			return state;
+		}
+
+		/// Registered once per thread and owned by the state, so the counters
+		/// of threads that have since exited are still collected.
+		static ThreadStats & getThreadStats() {
+			thread_local ThreadStats * stats {nullptr};
+
+			if (stats == nullptr) {
+				auto & state = getState();
+				std::lock_guard<std::mutex> guard (state.mutex);
+
+				state.threadStats.emplace_back(new ThreadStats());
+				stats = state.threadStats.back().get();
+			}
+
+			return *stats;
+		}
+};
+
+	}
+}
+
+#endif
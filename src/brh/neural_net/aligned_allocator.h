@@ -0,0 +1,72 @@
+#ifndef NEURAL_NET_TESTING_ALIGNED_ALLOCATOR_H
+#define NEURAL_NET_TESTING_ALIGNED_ALLOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+namespace brh {
+	namespace neural {
+
+/// Standard allocator whose blocks start on a t_ALIGNMENT byte boundary,
+/// a cache line by default. The block is over-allocated and the pointer
+/// the system returned is kept just in front of the aligned start.
+template <class T, std::size_t t_ALIGNMENT = 64>
+class AlignedAllocator
+{
+	static_assert((t_ALIGNMENT & (t_ALIGNMENT - 1)) == 0,
+	              "Alignment must be a power of two");
+	static_assert(t_ALIGNMENT >= alignof(void *),
+	              "Alignment must leave room for the original pointer");
+
+	public:
+		using value_type = T;
+
+		static constexpr std::size_t ALIGNMENT {t_ALIGNMENT};
+
+		template <class U>
+		struct rebind
+		{
+			using other = AlignedAllocator<U, t_ALIGNMENT>;
+		};
+
+		AlignedAllocator() = default;
+
+		template <class U>
+		AlignedAllocator(AlignedAllocator<U, t_ALIGNMENT> const &) {}
+
+		T * allocate(std::size_t count) {
+			auto const raw = ::operator new(count * sizeof(T) + ALIGNMENT);
+
+			auto const address = reinterpret_cast<std::uintptr_t>(raw) + ALIGNMENT;
+			auto const aligned = reinterpret_cast<void **>(address & ~(ALIGNMENT - 1));
+
+			aligned[-1] = raw;
+
+			return reinterpret_cast<T *>(aligned);
+		}
+
+		void deallocate(T * memory, std::size_t) {
+			if (memory != nullptr)
+				::operator delete(reinterpret_cast<void **>(memory)[-1]);
+		}
+
+		template <class U>
+		bool operator==(AlignedAllocator<U, t_ALIGNMENT> const &) const { return true; }
+
+		template <class U>
+		bool operator!=(AlignedAllocator<U, t_ALIGNMENT> const &) const { return false; }
+};
+
+template <class T, std::size_t t_ALIGNMENT>
+constexpr std::size_t AlignedAllocator<T, t_ALIGNMENT>::ALIGNMENT;
+
+/// std::vector whose data() is cache line aligned.
+template <class T>
+using AlignedList = std::vector<T, AlignedAllocator<T> >;
+
+	}
+}
+
+#endif
@@ -0,0 +1,342 @@
+#ifndef NEURAL_NET_TESTING_ARENA_ALLOCATOR_H
+#define NEURAL_NET_TESTING_ARENA_ALLOCATOR_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace brh {
+	namespace neural {
+
+/// Region allocator for many small, short-lived objects.
+///
+/// Memory is bumped out of large slabs. Freed blocks go onto one free list
+/// per power-of-two size class and are handed out again before the slab is
+/// touched, so lists growing and reallocating keep recycling the same
+/// memory. Nothing is returned to the system until reset or release, which
+/// drop everything at once without visiting the individual blocks.
+class Arena
+{
+	public:
+		static constexpr std::size_t DEFAULT_SLAB_SIZE {256 * 1024};
+
+		/// Size classes run from 16 bytes up to 16 << (CLASS_COUNT - 1),
+		/// larger blocks are bumped out of the slab but never recycled.
+		static constexpr std::size_t MIN_CLASS_SIZE {16};
+		static constexpr std::size_t CLASS_COUNT    {12};
+
+		/// Every block is aligned for any fundamental type.
+		static constexpr std::size_t ALIGNMENT {alignof(std::max_align_t)};
+
+		explicit Arena(std::size_t slabSize = DEFAULT_SLAB_SIZE) :
+			slabSize_  {slabSize},
+			slabs_     {nullptr},
+			current_   {nullptr},
+			end_       {nullptr},
+			slabCount_ {0} {
+			clearFreeLists();
+		}
+
+		Arena(Arena const &) = delete;
+		Arena & operator=(Arena const &) = delete;
+
+		~Arena() {
+			release();
+		}
+
+		void * allocate(std::size_t size, std::size_t alignment = ALIGNMENT) {
+			assert(alignment <= ALIGNMENT);
+			(void)alignment;
+
+			auto const sizeClass = getSizeClass(size);
+
+			if (sizeClass < CLASS_COUNT) {
+				if (FreeBlock * block = freeLists_[sizeClass]) {
+					freeLists_[sizeClass] = block->next;
+					return block;
+				}
+
+				return bump(getClassSize(sizeClass));
+			}
+
+			return bump(roundUp(size));
+		}
+
+		/// Makes the block available to later allocations of its size class.
+		/// @param size The size it was allocated with.
+		void deallocate(void * memory, std::size_t size) {
+			auto const sizeClass = getSizeClass(size);
+
+			if (memory == nullptr || sizeClass >= CLASS_COUNT)
+				return;
+
+			auto block = static_cast<FreeBlock *>(memory);
+			block->next = freeLists_[sizeClass];
+			freeLists_[sizeClass] = block;
+		}
+
+		/// Forgets every allocation but keeps one slab to carve the next
+		/// ones from, so an arena reused for graph after graph stops
+		/// calling malloc once it's warm.
+		void reset() {
+			Slab * kept {nullptr};
+
+			while (slabs_ != nullptr) {
+				Slab * previous {slabs_->previous};
+
+				if (kept == nullptr && slabs_->size == slabSize_) {
+					kept = slabs_;
+				}
+				else {
+					std::free(slabs_);
+					--slabCount_;
+				}
+
+				slabs_ = previous;
+			}
+
+			slabs_ = kept;
+
+			if (kept != nullptr) {
+				kept->previous = nullptr;
+				current_ = getSlabBegin(kept);
+				end_     = reinterpret_cast<char *>(kept) + kept->size;
+			}
+			else {
+				current_ = end_ = nullptr;
+			}
+
+			clearFreeLists();
+		}
+
+		/// Returns every slab to the system.
+		void release() {
+			while (slabs_ != nullptr) {
+				Slab * previous {slabs_->previous};
+				std::free(slabs_);
+				slabs_ = previous;
+			}
+
+			current_ = end_ = nullptr;
+			slabCount_ = 0;
+
+			clearFreeLists();
+		}
+
+		std::size_t getSlabSize()  const { return slabSize_; }
+		std::size_t getSlabCount() const { return slabCount_; }
+
+
+	private:
+		struct FreeBlock
+		{
+			FreeBlock * next;
+		};
+
+		struct Slab
+		{
+			Slab      * previous;
+			std::size_t size;
+		};
+
+		static std::size_t roundUp(std::size_t size) {
+			return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+		}
+
+		static std::size_t getClassSize(std::size_t sizeClass) {
+			return MIN_CLASS_SIZE << sizeClass;
+		}
+
+		/// CLASS_COUNT or above for blocks too large for the free lists.
+		static std::size_t getSizeClass(std::size_t size) {
+			std::size_t sizeClass {0};
+
+			while (sizeClass < CLASS_COUNT && getClassSize(sizeClass) < size)
+				++sizeClass;
+
+			return sizeClass;
+		}
+
+		static char * getSlabBegin(Slab * slab) {
+			return reinterpret_cast<char *>(slab) + roundUp(sizeof(Slab));
+		}
+
+		void * bump(std::size_t size) {
+			if (static_cast<std::size_t>(end_ - current_) < size)
+				addSlab(size);
+
+			void * memory {current_};
+			current_ += size;
+
+			return memory;
+		}
+
+		/// Starts a new slab, one of its own for blocks that wouldn't fit a
+		/// regular one. Whatever is left of the current slab is abandoned.
+		void addSlab(std::size_t minimumSize) {
+			auto const size = std::max(slabSize_, minimumSize + roundUp(sizeof(Slab)));
+
+			auto slab = static_cast<Slab *>(std::malloc(size));
+
+			if (slab == nullptr)
+				throw std::bad_alloc {};
+
+			slab->previous = slabs_;
+			slab->size     = size;
+
+			slabs_ = slab;
+			++slabCount_;
+
+			current_ = getSlabBegin(slab);
+			end_     = reinterpret_cast<char *>(slab) + size;
+		}
+
+		void clearFreeLists() {
+			for (auto & i : freeLists_)
+				i = nullptr;
+		}
+
+		std::size_t slabSize_;
+
+		Slab      * slabs_;
+		char      * current_;
+		char      * end_;
+		std::size_t slabCount_;
+
+		FreeBlock * freeLists_[CLASS_COUNT];
+};
+
+
+/// Standard allocator drawing from an Arena, for containers whose storage
+/// should live there. Default constructed it falls back to operator new.
+template <class T>
+class ArenaStdAllocator
+{
+	public:
+		using value_type = T;
+
+		ArenaStdAllocator() : arena_ {nullptr} {}
+		ArenaStdAllocator(Arena * arena) : arena_ {arena} {}
+
+		template <class U>
+		ArenaStdAllocator(ArenaStdAllocator<U> const & other) :
+			arena_ {other.getArena()} {}
+
+		T * allocate(std::size_t count) {
+			if (arena_ == nullptr)
+				return static_cast<T *>(::operator new(count * sizeof(T)));
+
+			return static_cast<T *>(arena_->allocate(count * sizeof(T), alignof(T)));
+		}
+
+		void deallocate(T * memory, std::size_t count) {
+			if (arena_ == nullptr)
+				::operator delete(memory);
+			else
+				arena_->deallocate(memory, count * sizeof(T));
+		}
+
+		Arena * getArena() const { return arena_; }
+
+		template <class U>
+		bool operator==(ArenaStdAllocator<U> const & other) const {
+			return arena_ == other.getArena();
+		}
+
+		template <class U>
+		bool operator!=(ArenaStdAllocator<U> const & other) const {
+			return arena_ != other.getArena();
+		}
+
+
+	private:
+		Arena * arena_;
+};
+
+/// List type for ListInterface parameters, such as dynamic::NodeBase's,
+/// whose storage comes from an Arena.
+template <class T>
+using ArenaList = std::vector<T, ArenaStdAllocator<T> >;
+
+template <class t_List>
+struct IsArenaList : std::false_type {};
+
+template <class T>
+struct IsArenaList<ArenaList<T> > : std::true_type {};
+
+
+/// Handle to an object constructed by an ArenaAllocator.
+template <class T>
+class ArenaBlock
+{
+	public:
+		ArenaBlock(T * ptr = nullptr) : ptr_ {ptr} {}
+
+		T * getPtr() const { return ptr_; }
+
+		T & operator*()  const { return *ptr_; }
+		T * operator->() const { return ptr_; }
+
+
+	private:
+		T * ptr_;
+};
+
+
+/// Allocator for dynamic::Network backed by an Arena. Objects can be
+/// destructed one at a time, or all be dropped at once by release, which
+/// skips their destructors.
+class ArenaAllocator
+{
+	public:
+		template <class T>
+		using BlockType = ArenaBlock<T>;
+
+		template <class T>
+		using StdAllocator = ArenaStdAllocator<T>;
+
+		/// The arena sits behind a pointer so the StdAllocators handed out
+		/// stay valid when the ArenaAllocator is moved.
+		explicit ArenaAllocator(std::size_t slabSize = Arena::DEFAULT_SLAB_SIZE) :
+			arena_ {new Arena(slabSize)} {}
+
+		template <class T, class ... ArgPack>
+		BlockType<T> construct(ArgPack && ... args) {
+			void * memory {arena_->allocate(sizeof(T), alignof(T))};
+			return {new (memory) T(std::forward<ArgPack>(args)...)};
+		}
+
+		template <class T>
+		void destruct(BlockType<T> block) {
+			block.getPtr()->~T();
+			arena_->deallocate(block.getPtr(), sizeof(T));
+		}
+
+		template <class T>
+		StdAllocator<T> getStdAllocator() const {
+			return {arena_.get()};
+		}
+
+		/// Drops every object at once, see Arena::reset.
+		void release() {
+			arena_->reset();
+		}
+
+		Arena       & getArena()       { return *arena_; }
+		Arena const & getArena() const { return *arena_; }
+
+
+	private:
+		std::unique_ptr<Arena> arena_;
+};
+
+	}
+}
+
+#endif
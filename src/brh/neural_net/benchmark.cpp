@@ -0,0 +1,681 @@
+// Microbenchmarks for the three engines, built as brh_neural_net_benchmark.
+//
+//  brh_neural_net_benchmark [--quick] [--json FILE] [--min-time SECONDS]
+//                           [--repetitions N] [--train] [--hogwild]
+//                           [--pipeline] [--dynamic] [--sweep]
+//
+// Every configuration of the sweep runs through layered::Network,
+// constant::HiddenGroup, constant::Network and constant::DenseNetwork.
+// Each result is the median of the repetitions, after a warm-up, next to
+// the rate a pure weight stream would reach at the measured memory
+// bandwidth.
+//
+// --train also times layered::Trainer at every thread count up to the
+// core count, in samples per second. --hogwild trains a HiddenGroup on a
+// teacher network's outputs with HogwildTrainer and its synchronous
+// baseline, from the same starting weights. --pipeline streams samples
+// through a deep layered::Network with StreamingPipeline at every stage
+// count up to the core count, next to executing them one at a time.
+// --dynamic runs an irregular compiled dynamic graph through
+// ParallelExecutor at every thread count up to the core count, next to
+// CompiledGraph::execute.
+//
+// Asking for any of those four modes runs only them; --sweep (or --json)
+// adds the engine sweep back.
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "layered.h"
+#include "layered_trainer.h"
+#include "pipeline.h"
+#include "thread_pool.h"
+#include "activation_functions.h"
+
+#include "dynamic/compiled_graph.h"
+#include "dynamic/network.h"
+#include "dynamic/node.h"
+#include "dynamic/parallel_executor.h"
+
+#include "constant/hogwild_trainer.h"
+#include "constant/network.h"
+#include "constant/node.h"
+
+using namespace brh::neural;
+using namespace brh::neural::constant;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::size_t OUTPUT_COUNT {10};
+
+struct BenchmarkConfig
+{
+	std::size_t inputWidth;
+	std::size_t layerWidth;
+	std::size_t depth;
+	std::size_t groupCount;
+
+	/// Multiply-adds per inference, one per weight.
+	std::size_t getWeightCount() const {
+		return groupCount * (
+			inputWidth * layerWidth +
+			(depth - 1) * layerWidth * layerWidth +
+			layerWidth * OUTPUT_COUNT
+		);
+	}
+};
+
+struct BenchmarkOptions
+{
+	bool        quick;
+	bool        train;
+	bool        hogwild;
+	bool        pipeline;
+	bool        dynamic;
+	bool        sweep;
+	double      minTime;
+	std::size_t repetitions;
+	std::string jsonPath;
+};
+
+struct BenchmarkResult
+{
+	std::string     engine;
+	BenchmarkConfig config;
+
+	double nsPerInference;
+	double minNsPerInference;
+	double gflops;
+	double gbps;
+
+	/// gbps over the measured memory bandwidth, above 1 once the weights
+	/// fit in cache.
+	double rooflineFraction;
+};
+
+
+double getSeconds(Clock::time_point start) {
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/// Streaming read bandwidth in GB/s, the best of a few passes over a
+/// buffer well past the last level cache.
+double measureMemoryBandwidth() {
+	constexpr std::size_t FLOAT_COUNT {32 * 1024 * 1024};
+	constexpr std::size_t PASS_COUNT  {5};
+
+	ListType buffer (FLOAT_COUNT, 1);
+	double best {0};
+
+	// Stored to, so the loop can't be optimized away.
+	FloatType volatile sink {0};
+
+	for (std::size_t pass {0}; pass < PASS_COUNT; ++pass) {
+		auto const start = Clock::now();
+
+		FloatType sums[4] {0, 0, 0, 0};
+
+		for (std::size_t i {0}; i < FLOAT_COUNT; i += 4) {
+			sums[0] += buffer[i];
+			sums[1] += buffer[i + 1];
+			sums[2] += buffer[i + 2];
+			sums[3] += buffer[i + 3];
+		}
+
+		auto const seconds = getSeconds(start);
+		sink = sums[0] + sums[1] + sums[2] + sums[3];
+
+		best = std::max(best, FLOAT_COUNT * sizeof(FloatType) / seconds / 1e9);
+	}
+
+	static_cast<void>(sink);
+
+	return best;
+}
+
+/// Median and minimum ns per call of func over the repetitions. Each
+/// repetition calls func as often as fits in minTime / repetitions,
+/// sized by a warm-up lasting at least one call.
+template <class Func>
+void timeCalls(Func                     func,
+               BenchmarkOptions const & options,
+               double                 & median,
+               double                 & minimum) {
+	auto const sliceTime = options.minTime / options.repetitions;
+
+	std::size_t warmupCalls {0};
+	auto const warmupStart = Clock::now();
+
+	do {
+		func();
+		++warmupCalls;
+	} while (getSeconds(warmupStart) < sliceTime / 2);
+
+	auto const secondsPerCall = getSeconds(warmupStart) / warmupCalls;
+	auto const callCount = std::max<std::size_t>(
+		1, static_cast<std::size_t>(sliceTime / secondsPerCall)
+	);
+
+	std::vector<double> samples;
+
+	for (std::size_t r {0}; r < options.repetitions; ++r) {
+		auto const start = Clock::now();
+
+		for (std::size_t i {0}; i < callCount; ++i)
+			func();
+
+		samples.push_back(getSeconds(start) * 1e9 / callCount);
+	}
+
+	std::sort(samples.begin(), samples.end());
+
+	median  = samples[samples.size() / 2];
+	minimum = samples.front();
+}
+
+template <class Func>
+BenchmarkResult runBenchmark(std::string      const & engine,
+                             BenchmarkConfig  const & config,
+                             BenchmarkOptions const & options,
+                             double                   bandwidth,
+                             Func                     func) {
+	BenchmarkResult result;
+	result.engine = engine;
+	result.config = config;
+
+	timeCalls(func, options, result.nsPerInference, result.minNsPerInference);
+
+	auto const weightCount = static_cast<double>(config.getWeightCount());
+
+	result.gflops = 2 * weightCount / result.nsPerInference;
+	result.gbps   = weightCount * sizeof(FloatType) / result.nsPerInference;
+	result.rooflineFraction = result.gbps / bandwidth;
+
+	return result;
+}
+
+ListType makeInputs(std::size_t count) {
+	ListType inputs (count);
+
+	for (std::size_t i {0}; i < count; ++i)
+		inputs[i] = static_cast<FloatType>(i % 256) / 256;
+
+	return inputs;
+}
+
+void runConfig(BenchmarkConfig  const & config,
+               BenchmarkOptions const & options,
+               double                   bandwidth,
+               std::vector<BenchmarkResult> & results) {
+	using Group    = HiddenGroup<Node, ::ListInterface, Sigmoid<> >;
+	using GroupNet = Network<Node, ::ListInterface, Sigmoid<> >;
+	using DenseNet = DenseNetwork<Node, ::ListInterface, Sigmoid<> >;
+
+	auto const init   = WeightInit::uniform(-.1f, .1f);
+	auto const inputs = makeInputs(config.inputWidth);
+
+	// layered and a lone HiddenGroup have no notion of groups.
+	if (config.groupCount == 1) {
+		auto layeredNet = layered::generateNetwork(
+			config.depth, config.inputWidth, config.layerWidth, OUTPUT_COUNT
+		);
+
+		results.push_back(runBenchmark("layered::Network", config, options, bandwidth, [&] {
+			layeredNet.execute(inputs);
+		}));
+
+		Group group (config.inputWidth, OUTPUT_COUNT, config.depth, config.layerWidth);
+		initializeHiddenGroup(group, init);
+
+		std::vector<Node> inputNodes (config.inputWidth);
+
+		for (std::size_t i {0}; i < config.inputWidth; ++i)
+			inputNodes[i].setValue(inputs[i]);
+
+		ListType outputs (OUTPUT_COUNT);
+		Sigmoid<> const activation {};
+
+		results.push_back(runBenchmark("constant::HiddenGroup", config, options, bandwidth, [&] {
+			group.execute(inputNodes.data(), outputs.data(), activation);
+		}));
+	}
+
+	auto runNetwork = [&](std::string const & engine, auto & network) {
+		network.initializeWeights(init);
+
+		for (std::size_t i {0}; i < config.inputWidth; ++i)
+			network.getInputNode(i).setValue(inputs[i]);
+
+		results.push_back(runBenchmark(engine, config, options, bandwidth, [&] {
+			network.execute();
+		}));
+	};
+
+	{
+		GroupNet network (config.groupCount, config.inputWidth, OUTPUT_COUNT,
+		                  config.depth, config.layerWidth);
+		runNetwork("constant::Network", network);
+	}
+	{
+		DenseNet network (config.groupCount, config.inputWidth, OUTPUT_COUNT,
+		                  config.depth, config.layerWidth);
+		runNetwork("constant::DenseNetwork", network);
+	}
+}
+
+/// Training throughput of a 256-512-512-10 network on minibatches of 256,
+/// with the per thread count speedup over one thread.
+void runTrainingBenchmark(BenchmarkOptions const & options) {
+	constexpr std::size_t INPUT_WIDTH {256};
+	constexpr std::size_t LAYER_WIDTH {512};
+	constexpr std::size_t BATCH_SIZE  {256};
+
+	auto const inputs = makeInputs(INPUT_WIDTH * BATCH_SIZE);
+	ListType const targets (OUTPUT_COUNT * BATCH_SIZE, .5f);
+
+	std::cout << "\n" << std::setw(8) << "threads"
+	          << std::setw(14) << "samples/s" << std::setw(9) << "speedup" << '\n';
+
+	double single {0};
+
+	for (std::size_t threadCount {1};
+	     threadCount <= ThreadPool::getHardwareThreadCount(); ++threadCount) {
+		auto network = layered::generateNetwork(2, INPUT_WIDTH, LAYER_WIDTH, OUTPUT_COUNT);
+
+		ThreadPool pool (threadCount);
+		layered::Trainer trainer (network, pool, {.01f, .9f, BATCH_SIZE});
+
+		double median, minimum;
+
+		timeCalls([&] {
+			trainer.trainBatch(inputs.data(), targets.data(), BATCH_SIZE);
+		}, options, median, minimum);
+
+		auto const samplesPerSecond = BATCH_SIZE * 1e9 / median;
+
+		if (threadCount == 1)
+			single = samplesPerSecond;
+
+		std::cout << std::setw(8) << threadCount << std::fixed << std::setprecision(0)
+		          << std::setw(14) << samplesPerSecond << std::setprecision(2)
+		          << std::setw(9) << samplesPerSecond / single << '\n';
+	}
+}
+
+void runHogwildBenchmark() {
+	using Group = HiddenGroup<Node, ::ListInterface, Sigmoid<> >;
+
+	constexpr std::size_t INPUT_WIDTH  {256};
+	constexpr std::size_t LAYER_WIDTH  {128};
+	constexpr std::size_t DEPTH        {2};
+	constexpr std::size_t SAMPLE_COUNT {8192};
+	constexpr std::size_t EPOCH_COUNT  {5};
+	constexpr FloatType   LEARNING_RATE {.1f};
+
+	// Random inputs, targets from a randomly initialized network of the
+	// same shape.
+	ListType inputs (INPUT_WIDTH * SAMPLE_COUNT);
+	generateWeights(WeightInit::uniform(0, 1, 3), 0, 0, 1, 1, 0, inputs.size(), inputs.data());
+
+	ListType targets (OUTPUT_COUNT * SAMPLE_COUNT);
+	{
+		Group teacher (INPUT_WIDTH, OUTPUT_COUNT, DEPTH, LAYER_WIDTH);
+		initializeHiddenGroup(teacher, WeightInit::scaled(WeightDistribution::xavierNormal, 1));
+
+		std::vector<Node> nodes (INPUT_WIDTH);
+
+		for (std::size_t s {0}; s < SAMPLE_COUNT; ++s) {
+			for (std::size_t i {0}; i < INPUT_WIDTH; ++i)
+				nodes[i].setValue(inputs[s * INPUT_WIDTH + i]);
+
+			teacher.execute(nodes.data(), targets.data() + s * OUTPUT_COUNT, Sigmoid<> {});
+		}
+	}
+
+	ThreadPool pool;
+
+	auto const trainGroup = [&](bool hogwild) {
+		Group group (INPUT_WIDTH, OUTPUT_COUNT, DEPTH, LAYER_WIDTH);
+		initializeHiddenGroup(group, WeightInit::scaled(WeightDistribution::xavierNormal, 2));
+
+		HogwildTrainer<Group> trainer (group, pool, LEARNING_RATE);
+
+		return hogwild ?
+			trainer.train(inputs.data(), targets.data(), SAMPLE_COUNT, EPOCH_COUNT) :
+			trainer.trainSynchronous(inputs.data(), targets.data(), SAMPLE_COUNT, EPOCH_COUNT);
+	};
+
+	std::cout << "\nHogwild on " << pool.getThreadCount() << " threads\n";
+
+	auto const hogwild     = trainGroup(true);
+	auto const synchronous = trainGroup(false);
+
+	printTrainingComparison(std::cout, hogwild, synchronous);
+}
+
+/// Sustained throughput and latency percentiles of a 256-(512 x 8)-10
+/// network over a stream of samples, executed sample by sample and then
+/// pipelined over every stage count up to the core count.
+void runPipelineBenchmark() {
+	constexpr std::size_t INPUT_WIDTH  {256};
+	constexpr std::size_t LAYER_WIDTH  {512};
+	constexpr std::size_t DEPTH        {8};
+	constexpr std::size_t SAMPLE_COUNT {4096};
+
+	auto network = layered::generateNetwork(DEPTH, INPUT_WIDTH, LAYER_WIDTH, OUTPUT_COUNT);
+	auto const inputs = makeInputs(INPUT_WIDTH * SAMPLE_COUNT);
+
+	ListType expected (OUTPUT_COUNT * SAMPLE_COUNT);
+	PipelineStats sequential {SAMPLE_COUNT, 0, {}};
+	{
+		ListType input (INPUT_WIDTH);
+		auto const start = Clock::now();
+
+		for (std::size_t s {0}; s < SAMPLE_COUNT; ++s) {
+			auto const sampleStart = Clock::now();
+
+			std::copy(inputs.begin() + s * INPUT_WIDTH,
+			          inputs.begin() + (s + 1) * INPUT_WIDTH, input.begin());
+			network.execute(input);
+
+			auto const outputs = network.getLayers().back().getValues();
+			std::copy(outputs, outputs + OUTPUT_COUNT, expected.begin() + s * OUTPUT_COUNT);
+
+			sequential.latencies.push_back(getSeconds(sampleStart));
+		}
+
+		sequential.seconds = getSeconds(start);
+	}
+
+	std::cout << "\n" << std::setw(8) << "stages"
+	          << std::setw(14) << "samples/s"
+	          << std::setw(13) << "p50 us"
+	          << std::setw(13) << "p99 us" << "  layers per stage\n";
+
+	auto const printStats = [](std::string const & name, PipelineStats const & stats) {
+		std::cout << std::setw(8) << name << std::fixed << std::setprecision(0)
+		          << std::setw(14) << stats.getThroughput() << std::setprecision(1)
+		          << std::setw(13) << stats.getLatencyPercentile(.5) * 1e6
+		          << std::setw(13) << stats.getLatencyPercentile(.99) * 1e6;
+	};
+
+	printStats("serial", sequential);
+	std::cout << '\n';
+
+	for (std::size_t stageCount {1};
+	     stageCount <= ThreadPool::getHardwareThreadCount(); ++stageCount) {
+		StreamingPipeline pipeline (layered::getPipelineLayers(network), stageCount);
+
+		ListType outputs (OUTPUT_COUNT * SAMPLE_COUNT);
+		auto const stats = pipeline.process(inputs.data(), SAMPLE_COUNT, outputs.data());
+
+		if (outputs != expected)
+			throw std::runtime_error("Pipelined outputs differ from Network::execute");
+
+		printStats(std::to_string(pipeline.getStageCount()), stats);
+		std::cout << " ";
+
+		for (std::size_t s {0}; s < pipeline.getStageCount(); ++s)
+			std::cout << ' ' << pipeline.getStageBegin(s + 1) - pipeline.getStageBegin(s);
+
+		std::cout << '\n';
+	}
+}
+
+/// CompiledGraph::execute against ParallelExecutor on a layered graph
+/// whose nodes read from random nodes of the layer before, plus a few
+/// from anywhere earlier.
+void runDynamicBenchmark(BenchmarkOptions const & options) {
+	using DynamicNode = dynamic::BasicNode<
+		FloatType (*)(FloatType), FloatType (*)(FloatType), &softStep, &softStep
+	>;
+
+	constexpr std::size_t INPUT_WIDTH {256};
+	constexpr std::size_t FAN_IN      {8};
+	constexpr std::size_t SKIP_FAN_IN {2};
+
+	std::size_t const layerWidth {options.quick ? 1000u : 4000u};
+	std::size_t const depth      {50};
+
+	dynamic::Network<DynamicNode> network;
+	std::vector<DynamicNode *> nodes;
+	std::size_t state {1};
+
+	// Cheap and reproducible, the graph only has to be irregular.
+	auto const next = [&state] {
+		state = state * 6364136223846793005u + 1442695040888963407u;
+		return static_cast<std::size_t>(state >> 33);
+	};
+
+	auto const nextWeight = [&] {
+		return static_cast<FloatType>(next() % 2001) / 1000 - 1;
+	};
+
+	for (std::size_t i {0}; i < INPUT_WIDTH; ++i)
+		nodes.push_back(&network.createInputNode());
+
+	std::size_t layerBegin {0};
+
+	for (std::size_t l {0}; l <= depth; ++l) {
+		auto const previousBegin = layerBegin;
+		layerBegin = nodes.size();
+
+		auto const width = l < depth ? layerWidth : OUTPUT_COUNT;
+
+		for (std::size_t i {0}; i < width; ++i) {
+			auto & node = l < depth ? network.createHiddenNode() : network.createOutputNode();
+			node.setThreshold(-std::numeric_limits<FloatType>::infinity());
+
+			for (std::size_t e {0}; e < FAN_IN; ++e) {
+				auto const source = previousBegin + next() % (layerBegin - previousBegin);
+				network.connect(*nodes[source], node, nextWeight());
+			}
+
+			for (std::size_t e {0}; e < SKIP_FAN_IN; ++e)
+				network.connect(*nodes[next() % layerBegin], node, nextWeight());
+
+			nodes.push_back(&node);
+		}
+	}
+
+	auto graph = network.compile<SoftStep>();
+	auto const inputs = makeInputs(INPUT_WIDTH);
+
+	ListType expected (OUTPUT_COUNT);
+	ListType outputs  (OUTPUT_COUNT);
+
+	std::cout << '\n' << graph.getNodeCount() << " nodes, " << graph.getEdgeCount()
+	          << " edges, " << graph.getLevelCount() << " levels\n"
+	          << std::setw(8) << "threads" << std::setw(9) << "batches"
+	          << std::setw(13) << "us/execute" << std::setw(9) << "speedup\n";
+
+	double serial, minimum;
+	timeCalls([&] {
+		graph.execute(inputs.data(), expected.data(), SoftStep {});
+	}, options, serial, minimum);
+
+	std::cout << std::setw(8) << "serial" << std::setw(9) << "-" << std::fixed
+	          << std::setprecision(1) << std::setw(13) << serial / 1e3
+	          << std::setprecision(2) << std::setw(8) << 1.0 << '\n';
+
+	for (std::size_t threadCount {1};
+	     threadCount <= ThreadPool::getHardwareThreadCount(); ++threadCount) {
+		ThreadPool pool (threadCount);
+		dynamic::ParallelExecutor<decltype(graph)> executor (graph, pool);
+
+		double median;
+		timeCalls([&] {
+			executor.execute(inputs.data(), outputs.data(), SoftStep {});
+		}, options, median, minimum);
+
+		if (outputs != expected)
+			throw std::runtime_error("ParallelExecutor outputs differ from CompiledGraph::execute");
+
+		std::cout << std::setw(8) << threadCount << std::setw(9) << executor.getBatchCount()
+		          << std::setprecision(1) << std::setw(13) << median / 1e3
+		          << std::setprecision(2) << std::setw(8) << serial / median << '\n';
+	}
+}
+
+std::vector<BenchmarkConfig> makeSweep(bool quick) {
+	std::vector<std::size_t> const inputWidths {256, 4096};
+	std::vector<std::size_t> const layerWidths = quick ?
+		std::vector<std::size_t> {64, 512} : std::vector<std::size_t> {64, 256, 1024, 2048};
+	std::vector<std::size_t> const depths = quick ?
+		std::vector<std::size_t> {2} : std::vector<std::size_t> {2, 8};
+	std::vector<std::size_t> const groupCounts = quick ?
+		std::vector<std::size_t> {1, 4} : std::vector<std::size_t> {1, 2, 8};
+
+	std::vector<BenchmarkConfig> sweep;
+
+	for (auto inputWidth : inputWidths) {
+		for (auto layerWidth : layerWidths) {
+			for (auto depth : depths) {
+				for (auto groupCount : groupCounts)
+					sweep.push_back({inputWidth, layerWidth, depth, groupCount});
+			}
+		}
+	}
+
+	return sweep;
+}
+
+void printResult(BenchmarkResult const & result) {
+	auto const & config = result.config;
+
+	std::cout << std::left  << std::setw(24) << result.engine << std::right
+	          << std::setw(7)  << config.inputWidth
+	          << std::setw(7)  << config.layerWidth
+	          << std::setw(4)  << config.depth
+	          << std::setw(4)  << config.groupCount
+	          << std::fixed << std::setprecision(0)
+	          << std::setw(13) << result.nsPerInference
+	          << std::setprecision(2)
+	          << std::setw(9)  << result.gflops
+	          << std::setw(9)  << result.gbps
+	          << std::setw(9)  << result.rooflineFraction << '\n';
+}
+
+void writeJson(std::string const & path,
+               double              bandwidth,
+               std::vector<BenchmarkResult> const & results) {
+	std::ofstream out (path);
+
+	if (!out)
+		throw std::runtime_error("Unable to create " + path);
+
+	out << "{\n  \"memory_bandwidth_gbps\": " << bandwidth << ",\n  \"results\": [\n";
+
+	for (std::size_t i {0}; i < results.size(); ++i) {
+		auto const & result = results[i];
+		auto const & config = result.config;
+
+		out << "    {\"engine\": \"" << result.engine << "\""
+		    << ", \"input_width\": "       << config.inputWidth
+		    << ", \"layer_width\": "       << config.layerWidth
+		    << ", \"depth\": "             << config.depth
+		    << ", \"group_count\": "       << config.groupCount
+		    << ", \"weight_count\": "      << config.getWeightCount()
+		    << ", \"ns_per_inference\": "  << result.nsPerInference
+		    << ", \"min_ns_per_inference\": " << result.minNsPerInference
+		    << ", \"gflops\": "            << result.gflops
+		    << ", \"gbps\": "              << result.gbps
+		    << ", \"roofline_fraction\": " << result.rooflineFraction << "}"
+		    << (i + 1 < results.size() ? ",\n" : "\n");
+	}
+
+	out << "  ]\n}\n";
+}
+
+/// Every configuration of makeSweep, printed as it goes and written to
+/// options.jsonPath when given.
+void runSweep(BenchmarkOptions const & options) {
+	auto const bandwidth = measureMemoryBandwidth();
+	std::cout << "Memory bandwidth: " << std::setprecision(3) << bandwidth << " GB/s\n\n";
+
+	std::cout << std::left  << std::setw(24) << "engine" << std::right
+	          << std::setw(7)  << "input"
+	          << std::setw(7)  << "width"
+	          << std::setw(4)  << "L"
+	          << std::setw(4)  << "G"
+	          << std::setw(13) << "ns/inference"
+	          << std::setw(9)  << "GFLOP/s"
+	          << std::setw(9)  << "GB/s"
+	          << std::setw(9)  << "roofline" << '\n';
+
+	std::vector<BenchmarkResult> results;
+
+	for (auto const & config : makeSweep(options.quick)) {
+		auto const first = results.size();
+
+		runConfig(config, options, bandwidth, results);
+
+		for (auto i = first; i < results.size(); ++i)
+			printResult(results[i]);
+	}
+
+	if (!options.jsonPath.empty())
+		writeJson(options.jsonPath, bandwidth, results);
+}
+
+}
+
+int main(int argc, char * argv[])
+{
+	BenchmarkOptions options {false, false, false, false, false, false, 0.5, 5, ""};
+
+	for (int i {1}; i < argc; ++i) {
+		std::string const arg {argv[i]};
+
+		if (arg == "--quick")
+			options.quick = true;
+		else if (arg == "--train")
+			options.train = true;
+		else if (arg == "--hogwild")
+			options.hogwild = true;
+		else if (arg == "--pipeline")
+			options.pipeline = true;
+		else if (arg == "--dynamic")
+			options.dynamic = true;
+		else if (arg == "--sweep")
+			options.sweep = true;
+		else if (arg == "--json" && i + 1 < argc)
+			options.jsonPath = argv[++i];
+		else if (arg == "--min-time" && i + 1 < argc)
+			options.minTime = std::stod(argv[++i]);
+		else if (arg == "--repetitions" && i + 1 < argc)
+			options.repetitions = std::max<std::size_t>(std::stoul(argv[++i]), 1);
+		else {
+			std::cerr << "Unknown argument " << arg << '\n';
+			return 1;
+		}
+	}
+
+	if (options.sweep || !options.jsonPath.empty() ||
+	    !(options.train || options.hogwild || options.pipeline || options.dynamic))
+		runSweep(options);
+
+	if (options.train)
+		runTrainingBenchmark(options);
+
+	if (options.hogwild)
+		runHogwildBenchmark();
+
+	if (options.pipeline)
+		runPipelineBenchmark();
+
+	if (options.dynamic)
+		runDynamicBenchmark(options);
+
+	return 0;
+}
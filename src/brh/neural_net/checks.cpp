@@ -0,0 +1,970 @@
+// Self-checks, built as brh_neural_net_checks and run by ctest.
+//
+// Every check prints what it measured, the program returns 1 if any of
+// them failed. The global allocation functions are replaced with counting
+// ones in this executable only, so the main program doesn't pay for the
+// counter.
+
+#include <atomic>
+#include <cstdlib>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "layered.h"
+#include "layered_trainer.h"
+#include "activation_functions.h"
+#include "pipeline.h"
+#include "thread_pool.h"
+
+#include "dynamic/compiled_graph.h"
+#include "dynamic/network.h"
+#include "dynamic/node.h"
+#include "dynamic/parallel_executor.h"
+
+#include "constant/hidden_group.h"
+#include "constant/hogwild_trainer.h"
+#include "constant/model_file.h"
+#include "constant/network.h"
+#include "constant/node.h"
+#include "constant/sparse_hidden_group.h"
+#include "constant/weight_init.h"
+
+using namespace brh::neural;
+using namespace brh::neural::constant;
+
+namespace {
+
+std::atomic<std::size_t> allocationCount {0};
+
+}
+
+// Counting replacements of the global allocation functions. The array
+// forms forward to these.
+void * operator new(std::size_t size)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+
+	if (void * memory = std::malloc(size == 0 ? 1 : size))
+		return memory;
+
+	throw std::bad_alloc {};
+}
+
+void operator delete(void * memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void * memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+namespace {
+
+using HiddenNet = constant::Network<Node, ::ListInterface, Sigmoid<> >;
+using DenseNet  = DenseNetwork<Node, ::ListInterface, Sigmoid<> >;
+using SparseNet = SparseNetwork<Node, ::ListInterface, Sigmoid<> >;
+
+// The derivative isn't used by any of the dynamic evaluations.
+using DynamicNode = dynamic::BasicNode<
+	FloatType (*)(FloatType), FloatType (*)(FloatType), &softStep, &softStep
+>;
+using DynamicNet = dynamic::Network<DynamicNode>;
+
+// Big enough for a stage to be split into two row tiles, see
+// MIN_TILE_WEIGHTS, small enough to build in a blink.
+constexpr std::size_t GROUP_COUNT  {3};
+constexpr std::size_t INPUT_COUNT  {256};
+constexpr std::size_t OUTPUT_COUNT {10};
+constexpr std::size_t LAYER_COUNT  {2};
+constexpr std::size_t LAYER_WIDTH  {256};
+
+bool report(std::string const & name, bool passed) {
+	std::cout << (passed ? "pass  " : "FAIL  ") << name << '\n';
+	return passed;
+}
+
+/// Allocations made by callCount calls of func, after one warm-up call
+/// that's allowed to size buffers.
+template <class Func>
+std::size_t countSteadyStateAllocations(Func func, std::size_t callCount = 16) {
+	func(0);
+
+	auto const before = allocationCount.load();
+
+	for (std::size_t i {1}; i <= callCount; ++i)
+		func(i);
+
+	return allocationCount.load() - before;
+}
+
+template <class Func>
+bool checkAllocationFree(std::string const & name, Func func) {
+	auto const count = countSteadyStateAllocations(func);
+
+	return report(name + ": " + std::to_string(count) + " allocations", count == 0);
+}
+
+/// Changes one input per call so executeIncremental has something to do.
+template <class NetworkType>
+void setInputs(NetworkType & network, std::size_t call) {
+	for (std::size_t i {0}; i < network.getInputNodeCount(); ++i)
+		network.getInputNode(i).setValue(.5f);
+
+	network.getInputNode(call % network.getInputNodeCount())
+		.setValue(static_cast<FloatType>(call) / 32);
+}
+
+template <class NetworkType>
+bool checkNodeExecution(std::string const & name, NetworkType & network) {
+	return checkAllocationFree(name + " execute()", [&](std::size_t call) {
+		setInputs(network, call);
+		network.execute();
+	});
+}
+
+template <class NetworkType>
+bool checkWorkspaceExecution(std::string const & name, NetworkType & network) {
+	auto workspace = network.makeWorkspace();
+
+	typename NetworkType::FloatList inputs  (network.getInputNodeCount(), .5f);
+	typename NetworkType::FloatList outputs (network.getOutputNodeCount());
+
+	return checkAllocationFree(name + " execute(inputs, outputs, workspace)",
+	                           [&](std::size_t call) {
+		inputs[call % inputs.size()] = static_cast<FloatType>(call) / 32;
+		network.execute(inputs.data(), outputs.data(), workspace);
+	});
+}
+
+/// Every inference path meant to run allocation free, on a single thread
+/// and on a pool whose workers actually take tasks.
+bool checkAllocations() {
+	bool passed {true};
+
+	for (std::size_t threadCount : {1, 4}) {
+		auto const pool = std::make_shared<ThreadPool>(threadCount);
+		auto const suffix = " (" + std::to_string(threadCount) + " threads)";
+
+		HiddenNet hiddenNet (GROUP_COUNT, INPUT_COUNT, OUTPUT_COUNT, LAYER_COUNT, LAYER_WIDTH, pool);
+		hiddenNet.initializeWeights(WeightInit::uniform(0, .5));
+
+		passed &= checkNodeExecution("Network" + suffix, hiddenNet);
+
+		DenseNet denseNet (GROUP_COUNT, INPUT_COUNT, OUTPUT_COUNT, LAYER_COUNT, LAYER_WIDTH, pool);
+		denseNet.initializeWeights(WeightInit::uniform(0, .5));
+
+		passed &= checkNodeExecution("DenseNetwork" + suffix, denseNet);
+		passed &= checkWorkspaceExecution("DenseNetwork" + suffix, denseNet);
+		passed &= checkAllocationFree("DenseNetwork" + suffix + " executeIncremental()",
+		                              [&](std::size_t call) {
+			setInputs(denseNet, call);
+			denseNet.executeIncremental();
+		});
+
+		SparseNet::HiddenGroupList sparseGroups;
+
+		for (std::size_t g {0}; g < GROUP_COUNT; ++g)
+			sparseGroups.push_back(pruneHiddenGroup(hiddenNet.getHiddenGroup(g), .25));
+
+		SparseNet sparseNet (std::move(sparseGroups), pool);
+
+		passed &= checkNodeExecution("SparseNetwork" + suffix, sparseNet);
+		passed &= checkWorkspaceExecution("SparseNetwork" + suffix, sparseNet);
+
+		auto layeredNet = layered::generateNetwork(LAYER_COUNT, INPUT_COUNT, LAYER_WIDTH, OUTPUT_COUNT);
+		layeredNet.setThreadPool(pool.get());
+
+		ListType const layeredInputs (INPUT_COUNT, .5f);
+
+		passed &= checkAllocationFree("layered::Network" + suffix + " execute(inputs)",
+		                              [&](std::size_t) {
+			layeredNet.execute(layeredInputs);
+		});
+	}
+
+	return passed;
+}
+
+/// executeEvents against CompiledGraph on a graph whose edges skip
+/// levels, with every threshold disabled so every node fires.
+bool checkEventExecution() {
+	constexpr std::size_t INPUT_NODE_COUNT  {8};
+	constexpr std::size_t HIDDEN_NODE_COUNT {64};
+	constexpr std::size_t OUTPUT_NODE_COUNT {4};
+	constexpr std::size_t FAN_IN            {6};
+
+	std::mt19937 engine {7};
+	std::uniform_real_distribution<FloatType> weightDist {-1, 1};
+
+	DynamicNet network;
+	std::vector<DynamicNode *> nodes;
+
+	auto const addNode = [&](DynamicNode & node, bool input) {
+		node.setThreshold(-std::numeric_limits<FloatType>::infinity());
+
+		// Sources drawn from every node made so far, inputs included, so
+		// edges span any number of levels.
+		if (!input) {
+			for (std::size_t e {0}; e < FAN_IN; ++e) {
+				auto & source = *nodes[engine() % nodes.size()];
+				network.connect(source, node, weightDist(engine));
+			}
+		}
+
+		nodes.push_back(&node);
+	};
+
+	for (std::size_t i {0}; i < INPUT_NODE_COUNT; ++i)
+		addNode(network.createInputNode(), true);
+
+	for (std::size_t i {0}; i < HIDDEN_NODE_COUNT; ++i)
+		addNode(network.createHiddenNode(), false);
+
+	for (std::size_t i {0}; i < OUTPUT_NODE_COUNT; ++i)
+		addNode(network.createOutputNode(), false);
+
+	auto graph = network.compile<SoftStep>();
+
+	bool passed {true};
+
+	// Twice, the second run has to start from a clean slate.
+	for (std::size_t run {0}; run < 2; ++run) {
+		ListType inputs (INPUT_NODE_COUNT);
+
+		for (auto & i : inputs)
+			i = weightDist(engine);
+
+		ListType expected (OUTPUT_NODE_COUNT);
+		ListType actual   (OUTPUT_NODE_COUNT);
+
+		graph.execute(inputs.data(), expected.data(), SoftStep {});
+		network.executeEvents(inputs.data(), actual.data());
+
+		FloatType maxError {0};
+
+		for (std::size_t o {0}; o < OUTPUT_NODE_COUNT; ++o)
+			maxError = std::max(maxError, std::abs(expected[o] - actual[o]));
+
+		passed &= report(
+			"dynamic::Network::executeEvents matches CompiledGraph across skip edges, "
+			"max error " + std::to_string(maxError),
+			maxError < 1e-5f
+		);
+	}
+
+	return passed;
+}
+
+/// Nodes and their connection lists come out of the network's arena, so
+/// once warm, clearing a graph and building another one never reaches
+/// the global operator new.
+bool checkArenaRebuild() {
+	constexpr std::size_t INPUT_NODE_COUNT  {8};
+	constexpr std::size_t HIDDEN_NODE_COUNT {128};
+	constexpr std::size_t OUTPUT_NODE_COUNT {4};
+	constexpr std::size_t FAN_IN            {6};
+
+	DynamicNet network;
+	std::vector<DynamicNode *> nodes;
+	nodes.reserve(INPUT_NODE_COUNT + HIDDEN_NODE_COUNT + OUTPUT_NODE_COUNT);
+
+	auto const count = countSteadyStateAllocations([&](std::size_t call) {
+		network.clear();
+		nodes.clear();
+
+		for (std::size_t i {0}; i < INPUT_NODE_COUNT; ++i)
+			nodes.push_back(&network.createInputNode());
+
+		for (std::size_t i {0}; i < HIDDEN_NODE_COUNT + OUTPUT_NODE_COUNT; ++i) {
+			auto & node = i < HIDDEN_NODE_COUNT ?
+				network.createHiddenNode() : network.createOutputNode();
+
+			for (std::size_t e {0}; e < FAN_IN; ++e)
+				network.connect(*nodes[(i * 7 + e * 13 + call) % nodes.size()], node, .5f);
+
+			nodes.push_back(&node);
+		}
+	});
+
+	return report("dynamic::Network clear() and rebuild: " + std::to_string(count) +
+	              " allocations", count == 0);
+}
+
+/// ParallelExecutor against CompiledGraph::execute, on one worker and on
+/// several. Every node reads from more than LEVEL_LINK_LIMIT nodes of the
+/// layer before and batches hold one node each, so batches wait on level
+/// markers as well as on individual batches.
+bool checkParallelExecution() {
+	constexpr std::size_t INPUT_NODE_COUNT  {16};
+	constexpr std::size_t LAYER_COUNT       {6};
+	constexpr std::size_t LAYER_WIDTH       {48};
+	constexpr std::size_t OUTPUT_NODE_COUNT {4};
+	constexpr std::size_t FAN_IN            {12};
+	constexpr std::size_t SKIP_FAN_IN       {2};
+
+	std::mt19937 engine {11};
+	std::uniform_real_distribution<FloatType> weightDist {-1, 1};
+
+	DynamicNet network;
+	std::vector<DynamicNode *> nodes;
+	std::size_t layerBegin {0};
+
+	auto const addLayer = [&](std::size_t width, bool input, bool output) {
+		auto const previousBegin = layerBegin;
+		layerBegin = nodes.size();
+
+		for (std::size_t i {0}; i < width; ++i) {
+			auto & node = input  ? network.createInputNode()  :
+			              output ? network.createOutputNode() : network.createHiddenNode();
+
+			if (!input) {
+				// Mostly from the layer before, a few skipping further back.
+				for (std::size_t e {0}; e < FAN_IN; ++e) {
+					auto const source = previousBegin + engine() % (layerBegin - previousBegin);
+					network.connect(*nodes[source], node, weightDist(engine));
+				}
+
+				for (std::size_t e {0}; e < SKIP_FAN_IN; ++e)
+					network.connect(*nodes[engine() % layerBegin], node, weightDist(engine));
+			}
+
+			nodes.push_back(&node);
+		}
+	};
+
+	addLayer(INPUT_NODE_COUNT, true, false);
+
+	for (std::size_t l {0}; l < LAYER_COUNT; ++l)
+		addLayer(LAYER_WIDTH, false, false);
+
+	addLayer(OUTPUT_NODE_COUNT, false, true);
+
+	auto graph = network.compile<SoftStep>();
+
+	ListType inputs (INPUT_NODE_COUNT);
+
+	for (auto & i : inputs)
+		i = weightDist(engine);
+
+	ListType expected (OUTPUT_NODE_COUNT);
+	graph.execute(inputs.data(), expected.data(), SoftStep {});
+
+	bool passed {true};
+
+	for (std::size_t threadCount : {1, 4}) {
+		ThreadPool pool (threadCount);
+		dynamic::ParallelExecutor<decltype(graph)> executor (graph, pool, 4);
+
+		// Twice, the counters have to be reset between runs.
+		for (std::size_t run {0}; run < 2; ++run) {
+			ListType actual (OUTPUT_NODE_COUNT);
+			executor.execute(inputs.data(), actual.data(), SoftStep {});
+
+			passed &= report(
+				"ParallelExecutor matches CompiledGraph::execute, " +
+				std::to_string(executor.getBatchCount()) + " batches on " +
+				std::to_string(threadCount) + " threads",
+				actual == expected
+			);
+		}
+	}
+
+	return passed;
+}
+
+/// executeIncremental right after initializeWeights has to match a full
+/// execute with the new weights, not patch sums built from the old ones.
+bool checkIncrementalAfterInitialize() {
+	DenseNet network (2, 64, 4, 2, 16);
+	network.initializeWeights(WeightInit::uniform(-.5, .5, 1));
+
+	setInputs(network, 0);
+	network.executeIncremental();
+
+	network.initializeWeights(WeightInit::uniform(-.5, .5, 2));
+
+	// One changed input, well under INCREMENTAL_CHANGE_LIMIT.
+	setInputs(network, 1);
+	auto const stats = network.executeIncremental();
+
+	ListType incremental (network.getOutputNodeCount());
+
+	for (std::size_t o {0}; o < incremental.size(); ++o)
+		incremental[o] = network.getOutputNode(o).getValue();
+
+	network.execute();
+
+	FloatType maxError {0};
+
+	for (std::size_t o {0}; o < incremental.size(); ++o)
+		maxError = std::max(maxError, std::abs(incremental[o] - network.getOutputNode(o).getValue()));
+
+	return report(
+		"DenseNetwork::executeIncremental after initializeWeights, recomputed " +
+		std::to_string(stats.recomputed) + ", max error " + std::to_string(maxError),
+		maxError < 1e-5f
+	);
+}
+
+/// executeBatch over many rows against executing them one at a time.
+template <class NetworkType>
+bool checkBatchExecution(std::string const & name, NetworkType & network) {
+	constexpr std::size_t SAMPLE_COUNT {8};
+
+	auto const inputCount  = network.getInputNodeCount();
+	auto const outputCount = network.getOutputNodeCount();
+
+	typename NetworkType::FloatList inputs (SAMPLE_COUNT * inputCount);
+
+	for (std::size_t i {0}; i < inputs.size(); ++i)
+		inputs[i] = static_cast<FloatType>(i % 13) / 13;
+
+	auto const batch = network.executeBatch(inputs.data(), SAMPLE_COUNT);
+
+	FloatType maxError {0};
+
+	for (std::size_t s {0}; s < SAMPLE_COUNT; ++s) {
+		auto const single = network.executeBatch(inputs.data() + s * inputCount, 1);
+
+		for (std::size_t o {0}; o < outputCount; ++o)
+			maxError = std::max(maxError, std::abs(batch[s * outputCount + o] - single[o]));
+	}
+
+	return report(name + " executeBatch matches execute, max error " +
+	              std::to_string(maxError), maxError < 1e-5f);
+}
+
+/// Every group type's executeBatch, including groups with a single layer
+/// and so no non-terminal weights.
+bool checkBatchExecution() {
+	bool passed {true};
+
+	for (std::size_t layerCount : {1, 3}) {
+		auto const suffix = " (layer count " + std::to_string(layerCount) + ")";
+
+		HiddenNet hiddenNet (2, 40, 5, layerCount, 24);
+		hiddenNet.initializeWeights(WeightInit::uniform(-.5, .5));
+
+		passed &= checkBatchExecution("Network" + suffix, hiddenNet);
+
+		DenseNet denseNet (2, 40, 5, layerCount, 24);
+		denseNet.initializeWeights(WeightInit::uniform(-.5, .5));
+
+		passed &= checkBatchExecution("DenseNetwork" + suffix, denseNet);
+
+		SparseNet::HiddenGroupList sparseGroups;
+
+		for (std::size_t g {0}; g < hiddenNet.getHiddenGroupCount(); ++g)
+			sparseGroups.push_back(pruneHiddenGroup(hiddenNet.getHiddenGroup(g), .25));
+
+		SparseNet sparseNet (std::move(sparseGroups));
+
+		passed &= checkBatchExecution("SparseNetwork" + suffix, sparseNet);
+
+		HiddenNet::FloatList const samples (4 * 40, .5f);
+		auto quantizedNet = quantizeNetwork(hiddenNet, samples, 4, QuantizationScale::perRow);
+
+		passed &= checkBatchExecution("QuantizedNetwork" + suffix, quantizedNet);
+	}
+
+	return passed;
+}
+
+/// Redraws every weight of a layered::Network from [-1, 1].
+void randomizeWeights(layered::Network & network, std::mt19937 & engine) {
+	std::uniform_real_distribution<FloatType> dist {-1, 1};
+
+	for (auto & layer : network.getLayers()) {
+		for (std::size_t j {0}; j < layer.getNextSize(); ++j) {
+			for (std::size_t i {0}; i < layer.getSize(); ++i)
+				layer.getWeightRow(j)[i] = dist(engine);
+		}
+	}
+}
+
+/// layered::Trainer's gradients, summed over shards on several threads,
+/// against central differences of the loss, and XOR has to be learned.
+bool checkLayeredTraining() {
+	ThreadPool pool (4);
+	bool passed {true};
+
+	{
+		constexpr std::size_t INPUT_SIZE   {5};
+		constexpr std::size_t OUTPUT_SIZE  {3};
+		constexpr std::size_t SAMPLE_COUNT {12};
+		constexpr FloatType   STEP         {1e-2f};
+
+		std::mt19937 engine {5};
+		auto network = layered::generateNetwork(2, INPUT_SIZE, 7, OUTPUT_SIZE);
+		randomizeWeights(network, engine);
+
+		std::uniform_real_distribution<FloatType> dist {0, 1};
+		ListType inputs  (SAMPLE_COUNT * INPUT_SIZE);
+		ListType targets (SAMPLE_COUNT * OUTPUT_SIZE);
+
+		for (auto & i : inputs)  i = dist(engine);
+		for (auto & t : targets) t = dist(engine);
+
+		// Without momentum one step moves each weight by
+		// -learningRate * gradient.
+		constexpr FloatType LEARNING_RATE {1};
+		layered::Trainer trainer (network, pool, {LEARNING_RATE, 0, SAMPLE_COUNT});
+
+		auto const loss = [&] {
+			return static_cast<double>(trainer.evaluate(inputs.data(), targets.data(), SAMPLE_COUNT));
+		};
+
+		auto & layers = network.getLayers();
+		std::vector<ListType> before;
+
+		for (auto const & layer : layers)
+			before.emplace_back(layer.getWeightRow(0), layer.getWeightRow(0) + layer.getNextSize() * layer.getStride());
+
+		// Central differences first, they leave the weights as they were.
+		std::vector<ListType> numeric;
+
+		for (auto & layer : layers) {
+			numeric.emplace_back(layer.getNextSize() * layer.getStride());
+
+			for (std::size_t j {0}; j < layer.getNextSize(); ++j) {
+				for (std::size_t i {0}; i < layer.getSize(); ++i) {
+					auto & weight = layer.getWeightRow(j)[i];
+					auto const original = weight;
+
+					weight = original + STEP;
+					auto const up = loss();
+					weight = original - STEP;
+					auto const down = loss();
+					weight = original;
+
+					numeric.back()[j * layer.getStride() + i] =
+						static_cast<FloatType>((up - down) / (2 * STEP));
+				}
+			}
+		}
+
+		trainer.trainBatch(inputs.data(), targets.data(), SAMPLE_COUNT);
+
+		double maxError {0};
+		double maxGradient {0};
+
+		for (std::size_t l {0}; l < layers.size(); ++l) {
+			auto const & layer = layers[l];
+
+			for (std::size_t j {0}; j < layer.getNextSize(); ++j) {
+				for (std::size_t i {0}; i < layer.getSize(); ++i) {
+					auto const index = j * layer.getStride() + i;
+					auto const analytic = (before[l][index] - layer.getWeightRow(j)[i]) / LEARNING_RATE;
+
+					maxError    = std::max(maxError, std::abs(static_cast<double>(analytic - numeric[l][index])));
+					maxGradient = std::max(maxGradient, std::abs(static_cast<double>(numeric[l][index])));
+				}
+			}
+		}
+
+		passed &= report(
+			"layered::Trainer gradients match central differences, max error " +
+			std::to_string(maxError) + " of max gradient " + std::to_string(maxGradient),
+			maxError < maxGradient * .02
+		);
+	}
+
+	{
+		// A constant input stands in for the missing biases.
+		FloatType const inputs[] {
+			0, 0, 1,
+			0, 1, 1,
+			1, 0, 1,
+			1, 1, 1
+		};
+		FloatType const targets[] {0, 1, 1, 0};
+
+		std::mt19937 engine {3};
+		auto network = layered::generateNetwork(1, 3, 8, 1);
+		randomizeWeights(network, engine);
+
+		layered::Trainer trainer (network, pool, {2, .9f, 4});
+
+		auto const initialLoss = trainer.evaluate(inputs, targets, 4);
+
+		for (std::size_t epoch {0}; epoch < 2000; ++epoch)
+			trainer.trainEpoch(inputs, targets, 4);
+
+		auto const finalLoss = trainer.evaluate(inputs, targets, 4);
+
+		passed &= report(
+			"layered::Trainer learns XOR, loss " + std::to_string(initialLoss) +
+			" to " + std::to_string(finalLoss),
+			finalLoss < .01f && finalLoss < initialLoss
+		);
+	}
+
+	return passed;
+}
+
+/// HogwildTrainer's synchronous step against central differences of the
+/// loss on a single thread, and Hogwild training on several threads has
+/// to bring the loss down.
+bool checkHogwildTraining() {
+	using Group = HiddenGroup<Node, ::ListInterface, Sigmoid<> >;
+
+	constexpr std::size_t INPUT_COUNT  {5};
+	constexpr std::size_t OUTPUT_COUNT {3};
+	constexpr std::size_t LAYER_COUNT  {2};
+	constexpr std::size_t LAYER_WIDTH  {4};
+	constexpr std::size_t SAMPLE_COUNT {64};
+
+	ListType inputs  (SAMPLE_COUNT * INPUT_COUNT);
+	ListType targets (SAMPLE_COUNT * OUTPUT_COUNT);
+	{
+		std::mt19937 engine {9};
+		std::uniform_real_distribution<FloatType> dist {0, 1};
+
+		for (auto & i : inputs)  i = dist(engine);
+		for (auto & t : targets) t = dist(engine);
+	}
+
+	bool passed {true};
+
+	{
+		using Trainer = HogwildTrainer<Group>;
+
+		// One step of trainSynchronous on a single thread.
+		constexpr std::size_t STEP_SAMPLE_COUNT {Trainer::SHARD_SIZE};
+		constexpr FloatType   LEARNING_RATE     {1};
+		constexpr FloatType   STEP              {1e-2f};
+
+		Group group (INPUT_COUNT, OUTPUT_COUNT, LAYER_COUNT, LAYER_WIDTH);
+		initializeHiddenGroup(group, WeightInit::uniform(-1, 1, 4));
+
+		ThreadPool pool (1);
+		Trainer trainer (group, pool, LEARNING_RATE);
+
+		std::vector<FloatType *> weights;
+
+		for (std::size_t j {0}; j < INPUT_COUNT; ++j) {
+			for (std::size_t k {0}; k < LAYER_WIDTH; ++k)
+				weights.push_back(group.getInputWeight(j, k));
+		}
+
+		for (std::size_t l {0}; l < group.getNonTerminalLayerCount(); ++l) {
+			for (std::size_t j {0}; j < LAYER_WIDTH; ++j) {
+				for (std::size_t k {0}; k < LAYER_WIDTH; ++k)
+					weights.push_back(group.getNonTerminalElement(l, j).getWeight(k));
+			}
+		}
+
+		for (std::size_t j {0}; j < LAYER_WIDTH; ++j) {
+			for (std::size_t o {0}; o < OUTPUT_COUNT; ++o)
+				weights.push_back(group.getTerminalElement(j).getWeight(o));
+		}
+
+		// The step follows the gradient of the loss summed over its samples.
+		ListType numeric;
+
+		for (auto weight : weights) {
+			auto const original = *weight;
+
+			*weight = original + STEP;
+			auto const up = trainer.evaluate(inputs.data(), targets.data(), STEP_SAMPLE_COUNT);
+			*weight = original - STEP;
+			auto const down = trainer.evaluate(inputs.data(), targets.data(), STEP_SAMPLE_COUNT);
+			*weight = original;
+
+			numeric.push_back(static_cast<FloatType>((up - down) / (2 * STEP) * STEP_SAMPLE_COUNT));
+		}
+
+		ListType before;
+
+		for (auto weight : weights)
+			before.push_back(*weight);
+
+		trainer.trainSynchronous(inputs.data(), targets.data(), STEP_SAMPLE_COUNT, 1);
+
+		double maxError {0};
+		double maxGradient {0};
+
+		for (std::size_t w {0}; w < weights.size(); ++w) {
+			auto const analytic = (before[w] - *weights[w]) / LEARNING_RATE;
+
+			maxError    = std::max(maxError, std::abs(static_cast<double>(analytic - numeric[w])));
+			maxGradient = std::max(maxGradient, std::abs(static_cast<double>(numeric[w])));
+		}
+
+		passed &= report(
+			"HogwildTrainer::trainSynchronous matches central differences, max error " +
+			std::to_string(maxError) + " of max gradient " + std::to_string(maxGradient),
+			maxError < maxGradient * .02
+		);
+	}
+
+	{
+		Group group (INPUT_COUNT, OUTPUT_COUNT, LAYER_COUNT, LAYER_WIDTH);
+		initializeHiddenGroup(group, WeightInit::uniform(-1, 1, 6));
+
+		ThreadPool pool (4);
+		HogwildTrainer<Group> trainer (group, pool, .5f);
+
+		auto const initialLoss = trainer.evaluate(inputs.data(), targets.data(), SAMPLE_COUNT);
+		trainer.train(inputs.data(), targets.data(), SAMPLE_COUNT, 200);
+		auto const finalLoss = trainer.evaluate(inputs.data(), targets.data(), SAMPLE_COUNT);
+
+		passed &= report(
+			"HogwildTrainer::train on 4 threads, loss " + std::to_string(initialLoss) +
+			" to " + std::to_string(finalLoss),
+			finalLoss < initialLoss * .9
+		);
+	}
+
+	return passed;
+}
+
+/// Pipelined outputs of a HiddenGroup and a layered::Network against their
+/// own execute, at every stage count, and an idle pipeline has to sleep
+/// rather than spin.
+bool checkPipeline() {
+	using Group = HiddenGroup<Node, ::ListInterface, Sigmoid<> >;
+
+	constexpr std::size_t SAMPLE_COUNT {64};
+
+	Group group (32, 4, 4, 16);
+	initializeHiddenGroup(group, WeightInit::uniform(-.5, .5));
+
+	auto network = layered::generateNetwork(4, 32, 16, 4);
+
+	ListType inputs (32 * SAMPLE_COUNT);
+
+	for (std::size_t i {0}; i < inputs.size(); ++i)
+		inputs[i] = static_cast<FloatType>(i % 17) / 17;
+
+	ListType groupExpected   (4 * SAMPLE_COUNT);
+	ListType networkExpected (4 * SAMPLE_COUNT);
+	{
+		std::vector<Node> nodes (32);
+		ListType networkInputs (32);
+
+		for (std::size_t s {0}; s < SAMPLE_COUNT; ++s) {
+			for (std::size_t i {0}; i < 32; ++i) {
+				nodes[i].setValue(inputs[s * 32 + i]);
+				networkInputs[i] = inputs[s * 32 + i];
+			}
+
+			group.execute(nodes.data(), groupExpected.data() + s * 4, Sigmoid<> {});
+
+			network.execute(networkInputs);
+			auto const outputs = network.getLayers().back().getValues();
+			std::copy(outputs, outputs + 4, networkExpected.begin() + s * 4);
+		}
+	}
+
+	bool passed {true};
+
+	for (std::size_t stageCount {1}; stageCount <= 5; ++stageCount) {
+		ListType outputs (4 * SAMPLE_COUNT);
+
+		StreamingPipeline groupPipeline (group.getPipelineLayers(Sigmoid<> {}), stageCount);
+		groupPipeline.process(inputs.data(), SAMPLE_COUNT, outputs.data());
+
+		passed &= report(
+			"HiddenGroup pipelined over " + std::to_string(groupPipeline.getStageCount()) +
+			" stages matches execute",
+			outputs == groupExpected
+		);
+
+		StreamingPipeline networkPipeline (layered::getPipelineLayers(network), stageCount);
+		networkPipeline.process(inputs.data(), SAMPLE_COUNT, outputs.data());
+
+		passed &= report(
+			"layered::Network pipelined over " + std::to_string(networkPipeline.getStageCount()) +
+			" stages matches execute",
+			outputs == networkExpected
+		);
+	}
+
+	{
+		StreamingPipeline pipeline (layered::getPipelineLayers(network), 4);
+
+		auto const start = std::clock();
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		auto const cpuSeconds = static_cast<double>(std::clock() - start) / CLOCKS_PER_SEC;
+
+		passed &= report(
+			"Idle 4 stage pipeline used " + std::to_string(cpuSeconds) + " s of CPU in 0.2 s",
+			cpuSeconds < .05
+		);
+	}
+
+	return passed;
+}
+
+/// Every weight of a constant::Network through the accessors both
+/// layouts share, in the order saveModelAs writes them.
+template <class NetworkType>
+ListType collectWeights(NetworkType & network) {
+	ListType weights;
+
+	for (std::size_t g {0}; g < network.getHiddenGroupCount(); ++g) {
+		auto & group = network.getHiddenGroup(g);
+		auto const width = group.getNodesPerLayer();
+
+		for (std::size_t i {0}; i < width; ++i) {
+			for (std::size_t j {0}; j < group.getInputNodeCount(); ++j)
+				weights.push_back(*group.getInputWeight(j, i));
+		}
+
+		for (std::size_t l {0}; l < group.getNonTerminalLayerCount(); ++l) {
+			for (std::size_t i {0}; i < width; ++i) {
+				for (std::size_t j {0}; j < width; ++j)
+					weights.push_back(*group.getNonTerminalElement(l, j).getWeight(i));
+			}
+		}
+
+		for (std::size_t o {0}; o < group.getOutputNodeCount(); ++o) {
+			for (std::size_t j {0}; j < width; ++j)
+				weights.push_back(*group.getTerminalElement(j).getWeight(o));
+		}
+	}
+
+	return weights;
+}
+
+/// initializeWeights has to produce the same bits on any number of
+/// threads, whatever the row tiling, and in both group layouts.
+bool checkWeightInitDeterminism() {
+	bool passed {true};
+
+	std::pair<char const *, WeightInit> const inits[] {
+		{"uniform",       WeightInit::uniform(-.5, .5, 3)},
+		{"xavier normal", WeightInit::scaled(WeightDistribution::xavierNormal, 3)}
+	};
+
+	for (auto const & named : inits) {
+		auto const & init = named.second;
+		ListType expected;
+
+		for (std::size_t threadCount : {1, 4}) {
+			auto const pool = std::make_shared<ThreadPool>(threadCount);
+			auto const suffix = std::string(" (") + named.first + ") on " +
+			                    std::to_string(threadCount) + " threads";
+
+			HiddenNet hiddenNet (GROUP_COUNT, INPUT_COUNT, OUTPUT_COUNT, LAYER_COUNT, LAYER_WIDTH, pool);
+			hiddenNet.initializeWeights(init);
+
+			DenseNet denseNet (GROUP_COUNT, INPUT_COUNT, OUTPUT_COUNT, LAYER_COUNT, LAYER_WIDTH, pool);
+			denseNet.initializeWeights(init);
+
+			auto const hiddenWeights = collectWeights(hiddenNet);
+
+			if (expected.empty())
+				expected = hiddenWeights;
+
+			passed &= report("Network::initializeWeights" + suffix + " matches 1 thread",
+			                 hiddenWeights == expected);
+			passed &= report("DenseNetwork::initializeWeights" + suffix + " matches Network",
+			                 collectWeights(denseNet) == expected);
+		}
+	}
+
+	return passed;
+}
+
+/// Writing the weights of a loaded model, which are mapped read-only,
+/// has to throw rather than fault, and saving over the file a network is
+/// mapped from has to leave that network's weights intact.
+bool checkMappedWeights() {
+	char const * const path {"brh_neural_net_checks.model"};
+
+	{
+		DenseNet network (2, 16, 4, 2, 8);
+		network.initializeWeights(WeightInit::uniform(0, .5));
+		saveModel(network, path);
+	}
+
+	bool passed {true};
+
+	{
+		auto network = loadModel<DenseNet>(path);
+
+		auto const throwsInvalidArgument = [](std::function<void()> func) {
+			try {
+				func();
+			}
+			catch (std::invalid_argument const &) {
+				return true;
+			}
+
+			return false;
+		};
+
+		passed &= report("Network::initializeWeights rejects mapped weights",
+		                 throwsInvalidArgument([&] {
+			network.initializeWeights(WeightInit::uniform(0, .5));
+		}));
+
+		passed &= report("initializeHiddenGroup rejects mapped weights",
+		                 throwsInvalidArgument([&] {
+			initializeHiddenGroup(network.getHiddenGroup(0), WeightInit::uniform(0, .5));
+		}));
+
+		auto const getOutputs = [](DenseNet & net) {
+			setInputs(net, 3);
+			net.execute();
+
+			ListType outputs (net.getOutputNodeCount());
+
+			for (std::size_t o {0}; o < outputs.size(); ++o)
+				outputs[o] = net.getOutputNode(o).getValue();
+
+			return outputs;
+		};
+
+		auto const before = getOutputs(network);
+
+		// Truncating the file in place would pull the pages out from under
+		// network.
+		saveModel(network, path);
+
+		auto const after = getOutputs(network);
+		auto reloaded = loadModel<DenseNet>(path);
+
+		passed &= report("Saving over a loaded model keeps it and writes the same weights",
+		                 before == after && before == getOutputs(reloaded));
+	}
+
+	std::remove(path);
+
+	return passed;
+}
+
+}
+
+int main()
+{
+	bool passed {true};
+
+	passed &= checkAllocations();
+	passed &= checkEventExecution();
+	passed &= checkArenaRebuild();
+	passed &= checkParallelExecution();
+	passed &= checkIncrementalAfterInitialize();
+	passed &= checkBatchExecution();
+	passed &= checkWeightInitDeterminism();
+	passed &= checkMappedWeights();
+	passed &= checkLayeredTraining();
+	passed &= checkHogwildTraining();
+	passed &= checkPipeline();
+
+	return passed ? 0 : 1;
+}
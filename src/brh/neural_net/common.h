@@ -5,6 +5,7 @@
 #include <sstream>
 #include <vector>
 #include <functional>
+#include <mutex>
 #include <thread>
 
 using FloatType = float;
@@ -0,0 +1,173 @@
+#ifndef NEURAL_NET_TESTING_SRC_CONSTANT_CSR_MATRIX_H
+#define NEURAL_NET_TESTING_SRC_CONSTANT_CSR_MATRIX_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "../common.h"
+
+namespace brh {
+	namespace neural {
+		namespace constant {
+
+/// Compressed sparse row matrix, memory and multiply time scale with the
+/// number of nonzeros rather than rowCount * columnCount.
+template <
+	class t_FloatType = ::FloatType,
+	template <class T> class t_ListInterface = ::ListInterface
+>
+class CsrMatrix
+{
+	public:
+		template <class T>
+		using ListInterface = t_ListInterface<T>;
+
+		using FloatType = t_FloatType;
+		using IndexType = std::uint32_t;
+
+		using FloatList  = ListInterface<FloatType>;
+		using IndexList  = ListInterface<IndexType>;
+		using OffsetList = ListInterface<std::size_t>;
+
+		/// Empty matrix, no nonzeros.
+		CsrMatrix(std::size_t rowCount = 0, std::size_t columnCount = 0) :
+			rowCount_    {rowCount},
+			columnCount_ {columnCount},
+			rowOffsets_  (rowCount + 1, 0) {}
+
+		/// Keeps the largest-magnitude density fraction of a dense matrix.
+		/// Ties at the cutoff are kept in row-major order until the target
+		/// count is met, so exactly round(density * size) weights survive.
+		/// @param getWeight Called as getWeight(row, column).
+		template <class GetWeight>
+		static CsrMatrix fromDense(std::size_t rowCount,
+		                           std::size_t columnCount,
+		                           GetWeight   getWeight,
+		                           double      density) {
+			CsrMatrix matrix (rowCount, columnCount);
+
+			auto const total = rowCount * columnCount;
+			auto const keepCount = static_cast<std::size_t>(std::round(
+				std::min(std::max(density, 0.0), 1.0) * total
+			));
+
+			if (keepCount == 0)
+				return matrix;
+
+			FloatList magnitudes (total);
+
+			for (std::size_t r {0}; r < rowCount; ++r) {
+				for (std::size_t c {0}; c < columnCount; ++c)
+					magnitudes[r * columnCount + c] = std::abs(getWeight(r, c));
+			}
+
+			auto const cutoffIndex = total - keepCount;
+			std::nth_element(
+				magnitudes.begin(), magnitudes.begin() + cutoffIndex, magnitudes.end()
+			);
+			FloatType const cutoff {magnitudes[cutoffIndex]};
+
+			std::size_t aboveCount {0};
+
+			for (std::size_t r {0}; r < rowCount; ++r) {
+				for (std::size_t c {0}; c < columnCount; ++c) {
+					if (std::abs(getWeight(r, c)) > cutoff)
+						++aboveCount;
+				}
+			}
+
+			std::size_t tiesLeft {keepCount - aboveCount};
+
+			matrix.columnIndices_.reserve(keepCount);
+			matrix.values_.reserve(keepCount);
+
+			for (std::size_t r {0}; r < rowCount; ++r) {
+				for (std::size_t c {0}; c < columnCount; ++c) {
+					FloatType const weight    {getWeight(r, c)};
+					FloatType const magnitude {std::abs(weight)};
+
+					bool keep {magnitude > cutoff};
+
+					if (!keep && magnitude == cutoff && tiesLeft > 0) {
+						keep = true;
+						--tiesLeft;
+					}
+
+					if (keep) {
+						matrix.columnIndices_.push_back(static_cast<IndexType>(c));
+						matrix.values_.push_back(weight);
+					}
+				}
+
+				matrix.rowOffsets_[r + 1] = matrix.values_.size();
+			}
+
+			return matrix;
+		}
+
+		std::size_t getRowCount()     const { return rowCount_; }
+		std::size_t getColumnCount()  const { return columnCount_; }
+		std::size_t getNonZeroCount() const { return values_.size(); }
+
+		OffsetList const & getRowOffsets()    const { return rowOffsets_; }
+		IndexList  const & getColumnIndices() const { return columnIndices_; }
+		FloatList  const & getValues()        const { return values_; }
+		FloatList        & getValues()              { return values_; }
+
+		/// outputs[r] = sum over row r's nonzeros of value * inputs[column]
+		void multiply(FloatType const * inputs, FloatType * outputs) const {
+			multiply(inputs, outputs, 0, rowCount_);
+		}
+
+		/// multiply restricted to rows [rowBegin, rowEnd), outputs is still
+		/// indexed by row.
+		void multiply(FloatType const * inputs,
+		              FloatType       * outputs,
+		              std::size_t       rowBegin,
+		              std::size_t       rowEnd) const {
+			for (std::size_t r {rowBegin}; r < rowEnd; ++r)
+				outputs[r] = multiplyRow(r, inputs);
+		}
+
+		/// Batched multiply, each row's nonzeros are applied to every sample
+		/// while they're in cache.
+		/// @param inputs  sampleCount rows of getColumnCount() values.
+		/// @param outputs sampleCount rows of getRowCount() values.
+		void multiplyBatch(FloatType const * inputs,
+		                   std::size_t       sampleCount,
+		                   FloatType       * outputs) const {
+			for (std::size_t r {0}; r < rowCount_; ++r) {
+				for (std::size_t s {0}; s < sampleCount; ++s) {
+					outputs[s * rowCount_ + r] =
+						multiplyRow(r, inputs + s * columnCount_);
+				}
+			}
+		}
+
+
+	private:
+		FloatType multiplyRow(std::size_t row, FloatType const * inputs) const {
+			FloatType sum {0};
+
+			auto const end = rowOffsets_[row + 1];
+
+			for (std::size_t k {rowOffsets_[row]}; k < end; ++k)
+				sum += values_[k] * inputs[columnIndices_[k]];
+
+			return sum;
+		}
+
+		std::size_t rowCount_;
+		std::size_t columnCount_;
+
+		OffsetList rowOffsets_;
+		IndexList  columnIndices_;
+		FloatList  values_;
+};
+
+		}
+	}
+}
+
+#endif
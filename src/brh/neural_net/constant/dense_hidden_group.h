@@ -0,0 +1,550 @@
+#ifndef NEURAL_NET_TESTING_SRC_CONSTANT_DENSE_HIDDEN_GROUP_H
+#define NEURAL_NET_TESTING_SRC_CONSTANT_DENSE_HIDDEN_GROUP_H
+
+#include <algorithm>
+#include <memory>
+
+#include "../common.h"
+#include "../activation_functions.h"
+#include "../activation_stats.h"
+
+#include "matrix_kernels.h"
+
+namespace brh {
+	namespace neural {
+		namespace constant {
+
+/// Handle to one node of a DenseHiddenGroup, standing in for the
+/// BasicNode references HiddenGroup hands out. The node's outgoing weights
+/// are a column of the next layer's matrix, so they're weightStride apart.
+template <class t_FloatType, class t_WeightType = t_FloatType>
+class DenseNodeRef
+{
+	public:
+		using FloatType      = t_FloatType;
+		using WeightType     = t_WeightType;
+		using WeightPtr      = WeightType *;
+
+		DenseNodeRef(FloatType * value,
+		             WeightPtr   firstWeight,
+		             std::size_t weightStride) :
+			value_        {value},
+			firstWeight_  {firstWeight},
+			weightStride_ {weightStride} {}
+
+		FloatType   getValue() const { return *value_; }
+		FloatType & getValue()       { return *value_; }
+
+		FloatType getWeightedValue(std::size_t weightIndex) const {
+			return getValue() * static_cast<FloatType>(*getWeight(weightIndex));
+		}
+
+		void setValue  (FloatType value)  { *value_ = value; }
+		void addToValue(FloatType amount) { *value_ += amount; }
+		void clearValue() { setValue(0); }
+
+		WeightPtr getWeight(std::size_t index) const {
+			return firstWeight_ + index * weightStride_;
+		}
+
+
+	private:
+		FloatType * value_;
+		WeightPtr   firstWeight_;
+		std::size_t weightStride_;
+};
+
+
+/// Structure-of-arrays counterpart of HiddenGroup.
+///
+/// Node values live in one dense array per layer and each layer's weights
+/// are a row-major matrix of incoming weights, one row per destination
+/// node. Every node is then a unit-stride dot product of its row with the
+/// previous layer's values. The accessors mirror HiddenGroup's, so code
+/// filling in weights works with either.
+///
+/// Data layout, weights_:
+///  Input matrix            | Hidden matrices            | Output matrix
+/// [nodesPerLayer][inputs] | [nodesPerLayer][nodesPer.] | [outputs][nodesPerLayer]
+///
+/// t_WeightType is how the weights are stored, Float16 or BFloat16 halve
+/// their footprint. Node values and sums stay in the node's FloatType, the
+/// weights are widened as the dot products load them.
+template <
+	class t_NodeType,
+	template <class T> class t_ListInterface = ::ListInterface,
+	class t_Activation = SoftStep,
+	class t_WeightType = typename t_NodeType::FloatType
+>
+class DenseHiddenGroup
+{
+	public:
+		template <class T>
+		using ListInterface = t_ListInterface<T>;
+
+
+		using NodeType       = t_NodeType;
+		using NodePtr        = NodeType *;
+		using ActivationType = t_Activation;
+		using FloatType      = typename NodeType::FloatType;
+
+		using FloatList = ListInterface<FloatType>;
+
+		using FloatPtr      = FloatType       *;
+		using ConstFloatPtr = FloatType const *;
+
+		using WeightType     = t_WeightType;
+		using WeightList     = ListInterface<WeightType>;
+		using WeightPtr      = WeightType       *;
+		using ConstWeightPtr = WeightType const *;
+
+		using NodeReference = DenseNodeRef<FloatType, WeightType>;
+
+		using IndexList = ListInterface<std::size_t>;
+
+		DenseHiddenGroup(std::size_t inputNodeCount,
+		                 std::size_t outputNodeCount,
+		                 std::size_t layerCount,
+		                 std::size_t nodesPerLayer) :
+			inputNodeCount_  {inputNodeCount},
+			outputNodeCount_ {outputNodeCount},
+			layerCount_      {layerCount},
+			nodesPerLayer_   {nodesPerLayer},
+			weights_         (getWeightCount()),
+			mappedWeights_   {nullptr},
+			values_          (layerCount * nodesPerLayer),
+			outputValues_    (outputNodeCount),
+			inputValues_     (inputNodeCount) {}
+
+		/// Group reading its weights from memory it doesn't own, such as a
+		/// mapped model file, no weight storage is allocated. The weights
+		/// are treated as read-only: the accessors still hand out WeightPtr
+		/// so reading code works with either kind of group, but writing
+		/// through them faults on a read-only mapping. initializeWeights and
+		/// initializeHiddenGroup check hasMappedWeights and throw. Node
+		/// values stay in the group's own memory.
+		/// @param weights     getWeightCount() values in the layout above.
+		/// @param weightOwner Kept alive for as long as the group is.
+		DenseHiddenGroup(std::size_t                 inputNodeCount,
+		                 std::size_t                 outputNodeCount,
+		                 std::size_t                 layerCount,
+		                 std::size_t                 nodesPerLayer,
+		                 ConstWeightPtr              weights,
+		                 std::shared_ptr<void const> weightOwner) :
+			inputNodeCount_  {inputNodeCount},
+			outputNodeCount_ {outputNodeCount},
+			layerCount_      {layerCount},
+			nodesPerLayer_   {nodesPerLayer},
+			mappedWeights_   {const_cast<WeightPtr>(weights)},
+			weightOwner_     (std::move(weightOwner)),
+			values_          (layerCount * nodesPerLayer),
+			outputValues_    (outputNodeCount),
+			inputValues_     (inputNodeCount) {}
+
+		std::size_t getInputNodeCount()  const { return inputNodeCount_; }
+		std::size_t getOutputNodeCount() const { return outputNodeCount_; }
+		std::size_t getLayerCount()      const { return layerCount_; }
+		std::size_t getNodesPerLayer()   const { return nodesPerLayer_; }
+
+		std::size_t getNonTerminalLayerCount() const {
+			return getLayerCount() - 1;
+		}
+
+		FloatList execute(NodePtr nodes, ActivationType const & activation) {
+			FloatList outValues (getOutputNodeCount());
+			execute(nodes, outValues.data(), activation);
+			return outValues;
+		}
+
+		FloatList execute(ConstFloatPtr inputs, ActivationType const & activation) {
+			FloatList outValues (getOutputNodeCount());
+			execute(inputs, outValues.data(), activation);
+			return outValues;
+		}
+
+		/// execute writing the getOutputNodeCount() results to outValues,
+		/// allocates nothing.
+		void execute(NodePtr                nodes,
+		             FloatPtr               outValues,
+		             ActivationType const & activation) {
+			for (std::size_t i {0}; i < getInputNodeCount(); ++i)
+				inputValues_[i] = nodes[i].getValue();
+
+			execute(inputValues_.data(), outValues, activation);
+		}
+
+		void execute(ConstFloatPtr          inputs,
+		             FloatPtr               outValues,
+		             ActivationType const & activation) {
+			executeInputLayer(inputs, getLayerValues(0), activation);
+			executeFromSecondLayer(values_.data(), getLayerCount(), outValues, activation);
+		}
+
+		/// Floats of workspace executeInto needs.
+		std::size_t getWorkspaceSize() const {
+			return 2 * getNodesPerLayer();
+		}
+
+		/// execute keeping every node value in workspace rather than in the
+		/// group, which is only read. Threads may execute one group
+		/// concurrently, each with a workspace of its own.
+		/// @param workspace getWorkspaceSize() floats.
+		void executeInto(ConstFloatPtr          inputs,
+		                 FloatPtr               outValues,
+		                 FloatPtr               workspace,
+		                 ActivationType const & activation) const {
+			executeInputLayer(inputs, workspace, activation);
+			executeFromSecondLayer(workspace, 2, outValues, activation);
+		}
+
+		/// execute for inputs that mostly repeat the previous call's.
+		/// The input layer's pre-activation sums are kept between calls and
+		/// only deltas[k] * (weight column changedInputs[k]) is added to
+		/// them. Every later node depends on all of the first layer, whose
+		/// values all move as soon as one input does, so the later layers
+		/// are recomputed as usual.
+		/// @param inputs    The current input values.
+		/// @param recompute Rebuild the sums from inputs instead of applying
+		///                  the deltas, needed on the first call and now and
+		///                  then to drop accumulated rounding error.
+		/// @param outValues Receives the getOutputNodeCount() results.
+		void executeIncremental(ConstFloatPtr          inputs,
+		                        IndexList      const & changedInputs,
+		                        FloatList      const & deltas,
+		                        bool                   recompute,
+		                        FloatPtr               outValues,
+		                        ActivationType const & activation) {
+			auto const width = getNodesPerLayer();
+			auto const inputCount = getInputNodeCount();
+
+			if (recompute || inputSums_.size() != width) {
+				inputSums_.resize(width);
+				multiplyRows(getInputMatrix(), width, inputCount, inputs, inputSums_.data());
+			}
+			else if (!changedInputs.empty()) {
+				auto const changedCount = changedInputs.size();
+
+				for (std::size_t r {0}; r < width; ++r) {
+					auto const row = getInputMatrix() + r * inputCount;
+					FloatType sum {0};
+
+					for (std::size_t k {0}; k < changedCount; ++k)
+						sum += deltas[k] * static_cast<FloatType>(row[changedInputs[k]]);
+
+					inputSums_[r] += sum;
+				}
+			}
+
+			std::copy(inputSums_.begin(), inputSums_.end(), getLayerValues(0));
+			applyActivationConcurrent(getLayerValues(0), width, activation);
+
+			executeFromSecondLayer(values_.data(), getLayerCount(), outValues, activation);
+		}
+
+		/// See HiddenGroup::executeBatch.
+		FloatList executeBatch(ConstFloatPtr          inputs,
+		                       std::size_t            sampleCount,
+		                       ActivationType const & activation) {
+			if (sampleCount == 1)
+				return execute(inputs, activation);
+
+			auto const width = getNodesPerLayer();
+
+			FloatList current (sampleCount * width);
+			FloatList next    (sampleCount * width);
+
+			multiplyRowsBlocked(
+				getInputMatrix(), width, getInputNodeCount(),
+				inputs, sampleCount, current.data()
+			);
+			applyActivation(current.data(), current.size(), activation);
+
+			for (std::size_t layerIndex {1}; layerIndex < getLayerCount(); ++layerIndex) {
+				multiplyRowsBlocked(
+					getHiddenMatrix(layerIndex - 1), width, width,
+					current.data(), sampleCount, next.data()
+				);
+				applyActivation(next.data(), next.size(), activation);
+				current.swap(next);
+			}
+
+			FloatList outValues (sampleCount * getOutputNodeCount());
+
+			multiplyRowsBlocked(
+				getOutputMatrix(), getOutputNodeCount(), width,
+				current.data(), sampleCount, outValues.data()
+			);
+			applyActivation(outValues.data(), outValues.size(), activation);
+
+			return outValues;
+		}
+
+
+		// Row-range execution, for splitting one group across threads.
+		// Stage 0 multiplies the inputs by the input matrix, stage l the
+		// previous layer's values by hidden matrix l - 1 and the last stage
+		// produces the outputs. Row ranges of one stage may run
+		// concurrently, the stages themselves must run in order.
+
+		std::size_t getStageCount() const {
+			return getLayerCount() + 1;
+		}
+
+		std::size_t getStageRowCount(std::size_t stage) const {
+			return stage < getLayerCount() ? getNodesPerLayer() : getOutputNodeCount();
+		}
+
+		std::size_t getStageColumnCount(std::size_t stage) const {
+			return stage == 0 ? getInputNodeCount() : getNodesPerLayer();
+		}
+
+		/// Computes and activates rows [rowBegin, rowEnd) of a stage.
+		/// @param inputs getInputNodeCount() values, only read by stage 0.
+		void executeStageRows(std::size_t            stage,
+		                      ConstFloatPtr          inputs,
+		                      std::size_t            rowBegin,
+		                      std::size_t            rowEnd,
+		                      ActivationType const & activation) {
+			auto const columnCount = getStageColumnCount(stage);
+
+			ConstWeightPtr matrix;
+			ConstFloatPtr  stageInputs;
+			FloatPtr       stageOutputs;
+
+			if (stage == 0) {
+				matrix       = getInputMatrix();
+				stageInputs  = inputs;
+				stageOutputs = getLayerValues(0);
+			}
+			else if (stage < getLayerCount()) {
+				matrix       = getHiddenMatrix(stage - 1);
+				stageInputs  = getLayerValues(stage - 1);
+				stageOutputs = getLayerValues(stage);
+			}
+			else {
+				matrix       = getOutputMatrix();
+				stageInputs  = getLayerValues(getNonTerminalLayerCount());
+				stageOutputs = outputValues_.data();
+			}
+
+			multiplyRows(
+				matrix + rowBegin * columnCount, rowEnd - rowBegin, columnCount,
+				stageInputs, stageOutputs + rowBegin
+			);
+			applyActivationConcurrent(stageOutputs + rowBegin, rowEnd - rowBegin, activation);
+		}
+
+		/// getOutputNodeCount() values written by the last stage.
+		ConstFloatPtr getStageOutputs() const {
+			return outputValues_.data();
+		}
+
+		/// Activates values in place, sampling them into the
+		/// ActivationTracer when tracing is enabled.
+		void applyActivation(FloatPtr               values,
+		                     std::size_t            count,
+		                     ActivationType const & activation) {
+			if (!ActivationTracer::isEnabled()) {
+				activation(values, count);
+				return;
+			}
+
+			tracedValues_.assign(values, values + count);
+			activation(values, count);
+			ActivationTracer::record(tracedValues_.data(), values, count);
+		}
+
+
+		// Accessors matching HiddenGroup's
+		WeightPtr getInputWeight(std::size_t inputNodeIndex,
+		                         std::size_t weightIndex) {
+			return getInputMatrix() + weightIndex * getInputNodeCount() + inputNodeIndex;
+		}
+
+		NodeReference getNonTerminalElement(std::size_t layerIndex,
+		                                    std::size_t nodeIndex) {
+			return {
+				getLayerValues(layerIndex) + nodeIndex,
+				getHiddenMatrix(layerIndex) + nodeIndex,
+				getNodesPerLayer()
+			};
+		}
+
+		NodeReference getTerminalElement(std::size_t nodeIndex) {
+			return {
+				getLayerValues(getNonTerminalLayerCount()) + nodeIndex,
+				getOutputMatrix() + nodeIndex,
+				getNodesPerLayer()
+			};
+		}
+
+		NodeReference getLayerElement(std::size_t layerIndex,
+		                              std::size_t nodeIndex) {
+			if (layerIndex < getNonTerminalLayerCount())
+				return getNonTerminalElement(layerIndex, nodeIndex);
+			else
+				return getTerminalElement(nodeIndex);
+		}
+
+
+		// Dense views
+		/// getNodesPerLayer() values of a layer, the last being the terminal one.
+		FloatPtr      getLayerValues(std::size_t layerIndex) {
+			return values_.data() + layerIndex * getNodesPerLayer();
+		}
+
+		ConstFloatPtr getLayerValues(std::size_t layerIndex) const {
+			return values_.data() + layerIndex * getNodesPerLayer();
+		}
+
+		/// All getWeightCount() weights, in the layout described above.
+		WeightPtr      getWeightData() {
+			return mappedWeights_ ? mappedWeights_ : weights_.data();
+		}
+
+		ConstWeightPtr getWeightData() const {
+			return mappedWeights_ ? mappedWeights_ : weights_.data();
+		}
+
+		/// Whether the weights are read from outside the group, and so must
+		/// not be written.
+		bool hasMappedWeights() const {
+			return mappedWeights_ != nullptr;
+		}
+
+		/// [nodesPerLayer][inputNodeCount]
+		WeightPtr      getInputMatrix()       { return getWeightData(); }
+		ConstWeightPtr getInputMatrix() const { return getWeightData(); }
+
+		/// [nodesPerLayer][nodesPerLayer], from layer layerIndex to the next.
+		WeightPtr      getHiddenMatrix(std::size_t layerIndex) {
+			return getWeightData() + getHiddenMatrixOffset(layerIndex);
+		}
+
+		ConstWeightPtr getHiddenMatrix(std::size_t layerIndex) const {
+			return getWeightData() + getHiddenMatrixOffset(layerIndex);
+		}
+
+		/// [outputNodeCount][nodesPerLayer]
+		WeightPtr      getOutputMatrix() {
+			return getWeightData() + getOutputMatrixOffset();
+		}
+
+		ConstWeightPtr getOutputMatrix() const {
+			return getWeightData() + getOutputMatrixOffset();
+		}
+
+
+		std::size_t getInputWeightCount() const {
+			return getNodesPerLayer() * getInputNodeCount();
+		}
+
+		std::size_t getOutputWeightCount() const {
+			return getNodesPerLayer() * getOutputNodeCount();
+		}
+
+		std::size_t getWeightsPerLayer() const {
+			return getNodesPerLayer() * getNodesPerLayer();
+		}
+
+		std::size_t getWeightCount() const {
+			return getInputWeightCount() +
+			       getWeightsPerLayer() * getNonTerminalLayerCount() +
+			       getOutputWeightCount();
+		}
+
+
+	private:
+		/// Computes and activates the first layer into layerValues.
+		void executeInputLayer(ConstFloatPtr          inputs,
+		                       FloatPtr               layerValues,
+		                       ActivationType const & activation) const {
+			auto const width = getNodesPerLayer();
+
+			multiplyRows(getInputMatrix(), width, getInputNodeCount(), inputs, layerValues);
+			applyActivationConcurrent(layerValues, width, activation);
+		}
+
+		/// The rest of execute once the first layer holds its values.
+		/// Layer l's values are in slot l % slotCount of values, so one
+		/// slot per layer keeps them all and two just alternate.
+		void executeFromSecondLayer(FloatPtr               values,
+		                            std::size_t            slotCount,
+		                            FloatPtr               outValues,
+		                            ActivationType const & activation) const {
+			auto const width = getNodesPerLayer();
+
+			auto layer = [&](std::size_t layerIndex) {
+				return values + (layerIndex % slotCount) * width;
+			};
+
+			for (std::size_t layerIndex {1}; layerIndex < getLayerCount(); ++layerIndex) {
+				multiplyRows(
+					getHiddenMatrix(layerIndex - 1), width, width,
+					layer(layerIndex - 1), layer(layerIndex)
+				);
+				applyActivationConcurrent(layer(layerIndex), width, activation);
+			}
+
+			multiplyRows(
+				getOutputMatrix(), getOutputNodeCount(), width,
+				layer(getNonTerminalLayerCount()), outValues
+			);
+			applyActivationConcurrent(outValues, getOutputNodeCount(), activation);
+		}
+
+		/// applyActivation for code that may run on several threads at
+		/// once, which can't share tracedValues_. Allocates while tracing.
+		static void applyActivationConcurrent(FloatPtr               values,
+		                                      std::size_t            count,
+		                                      ActivationType const & activation) {
+			if (!ActivationTracer::isEnabled()) {
+				activation(values, count);
+				return;
+			}
+
+			FloatList const preActivation (values, values + count);
+			activation(values, count);
+			ActivationTracer::record(preActivation.data(), values, count);
+		}
+
+		std::size_t getHiddenMatrixOffset(std::size_t layerIndex) const {
+			return getInputWeightCount() + layerIndex * getWeightsPerLayer();
+		}
+
+		std::size_t getOutputMatrixOffset() const {
+			return getHiddenMatrixOffset(getNonTerminalLayerCount());
+		}
+
+
+		std::size_t inputNodeCount_;
+		std::size_t outputNodeCount_;
+		std::size_t layerCount_;
+		std::size_t nodesPerLayer_;
+
+		WeightList weights_;
+
+		/// Set when the weights live outside the group, weights_ is empty.
+		WeightPtr                   mappedWeights_;
+		std::shared_ptr<void const> weightOwner_;
+
+		FloatList values_;
+
+		/// Results of the last stage of executeStageRows.
+		FloatList outputValues_;
+
+		/// Input layer pre-activation sums kept by executeIncremental.
+		FloatList inputSums_;
+
+		/// Input node values gathered for execute(NodePtr, ...).
+		FloatList inputValues_;
+
+		/// Pre-activation copy, only filled in while tracing.
+		FloatList tracedValues_;
+};
+
+		}
+	}
+}
+
+#endif
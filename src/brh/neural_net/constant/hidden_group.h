@@ -2,8 +2,15 @@
 #define NEURAL_NET_TESTING_HIDDEN_GROUP_H
 
 #include <iostream>
+#include <algorithm>
+#include <type_traits>
 
 #include "../common.h"
+#include "../activation_functions.h"
+#include "../activation_stats.h"
+#include "../pipeline.h"
+
+#include "matrix_kernels.h"
 
 namespace brh {
 	namespace neural {
@@ -11,7 +18,8 @@ namespace brh {
 
 template <
 	class t_NodeType,
-	template <class T> class t_ListInterface = ::ListInterface
+	template <class T> class t_ListInterface = ::ListInterface,
+	class t_Activation = SoftStep
 >
 class HiddenGroup
 {
@@ -21,12 +29,16 @@ class HiddenGroup
 
 
 		using NodeType  = t_NodeType;
+		using ActivationType = t_Activation;
 		using NodePtr   = NodeType *;
 		using NodeReference   = NodeType &;
 		using FloatType = typename NodeType::FloatType;
 
 		using FloatList = ListInterface<FloatType>;
 
+		/// Weights share the node buffer, so they're stored as FloatType.
+		using WeightType = FloatType;
+
 		using FloatPtr      = FloatType       *;
 		using ConstFloatPtr = FloatType const *;
 
@@ -41,87 +53,204 @@ class HiddenGroup
 			outputNodeCount_ {outputNodeCount},
 			layerCount_      {layerCount},
 			nodesPerLayer_   {nodesPerLayer},
-			buffer_          (getFloatCount()) { generateBuffer(); }
+			buffer_          (getFloatCount()),
+			layerValues_     (nodesPerLayer) { generateBuffer(); }
 
 		std::size_t getInputNodeCount()  const { return inputNodeCount_; }
 		std::size_t getOutputNodeCount() const { return outputNodeCount_; }
 		std::size_t getLayerCount()      const { return layerCount_; }
 		std::size_t getNodesPerLayer()   const { return nodesPerLayer_; }
 
-		FloatList execute(NodePtr nodes, FunctionType activation) {
-			auto nonTerm = getNonTerminalElement(0, 0);
+		FloatList execute(NodePtr nodes, ActivationType const & activation) {
+			FloatList outValues (getOutputNodeCount());
+			execute(nodes, outValues.data(), activation);
+			return outValues;
+		}
+
+		/// execute writing the getOutputNodeCount() results to outValues,
+		/// allocates nothing.
+		void execute(NodePtr                nodes,
+		             FloatPtr               outValues,
+		             ActivationType const & activation) {
 			std::size_t layerIndex {0};
 
-			for (std::size_t i {0}; i < getNodesPerLayer(); ++i) {
-				auto & node = getNonTerminalElement(layerIndex, i);
-				node.clearValue();
+			// Each source node's weights are contiguous, so its
+			// contribution to the next layer is one axpy.
+			auto const width = getNodesPerLayer();
+			FloatPtr sums {layerValues_.data()};
+
+			std::fill(sums, sums + width, FloatType {0});
+
+			for (std::size_t j {0}; j < getInputNodeCount(); ++j)
+				axpy(nodes[j].getValue(), getInputWeight(j, 0), sums, width);
+
+			applyActivation(layerIndex, activation);
+
+			++layerIndex;
+
+			while (layerIndex < getLayerCount()) {
+				std::fill(sums, sums + width, FloatType {0});
 
-				for (std::size_t j {0}; j < getInputNodeCount(); ++j) {
-					//std::cout << nodes[j].getValue() << " " << *getInputWeight(j, i) << '\n';
-					node.addToValue(nodes[j].getValue() * (*getInputWeight(j, i)));
+				for (std::size_t j {0}; j < width; ++j) {
+					auto & source = getNonTerminalElement(layerIndex - 1, j);
+					axpy(source.getValue(), source.getWeight(0), sums, width);
 				}
 
-				applyActivation(node, activation);
+				applyActivation(layerIndex, activation);
+
+				++layerIndex;
 			}
 
-			++layerIndex;
+			std::fill(outValues, outValues + getOutputNodeCount(), FloatType {0});
 
-			while (layerIndex < getNonTerminalLayerCount()) {
-				for (std::size_t i {0}; i < getNodesPerLayer(); ++i) {
-					auto & node = getNonTerminalElement(layerIndex, i);
-					node.clearValue();
+			for (std::size_t j {0}; j < width; ++j) {
+				auto & source = getTerminalElement(j);
+				axpy(source.getValue(), source.getWeight(0), outValues, getOutputNodeCount());
+			}
 
-					for (std::size_t j {0}; j < getNodesPerLayer(); ++j) {
-						node.addToValue(
-							getNonTerminalElement(layerIndex, j).getWeightedValue(i)
-						);
-					}
+			applyActivation(outValues, getOutputNodeCount(), activation);
+		}
 
-					applyActivation(node, activation);
+		/// Executes sampleCount input rows at once.
+		/// Each weight tile is loaded once and reused across the whole batch,
+		/// the node values held by the group are left untouched.
+		/// @param inputs sampleCount rows of getInputNodeCount() values.
+		/// @return sampleCount rows of getOutputNodeCount() values.
+		FloatList executeBatch(ConstFloatPtr          inputs,
+		                       std::size_t            sampleCount,
+		                       ActivationType const & activation) {
+			if (sampleCount == 1) {
+				ListInterface<NodeType> nodes (getInputNodeCount());
+
+				for (std::size_t i {0}; i < getInputNodeCount(); ++i) {
+					nodes[i].setValue(inputs[i]);
 				}
 
-				++layerIndex;
+				return execute(nodes.data(), activation);
 			}
 
-			std::size_t lastNonTerminal {layerIndex - 1};
+			auto const width = getNodesPerLayer();
+
+			FloatList current (sampleCount * width);
+			FloatList next    (sampleCount * width);
+
+			multiplyBlocked(
+				inputs, getInputNodeCount(), sampleCount, getInputNodeCount(),
+				getInputWeight(0, 0), getInputElementSize(),
+				current.data(), width, width
+			);
+			applyActivation(current, activation);
+
+			for (std::size_t layerIndex {0}; layerIndex < getNonTerminalLayerCount();
+			     ++layerIndex) {
+				std::fill(next.begin(), next.end(), FloatType {0});
+				multiplyBlocked(
+					current.data(), width, sampleCount, width,
+					getNonTerminalElement(layerIndex, 0).getWeight(0),
+					getNonTerminalElementSize(),
+					next.data(), width, width
+				);
+				applyActivation(next, activation);
+				current.swap(next);
+			}
 
-			for (std::size_t i {0}; i < getNodesPerLayer(); ++i) {
-				auto & node = getTerminalElement(i);
-				node.clearValue();
+			FloatList outValues (sampleCount * getOutputNodeCount());
 
-				for (std::size_t j {0}; j < getNodesPerLayer(); ++j) {
-					node.addToValue(
-						getNonTerminalElement(lastNonTerminal, j).getWeightedValue(i)
-					);
+			multiplyBlocked(
+				current.data(), width, sampleCount, width,
+				getTerminalElement(0).getWeight(0), getTerminalElementSize(),
+				outValues.data(), getOutputNodeCount(), getOutputNodeCount()
+			);
+			applyActivation(outValues, activation);
+
+			return outValues;
+		}
+
+		/// The group as getLayerCount() + 1 pipeline layers, computing what
+		/// execute does without touching the nodes' values. The layers only
+		/// read the weights, so the group must outlive them and must not be
+		/// trained while they run. Values aren't sampled by the
+		/// ActivationTracer.
+		PipelineLayerList getPipelineLayers(ActivationType const & activation) {
+			static_assert(std::is_same<FloatType, ::FloatType>::value,
+			              "Pipelines stream ::FloatType values");
+
+			auto const width = getNodesPerLayer();
+
+			PipelineLayerList layers;
+
+			layers.push_back({getInputNodeCount(), width,
+				[this, width, activation](ConstFloatPtr values, FloatPtr sums) {
+					std::fill(sums, sums + width, FloatType {0});
+
+					for (std::size_t j {0}; j < getInputNodeCount(); ++j)
+						axpy(values[j], getInputWeight(j, 0), sums, width);
+
+					activation(sums, width);
 				}
+			});
+
+			for (std::size_t layerIndex {1}; layerIndex < getLayerCount(); ++layerIndex) {
+				layers.push_back({width, width,
+					[this, width, layerIndex, activation](ConstFloatPtr values, FloatPtr sums) {
+						std::fill(sums, sums + width, FloatType {0});
+
+						for (std::size_t j {0}; j < width; ++j) {
+							axpy(values[j], getNonTerminalElement(layerIndex - 1, j).getWeight(0),
+							     sums, width);
+						}
 
-				applyActivation(node, activation);
+						activation(sums, width);
+					}
+				});
 			}
 
-			FloatList outValues(getOutputNodeCount());
+			layers.push_back({width, getOutputNodeCount(),
+				[this, width, activation](ConstFloatPtr values, FloatPtr sums) {
+					std::fill(sums, sums + getOutputNodeCount(), FloatType {0});
 
-			for (std::size_t i {0}; i < getOutputNodeCount(); ++i) {
-				FloatType & value = outValues[i];
-				value = 0;
+					for (std::size_t j {0}; j < width; ++j)
+						axpy(values[j], getTerminalElement(j).getWeight(0), sums, getOutputNodeCount());
 
-				for (std::size_t j {0}; j < getNodesPerLayer(); ++j) {
-					value += getTerminalElement(j).getWeightedValue(i);
+					activation(sums, getOutputNodeCount());
 				}
+			});
 
-				value = activation(value);
+			return layers;
+		}
+
+		/// Activates the sums in layerValues_ as one array and stores the
+		/// results into the nodes of the given layer, getNonTerminalLayerCount()
+		/// being the terminal layer.
+		void applyActivation(std::size_t            layerIndex,
+		                     ActivationType const & activation) {
+			auto const count = getNodesPerLayer();
+
+			applyActivation(layerValues_.data(), count, activation);
+
+			for (std::size_t i {0}; i < count; ++i) {
+				getLayerElement(layerIndex, i).setValue(layerValues_[i]);
 			}
+		}
 
-			return outValues;
+		void applyActivation(FloatList            & values,
+		                     ActivationType const & activation) {
+			applyActivation(values.data(), values.size(), activation);
 		}
 
-		void applyActivation(NodeType   & node,
-		                     FunctionType activation) {
-			auto temp = node.getValue();
-			node.applyActivation(activation);
+		/// Activates values in place, sampling them into the
+		/// ActivationTracer when tracing is enabled.
+		void applyActivation(FloatPtr               values,
+		                     std::size_t            count,
+		                     ActivationType const & activation) {
+			if (!ActivationTracer::isEnabled()) {
+				activation(values, count);
+				return;
+			}
 
-			std::stringstream stream;
-			stream << temp << " " << node.getValue();
-			printThreadLineMt(stream.str());
+			tracedValues_.assign(values, values + count);
+			activation(values, count);
+			ActivationTracer::record(tracedValues_.data(), values, count);
 		}
 
 
@@ -149,9 +278,6 @@ class HiddenGroup
 
 		std::size_t getNonTerminalElementIndex(std::size_t layerIndex,
 		                                       std::size_t nodeIndex) const {
-			auto x = getFirstNonTerminalElementIndex();
-			auto y = layerIndex * getNonTerminalLayerSize();
-			auto z = nodeIndex  * getNonTerminalElementSize();
 			return getFirstNonTerminalElementIndex() +
 		         layerIndex * getNonTerminalLayerSize() +
 				     nodeIndex  * getNonTerminalElementSize();
@@ -169,7 +295,6 @@ class HiddenGroup
 		}
 
 		std::size_t getTerminalElementIndex(std::size_t nodeIndex) const {
-			auto x = getFirstTerminalElementIndex();
 			return getFirstTerminalElementIndex() +
 		         nodeIndex * getTerminalElementSize();
 		}
@@ -179,6 +304,16 @@ class HiddenGroup
 		}
 
 
+		// Either
+		NodeReference getLayerElement(std::size_t layerIndex,
+		                              std::size_t nodeIndex) {
+			if (layerIndex < getNonTerminalLayerCount())
+				return getNonTerminalElement(layerIndex, nodeIndex);
+			else
+				return getTerminalElement(nodeIndex);
+		}
+
+
 		// Input
 		std::size_t getInputElementSize() const {
 			return getNodesPerLayer();
@@ -268,6 +403,12 @@ class HiddenGroup
 		std::size_t nodesPerLayer_;
 
 		BufferType buffer_;
+
+		/// Sums of the layer being executed, activated as one array.
+		FloatList layerValues_;
+
+		/// Pre-activation copy, only filled in while tracing.
+		FloatList tracedValues_;
 };
 
 		}
@@ -0,0 +1,418 @@
+#ifndef NEURAL_NET_TESTING_SRC_CONSTANT_HOGWILD_TRAINER_H
+#define NEURAL_NET_TESTING_SRC_CONSTANT_HOGWILD_TRAINER_H
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <ostream>
+
+#include "../common.h"
+#include "../thread_pool.h"
+
+#include "matrix_kernels.h"
+
+namespace brh {
+	namespace neural {
+		namespace constant {
+
+/// Outcome of one training run.
+struct TrainingReport
+{
+	std::size_t sampleCount;
+	double      seconds;
+
+	/// Mean loss of the samples as they were trained on, per epoch.
+	std::vector<double> epochLosses;
+
+	double getSamplesPerSecond() const {
+		return seconds == 0 ? 0 : sampleCount / seconds;
+	}
+};
+
+
+/// Trains a HiddenGroup in place with per-sample SGD on half the squared
+/// error, using the group's ActivationType and its derivative.
+///
+/// train is lock-free Hogwild (Niu et al., "HOGWILD!: A Lock-Free
+/// Approach to Parallelizing Stochastic Gradient Descent"). Every thread
+/// takes its own slice of the samples and writes each sample's update
+/// straight into the group's buffer, racing with the other threads'
+/// reads and writes. An update can be lost or computed from weights
+/// another thread is halfway through changing, which SGD tolerates when
+/// updates are small and mostly touch different weights. Sources whose
+/// value is zero are skipped, so sparse inputs only touch their own rows.
+///
+/// trainSynchronous is the baseline: each step runs one shard of samples
+/// per thread into thread-local gradients, waits for all of them and
+/// applies the summed gradient once.
+///
+/// Threads keep their layer values in their own scratch, the node values
+/// stored in the group's buffer are never written.
+template <class t_HiddenGroup>
+class HogwildTrainer
+{
+	public:
+		using HiddenGroupType = t_HiddenGroup;
+		using FloatType       = typename HiddenGroupType::FloatType;
+		using ActivationType  = typename HiddenGroupType::ActivationType;
+
+		template <class T>
+		using ListInterface = typename HiddenGroupType::template ListInterface<T>;
+
+		using FloatList = ListInterface<FloatType>;
+
+		using FloatPtr      = FloatType       *;
+		using ConstFloatPtr = FloatType const *;
+
+		/// Samples each thread runs per synchronous step.
+		static constexpr std::size_t SHARD_SIZE {4};
+
+		HogwildTrainer(HiddenGroupType      & group,
+		               ThreadPool           & pool,
+		               FloatType              learningRate,
+		               ActivationType const & activation = ActivationType()) :
+			group_        (group),
+			pool_         (pool),
+			learningRate_ {learningRate},
+			activation_   (activation),
+			scratches_    (pool.getThreadCount()) {
+			for (auto & scratch : scratches_) {
+				scratch.values.resize(group_.getLayerCount() * group_.getNodesPerLayer());
+				scratch.outputs.resize(group_.getOutputNodeCount());
+				scratch.deltas.resize(std::max(group_.getNodesPerLayer(), group_.getOutputNodeCount()));
+				scratch.previousDeltas.resize(group_.getNodesPerLayer());
+			}
+		}
+
+		FloatType getLearningRate() const { return learningRate_; }
+		void setLearningRate(FloatType learningRate) { learningRate_ = learningRate; }
+
+		/// @param inputs  sampleCount rows of getInputNodeCount() values.
+		/// @param targets sampleCount rows of getOutputNodeCount() values.
+		TrainingReport train(ConstFloatPtr inputs,
+		                     ConstFloatPtr targets,
+		                     std::size_t   sampleCount,
+		                     std::size_t   epochCount) {
+			auto const threadCount = std::min(scratches_.size(), sampleCount);
+
+			return runEpochs(sampleCount, epochCount, [&] {
+				pool_.run(threadCount, [&](std::size_t t) {
+					auto & scratch = scratches_[t];
+					double loss {0};
+
+					auto const end = (t + 1) * sampleCount / threadCount;
+
+					for (auto i = t * sampleCount / threadCount; i < end; ++i) {
+						loss += trainSample(
+							scratch, getInput(inputs, i), getTarget(targets, i),
+							getWeights(), -learningRate_
+						);
+					}
+
+					scratch.loss = loss;
+				});
+
+				return sumLosses(threadCount);
+			});
+		}
+
+		/// Same samples, loss and learning rate per sample as train, with a
+		/// barrier and one update every getThreadCount() * SHARD_SIZE samples.
+		TrainingReport trainSynchronous(ConstFloatPtr inputs,
+		                                ConstFloatPtr targets,
+		                                std::size_t   sampleCount,
+		                                std::size_t   epochCount) {
+			auto const floatCount  = getFloatCount();
+			auto const threadCount = scratches_.size();
+			auto const stepSize    = threadCount * SHARD_SIZE;
+
+			for (auto & scratch : scratches_)
+				scratch.gradients.assign(floatCount, 0);
+
+			return runEpochs(sampleCount, epochCount, [&] {
+				double loss {0};
+
+				for (std::size_t begin {0}; begin < sampleCount; begin += stepSize) {
+					auto const count = std::min(stepSize, sampleCount - begin);
+
+					pool_.run(threadCount, [&](std::size_t t) {
+						auto & scratch = scratches_[t];
+						double shardLoss {0};
+
+						auto const end = begin + (t + 1) * count / threadCount;
+
+						for (auto i = begin + t * count / threadCount; i < end; ++i) {
+							shardLoss += trainSample(
+								scratch, getInput(inputs, i), getTarget(targets, i),
+								scratch.gradients.data(), 1
+							);
+						}
+
+						scratch.loss = shardLoss;
+					});
+
+					loss += sumLosses(threadCount);
+					applyGradients();
+				}
+
+				return loss;
+			});
+		}
+
+		/// Mean loss over the samples, on the calling thread.
+		double evaluate(ConstFloatPtr inputs,
+		                ConstFloatPtr targets,
+		                std::size_t   sampleCount) {
+			auto & scratch = scratches_.front();
+			double loss {0};
+
+			for (std::size_t i {0}; i < sampleCount; ++i)
+				loss += forward(scratch, getInput(inputs, i), getTarget(targets, i));
+
+			return sampleCount == 0 ? 0 : loss / sampleCount;
+		}
+
+
+	private:
+		struct Scratch
+		{
+			/// getLayerCount() rows of getNodesPerLayer() activated values.
+			FloatList values;
+			FloatList outputs;
+
+			/// Loss gradients with respect to the sums of the layer being
+			/// trained and of the one before it.
+			FloatList deltas;
+			FloatList previousDeltas;
+
+			/// Only used by trainSynchronous, laid out like the group's
+			/// buffer.
+			FloatList gradients;
+
+			/// Written once per run of the pool, so threads don't share
+			/// a line while training.
+			double loss;
+		};
+
+		template <class EpochFunc>
+		TrainingReport runEpochs(std::size_t sampleCount,
+		                         std::size_t epochCount,
+		                         EpochFunc   runEpoch) {
+			using Clock = std::chrono::steady_clock;
+
+			TrainingReport report {sampleCount * epochCount, 0, {}};
+			auto const start = Clock::now();
+
+			for (std::size_t e {0}; e < epochCount; ++e) {
+				auto const loss = runEpoch();
+				report.epochLosses.push_back(sampleCount == 0 ? 0 : loss / sampleCount);
+			}
+
+			report.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+			return report;
+		}
+
+		double sumLosses(std::size_t threadCount) const {
+			double loss {0};
+
+			for (std::size_t t {0}; t < threadCount; ++t)
+				loss += scratches_[t].loss;
+
+			return loss;
+		}
+
+		ConstFloatPtr getInput(ConstFloatPtr inputs, std::size_t sample) const {
+			return inputs + sample * group_.getInputNodeCount();
+		}
+
+		ConstFloatPtr getTarget(ConstFloatPtr targets, std::size_t sample) const {
+			return targets + sample * group_.getOutputNodeCount();
+		}
+
+		/// The group's buffer starts with the input weights.
+		FloatPtr getWeights() { return group_.getInputWeight(0, 0); }
+
+		std::size_t getFloatCount() const {
+			return group_.getFirstTerminalElementIndex() + group_.getTerminalLayerSize();
+		}
+
+		FloatPtr getLayerValues(Scratch & scratch, std::size_t layer) const {
+			return scratch.values.data() + layer * group_.getNodesPerLayer();
+		}
+
+		/// Weights from node `source` of layer `layer` into the next layer,
+		/// layer 0 being the inputs and getLayerCount() the last hidden
+		/// layer.
+		FloatPtr getWeightRow(std::size_t layer, std::size_t source) {
+			if (layer == 0)
+				return group_.getInputWeight(source, 0);
+
+			if (layer < group_.getLayerCount())
+				return group_.getNonTerminalElement(layer - 1, source).getWeight(0);
+
+			return group_.getTerminalElement(source).getWeight(0);
+		}
+
+		/// Runs the sample through the group into scratch, as
+		/// HiddenGroup::execute does, and returns its loss.
+		double forward(Scratch & scratch, ConstFloatPtr input, ConstFloatPtr target) {
+			auto const width       = group_.getNodesPerLayer();
+			auto const outputCount = group_.getOutputNodeCount();
+
+			for (std::size_t layer {0}; layer <= group_.getLayerCount(); ++layer) {
+				bool const last {layer == group_.getLayerCount()};
+
+				ConstFloatPtr sources {layer == 0 ? input : getLayerValues(scratch, layer - 1)};
+				auto const sourceCount = layer == 0 ? group_.getInputNodeCount() : width;
+
+				FloatPtr sums {last ? scratch.outputs.data() : getLayerValues(scratch, layer)};
+				auto const sumCount = last ? outputCount : width;
+
+				std::fill(sums, sums + sumCount, FloatType {0});
+
+				for (std::size_t j {0}; j < sourceCount; ++j) {
+					if (sources[j] != 0)
+						axpy(sources[j], getWeightRow(layer, j), sums, sumCount);
+				}
+
+				activation_(sums, sumCount);
+			}
+
+			double loss {0};
+
+			for (std::size_t o {0}; o < outputCount; ++o) {
+				auto const error = scratch.outputs[o] - target[o];
+				loss += error * error / 2;
+			}
+
+			return loss;
+		}
+
+		/// Forward and backward over one sample. Each weight row gets
+		/// scale * source * deltas added to it at the same offset from
+		/// updates as it sits from the group's buffer, updates being
+		/// either the buffer itself or a gradient buffer.
+		/// The deltas a row passes back are read before it's updated.
+		double trainSample(Scratch     & scratch,
+		                   ConstFloatPtr input,
+		                   ConstFloatPtr target,
+		                   FloatPtr      updates,
+		                   FloatType     scale) {
+			auto const loss = forward(scratch, input, target);
+
+			auto const width       = group_.getNodesPerLayer();
+			auto const outputCount = group_.getOutputNodeCount();
+			FloatPtr const weights {getWeights()};
+
+			FloatPtr deltas         {scratch.deltas.data()};
+			FloatPtr previousDeltas {scratch.previousDeltas.data()};
+
+			activation_.derivative(scratch.outputs.data(), deltas, outputCount);
+
+			for (std::size_t o {0}; o < outputCount; ++o)
+				deltas[o] *= scratch.outputs[o] - target[o];
+
+			auto deltaCount = outputCount;
+
+			for (auto layer = group_.getLayerCount() + 1; layer-- > 0;) {
+				ConstFloatPtr sources {layer == 0 ? input : getLayerValues(scratch, layer - 1)};
+				auto const sourceCount = layer == 0 ? group_.getInputNodeCount() : width;
+
+				// The inputs' deltas aren't needed.
+				bool const propagate {layer != 0};
+
+				for (std::size_t j {0}; j < sourceCount; ++j) {
+					FloatPtr row {getWeightRow(layer, j)};
+
+					if (propagate)
+						previousDeltas[j] = dot(row, deltas, deltaCount);
+
+					if (sources[j] != 0)
+						axpy(scale * sources[j], deltas, updates + (row - weights), deltaCount);
+				}
+
+				if (propagate) {
+					activation_.derivative(sources, deltas, sourceCount);
+
+					for (std::size_t j {0}; j < sourceCount; ++j)
+						deltas[j] *= previousDeltas[j];
+
+					deltaCount = sourceCount;
+				}
+			}
+
+			return loss;
+		}
+
+		/// Adds -learningRate times every thread's gradients to the group's
+		/// buffer and clears them, split over the pool in ranges of
+		/// TASK_SIZE floats.
+		void applyGradients() {
+			constexpr std::size_t TASK_SIZE {16 * 1024};
+
+			auto const floatCount = getFloatCount();
+			auto const taskCount  = (floatCount + TASK_SIZE - 1) / TASK_SIZE;
+			FloatPtr const weights {getWeights()};
+
+			pool_.run(taskCount, [&](std::size_t task) {
+				auto const begin = task * TASK_SIZE;
+				auto const end   = std::min(begin + TASK_SIZE, floatCount);
+
+				for (auto & scratch : scratches_) {
+					FloatPtr gradients {scratch.gradients.data()};
+
+					axpy(-learningRate_, gradients + begin, weights + begin, end - begin);
+					std::fill(gradients + begin, gradients + end, FloatType {0});
+				}
+			});
+		}
+
+		HiddenGroupType & group_;
+		ThreadPool      & pool_;
+		FloatType         learningRate_;
+		ActivationType    activation_;
+
+		ListInterface<Scratch> scratches_;
+};
+
+template <class t_HiddenGroup>
+constexpr std::size_t HogwildTrainer<t_HiddenGroup>::SHARD_SIZE;
+
+
+/// Throughput and per epoch loss of a Hogwild run next to its synchronous
+/// baseline.
+inline void printTrainingComparison(std::ostream         & out,
+                                    TrainingReport const & hogwild,
+                                    TrainingReport const & synchronous) {
+	out << std::left << std::setw(13) << "" << std::right
+	    << std::setw(12) << "samples/s" << std::setw(9) << "speedup" << '\n';
+
+	for (auto const * report : {&hogwild, &synchronous}) {
+		out << std::left << std::setw(13) << (report == &hogwild ? "hogwild" : "synchronous")
+		    << std::right << std::fixed << std::setprecision(0)
+		    << std::setw(12) << report->getSamplesPerSecond() << std::setprecision(2)
+		    << std::setw(9)
+		    << report->getSamplesPerSecond() / synchronous.getSamplesPerSecond() << '\n';
+	}
+
+	out << '\n' << std::setw(6) << "epoch"
+	    << std::setw(15) << "hogwild loss" << std::setw(19) << "synchronous loss" << '\n'
+	    << std::scientific << std::setprecision(3);
+
+	auto const epochCount = std::min(hogwild.epochLosses.size(), synchronous.epochLosses.size());
+
+	for (std::size_t e {0}; e < epochCount; ++e) {
+		out << std::setw(6)  << e + 1
+		    << std::setw(15) << hogwild.epochLosses[e]
+		    << std::setw(19) << synchronous.epochLosses[e] << '\n';
+	}
+
+	out << std::defaultfloat;
+}
+
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,252 @@
+#ifndef NEURAL_NET_TESTING_SRC_CONSTANT_MATRIX_KERNELS_H
+#define NEURAL_NET_TESTING_SRC_CONSTANT_MATRIX_KERNELS_H
+
+#include <algorithm>
+#include <cstddef>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "../cpu_dispatch.h"
+#include "../half_float.h"
+
+namespace brh {
+	namespace neural {
+		namespace constant {
+
+/// Bytes of weights kept hot while a tile is reused across the batch.
+/// Sized to sit comfortably inside a typical per-core L2.
+constexpr std::size_t WEIGHT_TILE_BYTES {128 * 1024};
+
+/// Output columns processed per tile, keeps each sample's slice of the
+/// output row resident in L1 while the tile's rows are applied to it.
+constexpr std::size_t OUTPUT_TILE_COLUMNS {256};
+
+
+/// y[i] += a * x[i], the inner loop of the column-major layouts.
+template <class FloatType>
+void axpy(FloatType a, FloatType const * x, FloatType * y, std::size_t count) {
+	for (std::size_t i {0}; i < count; ++i)
+		y[i] += a * x[i];
+}
+
+inline void axpy(float a, float const * x, float * y, std::size_t count) {
+	getKernels().axpy(a, x, y, count);
+}
+
+
+/// Accumulates a batch of row vectors times a weight matrix:
+///  outputs[s][o] += inputs[s][k] * weights[k][o]
+///
+/// The weight matrix is walked one (rows x columns) tile at a time and every
+/// tile is applied to the whole batch before moving on, so each weight is
+/// loaded from memory once per call rather than once per sample.
+///
+/// @param inputs       sampleCount rows of inputCount values,
+///                     consecutive rows are inputStride apart.
+/// @param weights      inputCount rows of outputCount values,
+///                     consecutive rows are weightStride apart.
+/// @param outputs      sampleCount rows of outputCount values,
+///                     consecutive rows are outputStride apart.
+template <class FloatType>
+void multiplyBlocked(FloatType const * inputs,
+                     std::size_t       inputStride,
+                     std::size_t       sampleCount,
+                     std::size_t       inputCount,
+                     FloatType const * weights,
+                     std::size_t       weightStride,
+                     FloatType       * outputs,
+                     std::size_t       outputStride,
+                     std::size_t       outputCount) {
+	std::size_t const columnTile {std::min(OUTPUT_TILE_COLUMNS, outputCount)};
+	std::size_t const rowTile {std::max<std::size_t>(
+		1, WEIGHT_TILE_BYTES / (sizeof(FloatType) * std::max<std::size_t>(columnTile, 1))
+	)};
+
+	for (std::size_t columnBegin {0}; columnBegin < outputCount;
+	     columnBegin += columnTile) {
+		std::size_t const columnEnd {std::min(columnBegin + columnTile, outputCount)};
+
+		for (std::size_t rowBegin {0}; rowBegin < inputCount; rowBegin += rowTile) {
+			std::size_t const rowEnd {std::min(rowBegin + rowTile, inputCount)};
+
+			for (std::size_t s {0}; s < sampleCount; ++s) {
+				FloatType const * in  {inputs  + s * inputStride};
+				FloatType       * out {outputs + s * outputStride};
+
+				for (std::size_t k {rowBegin}; k < rowEnd; ++k) {
+					axpy(in[k], weights + k * weightStride + columnBegin,
+					     out + columnBegin, columnEnd - columnBegin);
+				}
+			}
+		}
+	}
+}
+
+
+/// Unit-stride dot product, the inner loop of the row-major layouts.
+template <class FloatType>
+FloatType dot(FloatType const * a, FloatType const * b, std::size_t count) {
+	FloatType sum {0};
+
+	for (std::size_t i {0}; i < count; ++i)
+		sum += a[i] * b[i];
+
+	return sum;
+}
+
+/// The float dot product runs the kernel getKernels() picked for the host.
+inline float dot(float const * a, float const * b, std::size_t count) {
+	return getKernels().dot(a, b, count);
+}
+
+
+/// Dot products of half-precision weights with float values. The weights
+/// are widened to float as they're loaded and everything is accumulated in
+/// float, so only the memory traffic is halved.
+inline float dot(BFloat16 const * a, float const * b, std::size_t count) {
+	float sum {0};
+	std::size_t i {0};
+
+#ifdef __SSE2__
+	// bfloat16 is the top half of a float, interleaving zeros below each
+	// value widens four at a time.
+	__m128i const zero = _mm_setzero_si128();
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+
+	for (; i + 8 <= count; i += 8) {
+		__m128i const halves = _mm_loadu_si128(reinterpret_cast<__m128i const *>(a + i));
+
+		__m128 const low  = _mm_castsi128_ps(_mm_unpacklo_epi16(zero, halves));
+		__m128 const high = _mm_castsi128_ps(_mm_unpackhi_epi16(zero, halves));
+
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(low,  _mm_loadu_ps(b + i)));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(high, _mm_loadu_ps(b + i + 4)));
+	}
+
+	float lanes[4];
+	_mm_storeu_ps(lanes, _mm_add_ps(sum0, sum1));
+
+	sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+
+	for (; i < count; ++i)
+		sum += static_cast<float>(a[i]) * b[i];
+
+	return sum;
+}
+
+#ifdef __SSE2__
+/// Four binary16 values, zero extended into 32-bit lanes, to float. Moves
+/// exponent and mantissa into place and rescales the exponent with one
+/// multiply, which handles subnormals too, infinity and NaN are patched
+/// back in afterwards.
+inline __m128 float16ToFloat(__m128i halves) {
+	__m128i const magnitude = _mm_and_si128(halves, _mm_set1_epi32(0x7fff));
+	__m128i const sign      = _mm_slli_epi32(_mm_xor_si128(halves, magnitude), 16);
+
+	__m128 const scaled = _mm_mul_ps(
+		_mm_castsi128_ps(_mm_slli_epi32(magnitude, 13)),
+		_mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23))
+	);
+
+	__m128i const wasInfNan = _mm_cmpgt_epi32(magnitude, _mm_set1_epi32(0x7bff));
+	__m128i const infNan    = _mm_and_si128(wasInfNan, _mm_set1_epi32(255 << 23));
+
+	return _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, infNan)));
+}
+#endif
+
+inline float dot(Float16 const * a, float const * b, std::size_t count) {
+	float sum {0};
+	std::size_t i {0};
+
+#ifdef __SSE2__
+	__m128i const zero = _mm_setzero_si128();
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+
+	for (; i + 8 <= count; i += 8) {
+		__m128i const halves = _mm_loadu_si128(reinterpret_cast<__m128i const *>(a + i));
+
+		__m128 const low  = float16ToFloat(_mm_unpacklo_epi16(halves, zero));
+		__m128 const high = float16ToFloat(_mm_unpackhi_epi16(halves, zero));
+
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(low,  _mm_loadu_ps(b + i)));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(high, _mm_loadu_ps(b + i + 4)));
+	}
+
+	float lanes[4];
+	_mm_storeu_ps(lanes, _mm_add_ps(sum0, sum1));
+
+	sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+
+	for (; i < count; ++i)
+		sum += static_cast<float>(a[i]) * b[i];
+
+	return sum;
+}
+
+
+/// Matrix-vector product over a row-major matrix:
+///  outputs[r] = dot(weights[r], inputs)
+template <class WeightType, class FloatType>
+void multiplyRows(WeightType const * weights,
+                  std::size_t        rowCount,
+                  std::size_t        columnCount,
+                  FloatType  const * inputs,
+                  FloatType        * outputs) {
+	for (std::size_t r {0}; r < rowCount; ++r)
+		outputs[r] = dot(weights + r * columnCount, inputs, columnCount);
+}
+
+
+/// Batched form of multiplyRows:
+///  outputs[s][r] = dot(weights[r], inputs[s])
+///
+/// The row-major counterpart of multiplyBlocked, tiles of rows by columns
+/// are applied to every sample before moving to the next tile. outputs is
+/// overwritten rather than accumulated into.
+template <class WeightType, class FloatType>
+void multiplyRowsBlocked(WeightType const * weights,
+                         std::size_t        rowCount,
+                         std::size_t        columnCount,
+                         FloatType  const * inputs,
+                         std::size_t        sampleCount,
+                         FloatType        * outputs) {
+	std::fill(outputs, outputs + sampleCount * rowCount, FloatType {0});
+
+	std::size_t const columnTile {std::max<std::size_t>(
+		1, std::min(columnCount, WEIGHT_TILE_BYTES / (sizeof(WeightType) * 16))
+	)};
+	std::size_t const rowTile {std::max<std::size_t>(
+		1, WEIGHT_TILE_BYTES / (sizeof(WeightType) * columnTile)
+	)};
+
+	for (std::size_t rowBegin {0}; rowBegin < rowCount; rowBegin += rowTile) {
+		std::size_t const rowEnd {std::min(rowBegin + rowTile, rowCount)};
+
+		for (std::size_t columnBegin {0}; columnBegin < columnCount;
+		     columnBegin += columnTile) {
+			std::size_t const width {std::min(columnTile, columnCount - columnBegin)};
+
+			for (std::size_t s {0}; s < sampleCount; ++s) {
+				FloatType const * in  {inputs  + s * columnCount + columnBegin};
+				FloatType       * out {outputs + s * rowCount};
+
+				for (std::size_t r {rowBegin}; r < rowEnd; ++r) {
+					out[r] += dot(weights + r * columnCount + columnBegin, in, width);
+				}
+			}
+		}
+	}
+}
+
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,385 @@
+#ifndef NEURAL_NET_TESTING_SRC_CONSTANT_MODEL_FILE_H
+#define NEURAL_NET_TESTING_SRC_CONSTANT_MODEL_FILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../common.h"
+#include "../half_float.h"
+
+namespace brh {
+	namespace neural {
+		namespace constant {
+
+/// Versioned binary model format, laid out to be mapped rather than read.
+///
+/// File layout:
+///  ModelFileHeader | padding | group 0 weights | padding | group 1 ...
+///
+/// Each group's section starts on a SECTION_ALIGNMENT boundary and holds the
+/// weights in DenseHiddenGroup's layout (input, hidden, then output
+/// matrices, one row of incoming weights per destination node), so a mapped
+/// group reads them in place. Values are in the writer's native byte order,
+/// checked through byteOrderMark.
+struct ModelFileHeader
+{
+	static constexpr std::uint32_t VERSION           {1};
+	static constexpr std::uint32_t BYTE_ORDER_MARK   {0x01020304};
+	static constexpr std::size_t   SECTION_ALIGNMENT {64};
+
+	/// Element type of the weight sections.
+	enum WeightType : std::uint32_t
+	{
+		FLOAT32  = 0,
+		FLOAT16  = 1,
+		BFLOAT16 = 2
+	};
+
+	char          magic[8];
+	std::uint32_t version;
+	std::uint32_t byteOrderMark;
+	std::uint32_t weightType;
+	std::uint32_t weightSize;
+
+	std::uint64_t hiddenGroupCount;
+	std::uint64_t inputNodeCount;
+	std::uint64_t outputNodeCount;
+	std::uint64_t layerCount;
+	std::uint64_t nodesPerLayer;
+
+	/// Weights per group and the byte offsets of the group sections.
+	std::uint64_t weightCount;
+	std::uint64_t firstGroupOffset;
+	std::uint64_t groupStride;
+
+	static char const * getMagic() {
+		return "BRHNNET";
+	}
+
+	static std::uint64_t alignSection(std::uint64_t offset) {
+		return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+	}
+};
+
+
+/// ModelFileHeader::WeightType of each weight storage type.
+template <class t_WeightType>
+struct ModelWeightType;
+
+template <>
+struct ModelWeightType<float>
+{
+	static constexpr std::uint32_t VALUE {ModelFileHeader::FLOAT32};
+};
+
+template <>
+struct ModelWeightType<Float16>
+{
+	static constexpr std::uint32_t VALUE {ModelFileHeader::FLOAT16};
+};
+
+template <>
+struct ModelWeightType<BFloat16>
+{
+	static constexpr std::uint32_t VALUE {ModelFileHeader::BFLOAT16};
+};
+
+
+/// Read-only mapping of a model file. The pages come from the page cache,
+/// so every process mapping the same file shares a single copy.
+class MappedModelFile
+{
+	public:
+		explicit MappedModelFile(std::string const & path) :
+			data_ {nullptr},
+			size_ {0} {
+			int descriptor {::open(path.c_str(), O_RDONLY)};
+
+			if (descriptor < 0)
+				throw std::runtime_error("Unable to open model file " + path);
+
+			struct stat status;
+
+			if (::fstat(descriptor, &status) != 0) {
+				::close(descriptor);
+				throw std::runtime_error("Unable to stat model file " + path);
+			}
+
+			size_ = static_cast<std::size_t>(status.st_size);
+
+			if (size_ < sizeof(ModelFileHeader)) {
+				::close(descriptor);
+				throw std::runtime_error("Model file too small " + path);
+			}
+
+			void * mapping {::mmap(nullptr, size_, PROT_READ, MAP_SHARED, descriptor, 0)};
+			::close(descriptor);
+
+			if (mapping == MAP_FAILED)
+				throw std::runtime_error("Unable to map model file " + path);
+
+			data_ = static_cast<char const *>(mapping);
+
+			validate(path);
+		}
+
+		MappedModelFile(MappedModelFile const &) = delete;
+		MappedModelFile & operator=(MappedModelFile const &) = delete;
+
+		~MappedModelFile() {
+			if (data_ != nullptr)
+				::munmap(const_cast<char *>(data_), size_);
+		}
+
+		ModelFileHeader const & getHeader() const {
+			return *reinterpret_cast<ModelFileHeader const *>(data_);
+		}
+
+		template <class WeightType>
+		WeightType const * getGroupWeights(std::size_t groupIndex) const {
+			auto const & header = getHeader();
+			return reinterpret_cast<WeightType const *>(
+				data_ + header.firstGroupOffset + groupIndex * header.groupStride
+			);
+		}
+
+		std::size_t getSize() const { return size_; }
+
+
+	private:
+		void validate(std::string const & path) {
+			auto const & header = getHeader();
+
+			if (std::memcmp(header.magic, ModelFileHeader::getMagic(), sizeof header.magic) != 0)
+				fail("Not a model file " + path);
+
+			if (header.version != ModelFileHeader::VERSION)
+				fail("Unsupported model file version " + path);
+
+			if (header.byteOrderMark != ModelFileHeader::BYTE_ORDER_MARK)
+				fail("Model file has foreign byte order " + path);
+
+			// Every size is checked for overflow, a corrupt header must not
+			// wrap around into a range that looks valid.
+			std::uint64_t hiddenColumns, columns, weightCount, weightBytes, sectionBytes, end;
+
+			bool const consistent {
+				header.hiddenGroupCount > 0 &&
+				header.inputNodeCount   > 0 &&
+				header.outputNodeCount  > 0 &&
+				header.layerCount       > 0 &&
+				header.nodesPerLayer    > 0 &&
+				multiply(header.nodesPerLayer, header.layerCount - 1, hiddenColumns) &&
+				add(header.inputNodeCount, hiddenColumns, columns) &&
+				add(columns, header.outputNodeCount, columns) &&
+				multiply(header.nodesPerLayer, columns, weightCount) &&
+				weightCount == header.weightCount &&
+				multiply(header.weightCount, header.weightSize, weightBytes) &&
+				header.groupStride >= weightBytes &&
+				header.groupStride      % ModelFileHeader::SECTION_ALIGNMENT == 0 &&
+				header.firstGroupOffset % ModelFileHeader::SECTION_ALIGNMENT == 0 &&
+				header.firstGroupOffset >= sizeof(ModelFileHeader) &&
+				multiply(header.hiddenGroupCount, header.groupStride, sectionBytes) &&
+				add(header.firstGroupOffset, sectionBytes, end) &&
+				end <= size_
+			};
+
+			if (!consistent)
+				fail("Model file truncated or inconsistent " + path);
+		}
+
+		/// a * b into result, false if it overflows.
+		static bool multiply(std::uint64_t a, std::uint64_t b, std::uint64_t & result) {
+			if (b != 0 && a > std::numeric_limits<std::uint64_t>::max() / b)
+				return false;
+
+			result = a * b;
+			return true;
+		}
+
+		/// a + b into result, false if it overflows.
+		static bool add(std::uint64_t a, std::uint64_t b, std::uint64_t & result) {
+			if (a > std::numeric_limits<std::uint64_t>::max() - b)
+				return false;
+
+			result = a + b;
+			return true;
+		}
+
+		[[noreturn]] void fail(std::string const & message) {
+			::munmap(const_cast<char *>(data_), size_);
+			data_ = nullptr;
+			throw std::runtime_error(message);
+		}
+
+		char const * data_;
+		std::size_t  size_;
+};
+
+
+/// Writes any constant::Network to path with its weights converted to
+/// t_WeightType, such as a float network saved as BFloat16. Groups are
+/// written through the shared accessor API, so networks of interleaved
+/// HiddenGroups can be saved too and later loaded as DenseHiddenGroups.
+///
+/// The file is written beside path and renamed over it, so anything still
+/// mapping the old file, network included, keeps reading the old weights.
+template <class t_WeightType, class t_NetworkType>
+void saveModelAs(t_NetworkType & network, std::string const & path) {
+	using FloatType  = typename t_NetworkType::FloatType;
+	using WeightType = t_WeightType;
+
+	auto & first = network.getHiddenGroup(0);
+
+	ModelFileHeader header;
+	std::memset(&header, 0, sizeof header);
+	std::memcpy(header.magic, ModelFileHeader::getMagic(), sizeof header.magic);
+
+	header.version          = ModelFileHeader::VERSION;
+	header.byteOrderMark    = ModelFileHeader::BYTE_ORDER_MARK;
+	header.weightType       = ModelWeightType<WeightType>::VALUE;
+	header.weightSize       = sizeof(WeightType);
+	header.hiddenGroupCount = network.getHiddenGroupCount();
+	header.inputNodeCount   = first.getInputNodeCount();
+	header.outputNodeCount  = first.getOutputNodeCount();
+	header.layerCount       = first.getLayerCount();
+	header.nodesPerLayer    = first.getNodesPerLayer();
+
+	auto const width  = first.getNodesPerLayer();
+	auto const inputs = first.getInputNodeCount();
+
+	header.weightCount      = width * (
+		inputs + width * first.getNonTerminalLayerCount() + first.getOutputNodeCount()
+	);
+	header.firstGroupOffset = ModelFileHeader::alignSection(sizeof header);
+	header.groupStride      = ModelFileHeader::alignSection(
+		header.weightCount * sizeof(WeightType)
+	);
+
+	auto const tempPath = path + ".tmp";
+	std::ofstream file (tempPath, std::ios::binary | std::ios::trunc);
+
+	if (!file)
+		throw std::runtime_error("Unable to create model file " + tempPath);
+
+	std::vector<WeightType> row;
+
+	auto writeRow = [&] {
+		file.write(reinterpret_cast<char const *>(row.data()),
+		           static_cast<std::streamsize>(row.size() * sizeof(WeightType)));
+	};
+
+	auto convert = [](FloatType weight) {
+		return static_cast<WeightType>(weight);
+	};
+
+	auto pad = [&](std::uint64_t offset) {
+		static char const zeros[ModelFileHeader::SECTION_ALIGNMENT] {};
+		auto const padding = ModelFileHeader::alignSection(offset) - offset;
+		file.write(zeros, static_cast<std::streamsize>(padding));
+	};
+
+	file.write(reinterpret_cast<char const *>(&header), sizeof header);
+	pad(sizeof header);
+
+	for (std::size_t g {0}; g < network.getHiddenGroupCount(); ++g) {
+		auto & group = network.getHiddenGroup(g);
+
+		row.resize(inputs);
+
+		for (std::size_t i {0}; i < width; ++i) {
+			for (std::size_t j {0}; j < inputs; ++j)
+				row[j] = convert(*group.getInputWeight(j, i));
+
+			writeRow();
+		}
+
+		row.resize(width);
+
+		for (std::size_t l {0}; l < group.getNonTerminalLayerCount(); ++l) {
+			for (std::size_t i {0}; i < width; ++i) {
+				for (std::size_t j {0}; j < width; ++j)
+					row[j] = convert(*group.getNonTerminalElement(l, j).getWeight(i));
+
+				writeRow();
+			}
+		}
+
+		for (std::size_t o {0}; o < group.getOutputNodeCount(); ++o) {
+			for (std::size_t j {0}; j < width; ++j)
+				row[j] = convert(*group.getTerminalElement(j).getWeight(o));
+
+			writeRow();
+		}
+
+		pad(header.weightCount * sizeof(WeightType));
+	}
+
+	file.flush();
+	file.close();
+
+	if (!file) {
+		std::remove(tempPath.c_str());
+		throw std::runtime_error("Unable to write model file " + tempPath);
+	}
+
+	if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+		std::remove(tempPath.c_str());
+		throw std::runtime_error("Unable to replace model file " + path);
+	}
+}
+
+/// Writes network to path, keeping the weight type its groups store.
+template <class t_NetworkType>
+void saveModel(t_NetworkType & network, std::string const & path) {
+	saveModelAs<typename t_NetworkType::HiddenGroupType::WeightType>(network, path);
+}
+
+
+/// Maps a model file and builds a network of DenseHiddenGroups reading
+/// their weights straight from the mapping, nothing is copied. The mapping
+/// stays alive as long as any group of the network does.
+/// @tparam t_NetworkType A DenseNetwork storing the file's weight type.
+template <class t_NetworkType>
+t_NetworkType loadModel(std::string const & path,
+                        typename t_NetworkType::ThreadPoolPtr threadPool = nullptr) {
+	using WeightType = typename t_NetworkType::HiddenGroupType::WeightType;
+
+	auto file = std::make_shared<MappedModelFile>(path);
+	auto const & header = file->getHeader();
+
+	if (header.weightType != ModelWeightType<WeightType>::VALUE ||
+	    header.weightSize != sizeof(WeightType))
+		throw std::runtime_error("Model file weight type mismatch " + path);
+
+	typename t_NetworkType::HiddenGroupList groups;
+	groups.reserve(header.hiddenGroupCount);
+
+	for (std::size_t g {0}; g < header.hiddenGroupCount; ++g) {
+		groups.emplace_back(
+			header.inputNodeCount, header.outputNodeCount,
+			header.layerCount, header.nodesPerLayer,
+			file->getGroupWeights<WeightType>(g), file
+		);
+	}
+
+	return t_NetworkType(std::move(groups), std::move(threadPool));
+}
+
+		}
+	}
+}
+
+#endif
@@ -1,24 +1,75 @@
 #ifndef NEURAL_NET_TESTING_SRC_CONSTANT_NETWORK_H
 #define NEURAL_NET_TESTING_SRC_CONSTANT_NETWORK_H
 
+#include <algorithm>
 #include <limits>
 #include <cassert>
-#include <thread>
-#include <future>
+#include <memory>
+#include <type_traits>
 
 #include <brh/supports/round_up_to_multiple.h>
 
 #include "../common.h"
+#include "../thread_pool.h"
 
 #include "hidden_group.h"
+#include "dense_hidden_group.h"
+#include "sparse_hidden_group.h"
+#include "quantized_hidden_group.h"
+#include "weight_init.h"
 
 namespace brh {
 	namespace neural {
 		namespace constant {
 
+/// Fewest weights a row tile of a stage is worth splitting off for, below
+/// that the barrier costs more than the extra thread saves.
+constexpr std::size_t MIN_TILE_WEIGHTS {32 * 1024};
+
+/// Beyond this fraction of changed inputs, gathering the changed weight
+/// columns costs more than streaming the whole input matrix, and
+/// executeIncremental recomputes instead.
+constexpr double INCREMENTAL_CHANGE_LIMIT {1.0 / 16};
+
+/// executeIncremental rebuilds the kept sums every this many calls, so
+/// rounding error from the deltas can't build up.
+constexpr std::size_t INCREMENTAL_REFRESH_INTERVAL {256};
+
+/// What an executeIncremental call did.
+struct IncrementalStats
+{
+	std::size_t changedInputCount;
+	std::size_t inputCount;
+
+	/// Whether the sums were rebuilt rather than updated.
+	bool recomputed;
+
+	double getChangedFraction() const {
+		return inputCount == 0 ? 0 :
+			static_cast<double>(changedInputCount) / static_cast<double>(inputCount);
+	}
+};
+
+
+/// Whether a hidden group type can execute a stage as row ranges
+/// (executeStageRows and friends, see DenseHiddenGroup), which lets one
+/// group be split across threads.
+template <class t_HiddenGroup, class = void>
+struct SupportsStageSplit : std::false_type {};
+
+template <class t_HiddenGroup>
+struct SupportsStageSplit<
+	t_HiddenGroup, decltype(void(&t_HiddenGroup::executeStageRows))
+> : std::true_type {};
+
+
+/// @tparam t_HiddenGroup Layout of the hidden groups,
+///                       HiddenGroup or DenseHiddenGroup.
 template <
 	class t_NodeType,
-	template <class T> class t_ListInterface = ::ListInterface
+	template <class T> class t_ListInterface = ::ListInterface,
+	class t_Activation = SoftStep,
+	class t_HiddenGroup = HiddenGroup<t_NodeType, t_ListInterface, t_Activation>
 >
 class Network
 {
@@ -27,57 +78,239 @@ class Network
 		using ListInterface = t_ListInterface<T>;
 
 
-		using NodeType      = t_NodeType;
-		using NodeReference = NodeType &;
+		using NodeType       = t_NodeType;
+		using NodeReference  = NodeType &;
+		using ActivationType = t_Activation;
 
 		using FloatType = typename NodeType::FloatType;
 		using FloatList = ListInterface<FloatType>;
 
+		using FloatPtr      = FloatType       *;
+		using ConstFloatPtr = FloatType const *;
+
 		using NodeList        = ListInterface<NodeType>;
-		using HiddenGroupType = HiddenGroup<NodeType, t_ListInterface>;
+		using HiddenGroupType = t_HiddenGroup;
 
 
-		Network(std::size_t hiddenGroupCount,
-		        std::size_t inputNodeCount,
-		        std::size_t outputNodeCount,
-		        std::size_t hiddenLayerCount,
-		        std::size_t nodesPerHiddenLayer) :
-			inputNodes_      (inputNodeCount),
-			outputNodes_     (outputNodeCount),
-			hiddenGroupList_ (hiddenGroupCount, {
+		using HiddenGroupList = ListInterface<HiddenGroupType>;
+		using ThreadPoolPtr   = std::shared_ptr<ThreadPool>;
+		using IndexList       = ListInterface<std::size_t>;
+
+
+		/// @param threadPool Pool the hidden groups are executed on, may be
+		///                   shared between networks. If null the network
+		///                   creates its own, one thread per core when the
+		///                   groups can be split across threads, otherwise
+		///                   sized to the group count but never more than
+		///                   one thread per core.
+		Network(std::size_t   hiddenGroupCount,
+		        std::size_t   inputNodeCount,
+		        std::size_t   outputNodeCount,
+		        std::size_t   hiddenLayerCount,
+		        std::size_t   nodesPerHiddenLayer,
+		        ThreadPoolPtr threadPool = nullptr) :
+			activation_           {},
+			inputNodes_           (inputNodeCount),
+			outputNodes_          (outputNodeCount),
+			hiddenGroupList_      (hiddenGroupCount, {
 				inputNodeCount, outputNodeCount,
 				hiddenLayerCount, nodesPerHiddenLayer }),
-			futureList_      (hiddenGroupCount) {}
+			inputValues_          (inputNodeCount),
+			incrementalCallCount_ {0},
+			groupOutputs_         (hiddenGroupCount),
+			threadPool_           (std::move(threadPool)) {
+			if (!threadPool_)
+				threadPool_ = std::make_shared<ThreadPool>(getDefaultThreadCount());
+		}
+
+
+		/// Network over already built groups, which must all share the
+		/// same input and output node counts.
+		Network(HiddenGroupList hiddenGroups,
+		        ThreadPoolPtr   threadPool = nullptr) :
+			activation_           {},
+			inputNodes_           (hiddenGroups.at(0).getInputNodeCount()),
+			outputNodes_          (hiddenGroups.at(0).getOutputNodeCount()),
+			hiddenGroupList_      (std::move(hiddenGroups)),
+			inputValues_          (inputNodes_.size()),
+			incrementalCallCount_ {0},
+			groupOutputs_         (hiddenGroupList_.size()),
+			threadPool_           (std::move(threadPool)) {
+			if (!threadPool_)
+				threadPool_ = std::make_shared<ThreadPool>(getDefaultThreadCount());
+		}
+
+
+		/// With at least as many groups as threads every group runs on a
+		/// thread of its own. Otherwise, when the group type allows it,
+		/// each layer is split into row tiles shared out over all threads,
+		/// and the next layer starts once every tile is done.
+		void execute() {
+			executeGroups(SupportsStageSplit<HiddenGroupType> {});
+			collectOutputs();
+		}
+
+		/// execute for inputs that mostly repeat the previous call's, such
+		/// as consecutive video frames. The input node values are compared
+		/// with the previous call's and only the differences are applied to
+		/// the groups' kept input layer sums, see
+		/// DenseHiddenGroup::executeIncremental. The first call, calls
+		/// changing more than INCREMENTAL_CHANGE_LIMIT of the inputs and
+		/// every INCREMENTAL_REFRESH_INTERVAL-th call recompute in full.
+		/// The kept sums assume unchanged weights: initializeWeights resets
+		/// them, weights written any other way (getInputWeight and the
+		/// other group accessors) need a resetIncremental call.
+		IncrementalStats executeIncremental() {
+			auto const inputCount = getInputNodeCount();
+			bool const first {previousInputs_.size() != inputCount};
+
+			if (first)
+				previousInputs_.assign(inputCount, 0);
+
+			changedInputs_.clear();
+			inputDeltas_.clear();
+
+			for (std::size_t i {0}; i < inputCount; ++i) {
+				auto const value = inputNodes_[i].getValue();
+
+				if (value != previousInputs_[i]) {
+					changedInputs_.push_back(i);
+					inputDeltas_.push_back(value - previousInputs_[i]);
+					previousInputs_[i] = value;
+				}
+			}
 
+			IncrementalStats stats {changedInputs_.size(), inputCount, false};
 
-		void execute(FunctionType activation) {
-			auto size = getHiddenGroupCount();
+			stats.recomputed =
+				first ||
+				stats.getChangedFraction() > INCREMENTAL_CHANGE_LIMIT ||
+				++incrementalCallCount_ >= INCREMENTAL_REFRESH_INTERVAL;
 
-			for (std::size_t i {0}; i < size; ++i) {
-				futureList_[i] = std::async(
-					std::launch::async,
-					&HiddenGroupType::execute, &hiddenGroupList_[i],
-					inputNodes_.data(), activation
+			if (first)
+				stats.changedInputCount = inputCount;
+
+			if (stats.recomputed)
+				incrementalCallCount_ = 0;
+
+			auto const & activation = activation_;
+
+			prepareGroupOutputs();
+
+			threadPool_->run(getHiddenGroupCount(), [&](std::size_t i) {
+				hiddenGroupList_[i].executeIncremental(
+					previousInputs_.data(), changedInputs_, inputDeltas_,
+					stats.recomputed, groupOutputs_[i].data(), activation
 				);
-			}
+			});
 
-			std::vector<FloatList> outputValues (size);
+			collectOutputs();
 
-			for (std::size_t i {0}; i < size; ++i) {
-				outputValues[i] = futureList_[i].get();
+			return stats;
+		}
+
+		/// Makes the next executeIncremental call start over, needed after
+		/// writing weights outside initializeWeights.
+		void resetIncremental() {
+			previousInputs_.clear();
+		}
+
+		/// Executes sampleCount input rows, see HiddenGroup::executeBatch.
+		/// A single row goes through the regular execute path, so the input
+		/// and output nodes are only updated in that case.
+		/// @param inputs sampleCount rows of getInputNodeCount() values.
+		/// @return sampleCount rows of getOutputNodeCount() values.
+		FloatList executeBatch(FloatList const & inputs,
+		                       std::size_t       sampleCount) {
+			assert(inputs.size() == sampleCount * getInputNodeCount());
+
+			return executeBatch(inputs.data(), sampleCount);
+		}
+
+		/// executeBatch over rows held outside a FloatList.
+		FloatList executeBatch(ConstFloatPtr inputs,
+		                       std::size_t   sampleCount) {
+			auto const & activation = activation_;
+
+			auto const outputCount = getOutputNodeCount();
+			FloatList outValues (sampleCount * outputCount);
+
+			if (sampleCount == 1) {
+				for (std::size_t i {0}; i < getInputNodeCount(); ++i) {
+					getInputNode(i).setValue(inputs[i]);
+				}
+
+				execute();
+
+				for (std::size_t i {0}; i < outputCount; ++i) {
+					outValues[i] = getOutputNode(i).getValue();
+				}
+
+				return outValues;
 			}
 
-			for (std::size_t i {0}; i < getOutputNodeCount(); ++i) {
-				auto & node = getOutputNode(i);
+			auto size = getHiddenGroupCount();
 
-				node.clearValue();
+			threadPool_->run(size, [&](std::size_t i) {
+				groupOutputs_[i] = hiddenGroupList_[i].executeBatch(
+					inputs, sampleCount, activation
+				);
+			});
 
-				for (std::size_t j {0}; j < size; ++j) {
-					node.addToValue(outputValues[j][i]);
+			for (std::size_t i {0}; i < size; ++i) {
+				for (std::size_t j {0}; j < outValues.size(); ++j) {
+					outValues[j] += groupOutputs_[i][j];
 				}
+			}
 
-				node.applyActivation(activation);
+			for (auto & i : outValues)
+				i = activation(i);
+
+			return outValues;
+		}
+
+		/// Per-call state for the reentrant execute overload, owned by the
+		/// caller and reused from call to call. Create with makeWorkspace.
+		struct Workspace
+		{
+			FloatList groupValues;
+			FloatList groupOutputs;
+		};
+
+		Workspace makeWorkspace() const {
+			auto const & first = hiddenGroupList_.front();
+			return {
+				FloatList(first.getWorkspaceSize()),
+				FloatList(getOutputNodeCount())
+			};
+		}
+
+		/// Executes one input row without touching the network's nodes or
+		/// groups, every intermediate value lives in workspace. Nothing is
+		/// allocated and the groups run one after another on the calling
+		/// thread, so several threads can execute one network at once, each
+		/// with a workspace of its own. Needs a group type with executeInto,
+		/// such as DenseHiddenGroup.
+		/// @param inputs  getInputNodeCount() values.
+		/// @param outputs Receives getOutputNodeCount() values.
+		void execute(ConstFloatPtr inputs,
+		             FloatPtr      outputs,
+		             Workspace   & workspace) const {
+			auto const outputCount = getOutputNodeCount();
+
+			std::fill(outputs, outputs + outputCount, FloatType {0});
+
+			for (auto const & group : hiddenGroupList_) {
+				group.executeInto(
+					inputs, workspace.groupOutputs.data(),
+					workspace.groupValues.data(), activation_
+				);
+
+				for (std::size_t i {0}; i < outputCount; ++i)
+					outputs[i] += workspace.groupOutputs[i];
 			}
+
+			activation_(outputs, outputCount);
 		}
 
 		// If too small, only the first n items are affected,
@@ -121,22 +354,286 @@ class Network
 		}
 
 
+		ActivationType const & getActivation() const {
+			return activation_;
+		}
+
+		/// Only needed for stateful activations, such as RuntimeActivation.
+		void setActivation(ActivationType activation) {
+			activation_ = std::move(activation);
+		}
+
+
+		ThreadPool & getThreadPool() {
+			return *threadPool_;
+		}
+
+		/// For sharing the pool with another network.
+		ThreadPoolPtr const & getThreadPoolPtr() const {
+			return threadPool_;
+		}
+
+		void setThreadPool(ThreadPoolPtr threadPool) {
+			assert(threadPool);
+			threadPool_ = std::move(threadPool);
+		}
+
+		/// Initializes every group's weights, see WeightInit. Groups are
+		/// numbered by index for the generator, and every stage is split
+		/// into row tiles across the thread pool; the weights come out the
+		/// same for any thread count, and executeIncremental starts over.
+		/// Throws std::invalid_argument, before
+		/// writing anything, if a group's weights are mapped read-only (a
+		/// network from loadModel).
+		void initializeWeights(WeightInit const & init) {
+			auto const groupCount = getHiddenGroupCount();
+
+			if (groupCount == 0)
+				return;
+
+			for (auto const & group : hiddenGroupList_)
+				requireWritableWeights(group);
+
+			auto const & first = hiddenGroupList_.front();
+			auto const threadCount = threadPool_->getThreadCount();
+
+			for (std::size_t stage {0}; stage <= first.getLayerCount(); ++stage) {
+				auto const rowCount    = getInitStageRowCount(first, stage);
+				auto const weightCount = rowCount * getInitStageColumnCount(first, stage);
+
+				auto const tileCount = std::max<std::size_t>(1, std::min({
+					threadCount, rowCount, weightCount / MIN_TILE_WEIGHTS
+				}));
+				auto const tileRows = (rowCount + tileCount - 1) / tileCount;
+
+				threadPool_->run(groupCount * tileCount, [&](std::size_t task) {
+					auto const rowBegin = (task % tileCount) * tileRows;
+					auto const rowEnd   = std::min(rowBegin + tileRows, rowCount);
+
+					if (rowBegin < rowEnd) {
+						initializeStageRows(
+							hiddenGroupList_[task / tileCount], init,
+							task / tileCount, stage, rowBegin, rowEnd
+						);
+					}
+				});
+			}
+
+			// The kept input sums were built from the old weights.
+			resetIncremental();
+		}
+
+		/// Row tiles each group's layers are split into by execute, 1 when
+		/// the groups alone keep every thread busy.
+		std::size_t getTilesPerGroup() const {
+			auto const threadCount = threadPool_->getThreadCount();
+			auto const groupCount  = getHiddenGroupCount();
+
+			if (!SupportsStageSplit<HiddenGroupType>::value || groupCount >= threadCount)
+				return 1;
+
+			return (threadCount + groupCount - 1) / groupCount;
+		}
+
+
 	private:
-		using HiddenGroupList = ListInterface<HiddenGroupType>;
+		/// Sums the groups' outputs into the output nodes.
+		void collectOutputs() {
+			auto size = getHiddenGroupCount();
+			auto const & activation = activation_;
+
+			for (std::size_t i {0}; i < getOutputNodeCount(); ++i) {
+				auto & node = getOutputNode(i);
+
+				node.clearValue();
+
+				for (std::size_t j {0}; j < size; ++j) {
+					node.addToValue(groupOutputs_[j][i]);
+				}
+
+				node.applyActivation(activation);
+			}
+		}
+
+		std::size_t getDefaultThreadCount() const {
+			auto const coreCount = ThreadPool::getHardwareThreadCount();
+
+			if (SupportsStageSplit<HiddenGroupType>::value)
+				return coreCount;
+
+			return std::min(getHiddenGroupCount(), coreCount);
+		}
+
+		/// Sizes every group's output list, which only allocates the first
+		/// time round.
+		void prepareGroupOutputs() {
+			for (auto & i : groupOutputs_)
+				i.resize(getOutputNodeCount());
+		}
+
+		/// One task per group.
+		void executeGroups(std::false_type) {
+			auto const & activation = activation_;
+
+			prepareGroupOutputs();
+
+			threadPool_->run(getHiddenGroupCount(), [&](std::size_t i) {
+				hiddenGroupList_[i].execute(
+					inputNodes_.data(), groupOutputs_[i].data(), activation
+				);
+			});
+		}
+
+		/// One task per row tile of every group, a run per stage.
+		void executeGroups(std::true_type) {
+			auto const tilesPerGroup = getTilesPerGroup();
+
+			if (tilesPerGroup == 1) {
+				executeGroups(std::false_type {});
+				return;
+			}
+
+			auto const & activation = activation_;
+			auto const groupCount = getHiddenGroupCount();
+
+			for (std::size_t i {0}; i < getInputNodeCount(); ++i)
+				inputValues_[i] = inputNodes_[i].getValue();
+
+			auto const & first = hiddenGroupList_.front();
+
+			for (std::size_t stage {0}; stage < first.getStageCount(); ++stage) {
+				auto const rowCount    = first.getStageRowCount(stage);
+				auto const weightCount = rowCount * first.getStageColumnCount(stage);
+
+				auto const tileCount = std::max<std::size_t>(1, std::min({
+					tilesPerGroup, rowCount, weightCount / MIN_TILE_WEIGHTS
+				}));
+				auto const tileRows = (rowCount + tileCount - 1) / tileCount;
+
+				threadPool_->run(groupCount * tileCount, [&](std::size_t task) {
+					auto const rowBegin = (task % tileCount) * tileRows;
+					auto const rowEnd   = std::min(rowBegin + tileRows, rowCount);
+
+					if (rowBegin < rowEnd) {
+						hiddenGroupList_[task / tileCount].executeStageRows(
+							stage, inputValues_.data(), rowBegin, rowEnd, activation
+						);
+					}
+				});
+			}
+
+			for (std::size_t i {0}; i < groupCount; ++i) {
+				auto const outputs = hiddenGroupList_[i].getStageOutputs();
+				groupOutputs_[i].assign(outputs, outputs + getOutputNodeCount());
+			}
+		}
 
 		template <class T>
 		static T & getItem(ListInterface<T> & list, std::size_t index) {
 			return list.at(index);
 		}
 
+		ActivationType  activation_;
 		NodeList        inputNodes_;
 		NodeList        outputNodes_;
 		HiddenGroupList hiddenGroupList_;
 
-		ListInterface<std::future<FloatList> > futureList_;
+		/// Input node values, gathered once for split execution.
+		FloatList inputValues_;
+
+		/// Inputs as of the last executeIncremental, and what changed since.
+		FloatList   previousInputs_;
+		IndexList   changedInputs_;
+		FloatList   inputDeltas_;
+		std::size_t incrementalCallCount_;
+
+		ListInterface<FloatList> groupOutputs_;
+		ThreadPoolPtr            threadPool_;
 };
 
 
+/// Network whose groups use the structure-of-arrays DenseHiddenGroup layout,
+/// storing weights as t_WeightType (such as Float16 or BFloat16).
+template <
+	class t_NodeType,
+	template <class T> class t_ListInterface = ::ListInterface,
+	class t_Activation = SoftStep,
+	class t_WeightType = typename t_NodeType::FloatType
+>
+using DenseNetwork = Network<
+	t_NodeType, t_ListInterface, t_Activation,
+	DenseHiddenGroup<t_NodeType, t_ListInterface, t_Activation, t_WeightType>
+>;
+
+/// Network whose groups hold CSR weights, filled in with pruneHiddenGroup.
+template <
+	class t_NodeType,
+	template <class T> class t_ListInterface = ::ListInterface,
+	class t_Activation = SoftStep
+>
+using SparseNetwork = Network<
+	t_NodeType, t_ListInterface, t_Activation,
+	SparseHiddenGroup<t_NodeType, t_ListInterface, t_Activation>
+>;
+
+/// Inference-only network of int8 QuantizedHiddenGroups, built from a float
+/// network with quantizeNetwork.
+template <
+	class t_NodeType,
+	template <class T> class t_ListInterface = ::ListInterface,
+	class t_Activation = SoftStep
+>
+using QuantizedNetwork = Network<
+	t_NodeType, t_ListInterface, t_Activation,
+	QuantizedHiddenGroup<t_NodeType, t_ListInterface, t_Activation>
+>;
+
+/// Calibration pass, quantizes every group of a trained float network,
+/// fixes the groups' input scales from the samples and measures how far
+/// the quantized outputs drift from the float ones on those samples.
+/// @param samples sampleCount rows of getInputNodeCount() values.
+/// @param report  Filled in when not null.
+template <class t_NetworkType>
+QuantizedNetwork<
+	typename t_NetworkType::NodeType,
+	t_NetworkType::template ListInterface,
+	typename t_NetworkType::ActivationType
+>
+quantizeNetwork(t_NetworkType                             & network,
+                typename t_NetworkType::FloatList const & samples,
+                std::size_t                                 sampleCount,
+                QuantizationScale                           granularity,
+                QuantizationReport                        * report = nullptr) {
+	using QuantizedType = QuantizedNetwork<
+		typename t_NetworkType::NodeType,
+		t_NetworkType::template ListInterface,
+		typename t_NetworkType::ActivationType
+	>;
+
+	typename QuantizedType::HiddenGroupList groups;
+	groups.reserve(network.getHiddenGroupCount());
+
+	for (std::size_t i {0}; i < network.getHiddenGroupCount(); ++i) {
+		groups.push_back(quantizeHiddenGroup(network.getHiddenGroup(i), granularity));
+
+		if (sampleCount > 0)
+			groups.back().calibrate(samples.data(), sampleCount, network.getActivation());
+	}
+
+	QuantizedType quantized (std::move(groups), network.getThreadPoolPtr());
+	quantized.setActivation(network.getActivation());
+
+	if (report != nullptr && sampleCount > 0) {
+		*report = compareOutputs(
+			network.executeBatch(samples, sampleCount),
+			quantized.executeBatch(samples, sampleCount),
+			sampleCount
+		);
+	}
+
+	return quantized;
+}
+
 
 /* Old work, can safely be deleted.
 template <
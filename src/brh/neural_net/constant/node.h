@@ -44,7 +44,8 @@ class BasicNode
 		void addToValue(FloatType amount) { value_ += amount; }
 		void clearValue() { setValue(0); }
 
-		void applyActivation(FunctionType activator) {
+		template <class Activation>
+		void applyActivation(Activation const & activator) {
 			setValue(activator(getValue()));
 		}
 
@@ -0,0 +1,404 @@
+#ifndef NEURAL_NET_TESTING_SRC_CONSTANT_QUANTIZED_HIDDEN_GROUP_H
+#define NEURAL_NET_TESTING_SRC_CONSTANT_QUANTIZED_HIDDEN_GROUP_H
+
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+
+#include "../common.h"
+#include "../activation_functions.h"
+#include "../activation_stats.h"
+
+#include "quantized_matrix.h"
+
+namespace brh {
+	namespace neural {
+		namespace constant {
+
+/// Inference-only HiddenGroup with int8 weights, laid out like
+/// DenseHiddenGroup (one row of incoming weights per destination node).
+///
+/// Every matrix product quantizes its input vector to int8 too, so the
+/// whole product runs in integers and is scaled back to float once per
+/// destination node, activations stay float. Input scales are either fixed
+/// by calibrate, or worked out per vector from its largest magnitude when
+/// a stage hasn't been calibrated.
+///
+/// Stages: 0 is the input matrix, 1 to getNonTerminalLayerCount() the
+/// hidden matrices and the last one the output matrix.
+template <
+	class t_NodeType,
+	template <class T> class t_ListInterface = ::ListInterface,
+	class t_Activation = SoftStep
+>
+class QuantizedHiddenGroup
+{
+	public:
+		template <class T>
+		using ListInterface = t_ListInterface<T>;
+
+
+		using NodeType       = t_NodeType;
+		using NodePtr        = NodeType *;
+		using ActivationType = t_Activation;
+		using FloatType      = typename NodeType::FloatType;
+
+		using FloatList = ListInterface<FloatType>;
+
+		using FloatPtr      = FloatType       *;
+		using ConstFloatPtr = FloatType const *;
+
+		using MatrixType = QuantizedMatrix<FloatType, t_ListInterface>;
+		using MatrixList = ListInterface<MatrixType>;
+		using WeightType = typename MatrixType::WeightType;
+		using WeightList = ListInterface<WeightType>;
+
+		/// All weights zero, usually built with quantizeHiddenGroup instead.
+		QuantizedHiddenGroup(std::size_t inputNodeCount,
+		                     std::size_t outputNodeCount,
+		                     std::size_t layerCount,
+		                     std::size_t nodesPerLayer) :
+			inputNodeCount_  {inputNodeCount},
+			outputNodeCount_ {outputNodeCount},
+			layerCount_      {layerCount},
+			nodesPerLayer_   {nodesPerLayer},
+			matrices_        (),
+			inputScales_     (layerCount + 1, 0),
+			calibrating_     {false},
+			values_          (layerCount * nodesPerLayer),
+			inputValues_     (inputNodeCount) {
+			matrices_.reserve(getStageCount());
+			matrices_.emplace_back(nodesPerLayer, inputNodeCount);
+
+			for (std::size_t l {0}; l < getNonTerminalLayerCount(); ++l)
+				matrices_.emplace_back(nodesPerLayer, nodesPerLayer);
+
+			matrices_.emplace_back(outputNodeCount, nodesPerLayer);
+		}
+
+		std::size_t getInputNodeCount()  const { return inputNodeCount_; }
+		std::size_t getOutputNodeCount() const { return outputNodeCount_; }
+		std::size_t getLayerCount()      const { return layerCount_; }
+		std::size_t getNodesPerLayer()   const { return nodesPerLayer_; }
+
+		std::size_t getNonTerminalLayerCount() const {
+			return getLayerCount() - 1;
+		}
+
+		std::size_t getStageCount() const {
+			return getLayerCount() + 1;
+		}
+
+		FloatList execute(NodePtr nodes, ActivationType const & activation) {
+			FloatList outValues (getOutputNodeCount());
+			execute(nodes, outValues.data(), activation);
+			return outValues;
+		}
+
+		FloatList execute(ConstFloatPtr inputs, ActivationType const & activation) {
+			FloatList outValues (getOutputNodeCount());
+			execute(inputs, outValues.data(), activation);
+			return outValues;
+		}
+
+		/// See DenseHiddenGroup::execute, the quantization buffers are
+		/// reused once they've grown to size.
+		void execute(NodePtr                nodes,
+		             FloatPtr               outValues,
+		             ActivationType const & activation) {
+			for (std::size_t i {0}; i < getInputNodeCount(); ++i)
+				inputValues_[i] = nodes[i].getValue();
+
+			execute(inputValues_.data(), outValues, activation);
+		}
+
+		void execute(ConstFloatPtr          inputs,
+		             FloatPtr               outValues,
+		             ActivationType const & activation) {
+			auto const width = getNodesPerLayer();
+
+			runStage(0, inputs, 1, getLayerValues(0));
+			applyActivation(getLayerValues(0), width, activation);
+
+			for (std::size_t layerIndex {1}; layerIndex < getLayerCount(); ++layerIndex) {
+				runStage(layerIndex, getLayerValues(layerIndex - 1), 1,
+				         getLayerValues(layerIndex));
+				applyActivation(getLayerValues(layerIndex), width, activation);
+			}
+
+			runStage(getLayerCount(), getLayerValues(getNonTerminalLayerCount()), 1,
+			         outValues);
+			applyActivation(outValues, getOutputNodeCount(), activation);
+		}
+
+		/// See HiddenGroup::executeBatch.
+		FloatList executeBatch(ConstFloatPtr          inputs,
+		                       std::size_t            sampleCount,
+		                       ActivationType const & activation) {
+			if (sampleCount == 1)
+				return execute(inputs, activation);
+
+			auto const width = getNodesPerLayer();
+
+			FloatList current (sampleCount * width);
+			FloatList next    (sampleCount * width);
+
+			runStage(0, inputs, sampleCount, current.data());
+			applyActivation(current.data(), current.size(), activation);
+
+			for (std::size_t layerIndex {1}; layerIndex < getLayerCount(); ++layerIndex) {
+				runStage(layerIndex, current.data(), sampleCount, next.data());
+				applyActivation(next.data(), next.size(), activation);
+				current.swap(next);
+			}
+
+			FloatList outValues (sampleCount * getOutputNodeCount());
+
+			runStage(getLayerCount(), current.data(), sampleCount, outValues.data());
+			applyActivation(outValues.data(), outValues.size(), activation);
+
+			return outValues;
+		}
+
+		/// Activates values in place, sampling them into the
+		/// ActivationTracer when tracing is enabled.
+		void applyActivation(FloatPtr               values,
+		                     std::size_t            count,
+		                     ActivationType const & activation) {
+			if (!ActivationTracer::isEnabled()) {
+				activation(values, count);
+				return;
+			}
+
+			tracedValues_.assign(values, values + count);
+			activation(values, count);
+			ActivationTracer::record(tracedValues_.data(), values, count);
+		}
+
+		/// Fixes every stage's input scale from the largest magnitude that
+		/// reaches it over the calibration samples, so execution no longer
+		/// scans each vector first. Values beyond the calibrated range are
+		/// clamped.
+		/// @param samples sampleCount rows of getInputNodeCount() values.
+		void calibrate(ConstFloatPtr          samples,
+		               std::size_t            sampleCount,
+		               ActivationType const & activation) {
+			std::fill(inputScales_.begin(), inputScales_.end(), FloatType {0});
+			observedScales_.assign(getStageCount(), 0);
+
+			calibrating_ = true;
+			executeBatch(samples, sampleCount, activation);
+			calibrating_ = false;
+
+			inputScales_ = observedScales_;
+		}
+
+
+		FloatPtr getLayerValues(std::size_t layerIndex) {
+			return values_.data() + layerIndex * getNodesPerLayer();
+		}
+
+		MatrixType       & getMatrix(std::size_t stage)       { return matrices_.at(stage); }
+		MatrixType const & getMatrix(std::size_t stage) const { return matrices_.at(stage); }
+
+		/// [nodesPerLayer][inputNodeCount]
+		MatrixType       & getInputMatrix()       { return matrices_.front(); }
+		MatrixType const & getInputMatrix() const { return matrices_.front(); }
+
+		/// [nodesPerLayer][nodesPerLayer], from layer layerIndex to the next.
+		MatrixType       & getHiddenMatrix(std::size_t layerIndex) {
+			return matrices_.at(layerIndex + 1);
+		}
+
+		MatrixType const & getHiddenMatrix(std::size_t layerIndex) const {
+			return matrices_.at(layerIndex + 1);
+		}
+
+		/// [outputNodeCount][nodesPerLayer]
+		MatrixType       & getOutputMatrix()       { return matrices_.back(); }
+		MatrixType const & getOutputMatrix() const { return matrices_.back(); }
+
+		/// Zero for a stage that scales each input vector on its own.
+		FloatType getInputScale(std::size_t stage) const {
+			return inputScales_.at(stage);
+		}
+
+		void setInputScale(std::size_t stage, FloatType scale) {
+			inputScales_.at(stage) = scale;
+		}
+
+		std::size_t getWeightByteCount() const {
+			std::size_t count {0};
+
+			for (auto const & i : matrices_)
+				count += i.getByteCount();
+
+			return count;
+		}
+
+
+	private:
+		/// Quantizes sampleCount rows of the stage's input and multiplies.
+		void runStage(std::size_t   stage,
+		              ConstFloatPtr inputs,
+		              std::size_t   sampleCount,
+		              FloatPtr      outputs) {
+			auto const & matrix = matrices_[stage];
+			auto const columnCount = matrix.getColumnCount();
+
+			quantizedInputs_.resize(sampleCount * columnCount);
+			sampleScales_.resize(sampleCount);
+
+			for (std::size_t s {0}; s < sampleCount; ++s) {
+				auto const row = inputs + s * columnCount;
+				auto scale = inputScales_[stage];
+
+				if (scale == 0 || calibrating_) {
+					scale = findInt8Scale(row, columnCount);
+
+					if (calibrating_)
+						observedScales_[stage] = std::max(observedScales_[stage], scale);
+				}
+
+				sampleScales_[s] = scale;
+				quantizeInt8(row, columnCount, scale, quantizedInputs_.data() + s * columnCount);
+			}
+
+			if (sampleCount == 1)
+				matrix.multiply(quantizedInputs_.data(), sampleScales_[0], outputs);
+			else
+				matrix.multiplyBatch(quantizedInputs_.data(), sampleScales_.data(),
+				                     sampleCount, outputs);
+		}
+
+
+		std::size_t inputNodeCount_;
+		std::size_t outputNodeCount_;
+		std::size_t layerCount_;
+		std::size_t nodesPerLayer_;
+
+		MatrixList matrices_;
+
+		/// One per stage, zero when not calibrated.
+		FloatList inputScales_;
+
+		bool      calibrating_;
+		FloatList observedScales_;
+
+		FloatList values_;
+
+		/// Input node values gathered for execute(NodePtr, ...).
+		FloatList inputValues_;
+
+		/// The current stage's input rows as int8, and their scales.
+		WeightList quantizedInputs_;
+		FloatList  sampleScales_;
+
+		/// Pre-activation copy, only filled in while tracing.
+		FloatList tracedValues_;
+};
+
+
+/// Converts a float group (HiddenGroup or DenseHiddenGroup) to int8.
+/// Input scales are left per-vector until the group is calibrated.
+template <class t_HiddenGroup>
+QuantizedHiddenGroup<
+	typename t_HiddenGroup::NodeType,
+	t_HiddenGroup::template ListInterface,
+	typename t_HiddenGroup::ActivationType
+>
+quantizeHiddenGroup(t_HiddenGroup & group, QuantizationScale granularity) {
+	using QuantizedType = QuantizedHiddenGroup<
+		typename t_HiddenGroup::NodeType,
+		t_HiddenGroup::template ListInterface,
+		typename t_HiddenGroup::ActivationType
+	>;
+	using MatrixType = typename QuantizedType::MatrixType;
+
+	auto const width = group.getNodesPerLayer();
+
+	QuantizedType quantized {
+		group.getInputNodeCount(), group.getOutputNodeCount(),
+		group.getLayerCount(), width
+	};
+
+	quantized.getInputMatrix() = MatrixType::fromDense(
+		width, group.getInputNodeCount(),
+		[&](std::size_t r, std::size_t c) { return *group.getInputWeight(c, r); },
+		granularity
+	);
+
+	for (std::size_t l {0}; l < group.getNonTerminalLayerCount(); ++l) {
+		quantized.getHiddenMatrix(l) = MatrixType::fromDense(
+			width, width,
+			[&](std::size_t r, std::size_t c) {
+				return *group.getNonTerminalElement(l, c).getWeight(r);
+			},
+			granularity
+		);
+	}
+
+	quantized.getOutputMatrix() = MatrixType::fromDense(
+		group.getOutputNodeCount(), width,
+		[&](std::size_t r, std::size_t c) {
+			return *group.getTerminalElement(c).getWeight(r);
+		},
+		granularity
+	);
+
+	return quantized;
+}
+
+
+/// Output differences between a float network and its quantized copy over
+/// the calibration samples.
+struct QuantizationReport
+{
+	std::size_t sampleCount;
+	std::size_t valueCount;
+
+	double maxAbsError;
+	double meanAbsError;
+
+	/// Mean magnitude of the float outputs, for putting the errors in scale.
+	double meanAbsValue;
+
+	double getRelativeError() const {
+		return meanAbsValue > 0 ? meanAbsError / meanAbsValue : 0;
+	}
+
+	void print(std::ostream & stream) const {
+		stream << "int8 over " << sampleCount << " samples: max |error| "
+		       << maxAbsError << ", mean |error| " << meanAbsError
+		       << " (" << getRelativeError() * 100 << "% of mean |output|)\n";
+	}
+};
+
+/// Compares two equally long output lists.
+template <class FloatList>
+QuantizationReport compareOutputs(FloatList const & reference,
+                                  FloatList const & quantized,
+                                  std::size_t       sampleCount) {
+	QuantizationReport report {sampleCount, reference.size(), 0, 0, 0};
+
+	for (std::size_t i {0}; i < reference.size(); ++i) {
+		double const error {std::abs(static_cast<double>(quantized[i]) - reference[i])};
+
+		report.maxAbsError   = std::max(report.maxAbsError, error);
+		report.meanAbsError += error;
+		report.meanAbsValue += std::abs(static_cast<double>(reference[i]));
+	}
+
+	if (!reference.empty()) {
+		report.meanAbsError /= reference.size();
+		report.meanAbsValue /= reference.size();
+	}
+
+	return report;
+}
+
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,226 @@
+#ifndef NEURAL_NET_TESTING_SRC_CONSTANT_QUANTIZED_MATRIX_H
+#define NEURAL_NET_TESTING_SRC_CONSTANT_QUANTIZED_MATRIX_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "../common.h"
+
+namespace brh {
+	namespace neural {
+		namespace constant {
+
+/// Largest magnitude of a symmetric int8 value, -128 is never produced so
+/// negation can't overflow.
+constexpr std::int32_t INT8_LIMIT {127};
+
+/// How many weights share one scale.
+enum class QuantizationScale
+{
+	perLayer,
+	perRow
+};
+
+
+/// Integer dot product with int32 accumulation. Each product is at most
+/// 127 * 127, so rows up to ~130000 wide can't overflow.
+inline std::int32_t dotInt8(std::int8_t const * a,
+                            std::int8_t const * b,
+                            std::size_t         count) {
+	std::int32_t sum {0};
+	std::size_t i {0};
+
+#ifdef __SSE2__
+	// Sign-extends 16 values at a time to int16 (unpacking each byte into
+	// the high half and shifting it back down) and multiply-adds pairs
+	// into int32 lanes.
+	__m128i sums = _mm_setzero_si128();
+
+	for (; i + 16 <= count; i += 16) {
+		__m128i const x = _mm_loadu_si128(reinterpret_cast<__m128i const *>(a + i));
+		__m128i const y = _mm_loadu_si128(reinterpret_cast<__m128i const *>(b + i));
+
+		__m128i const xLow  = _mm_srai_epi16(_mm_unpacklo_epi8(x, x), 8);
+		__m128i const xHigh = _mm_srai_epi16(_mm_unpackhi_epi8(x, x), 8);
+		__m128i const yLow  = _mm_srai_epi16(_mm_unpacklo_epi8(y, y), 8);
+		__m128i const yHigh = _mm_srai_epi16(_mm_unpackhi_epi8(y, y), 8);
+
+		sums = _mm_add_epi32(sums, _mm_madd_epi16(xLow,  yLow));
+		sums = _mm_add_epi32(sums, _mm_madd_epi16(xHigh, yHigh));
+	}
+
+	std::int32_t lanes[4];
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), sums);
+
+	sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+
+	for (; i < count; ++i)
+		sum += static_cast<std::int32_t>(a[i]) * b[i];
+
+	return sum;
+}
+
+
+/// Scale mapping the largest magnitude of values onto INT8_LIMIT, zero when
+/// all values are.
+template <class FloatType>
+FloatType findInt8Scale(FloatType const * values, std::size_t count) {
+	FloatType largest {0};
+
+	for (std::size_t i {0}; i < count; ++i)
+		largest = std::max(largest, std::abs(values[i]));
+
+	return largest / INT8_LIMIT;
+}
+
+/// quantized[i] = round(values[i] / scale), clamped to the int8 range.
+template <class FloatType>
+void quantizeInt8(FloatType const * values,
+                  std::size_t       count,
+                  FloatType         scale,
+                  std::int8_t     * quantized) {
+	if (scale == 0) {
+		std::fill(quantized, quantized + count, std::int8_t {0});
+		return;
+	}
+
+	FloatType const inverse {1 / scale};
+
+	for (std::size_t i {0}; i < count; ++i) {
+		auto const rounded = static_cast<std::int32_t>(std::lround(values[i] * inverse));
+		quantized[i] = static_cast<std::int8_t>(
+			std::min(std::max(rounded, -INT8_LIMIT), INT8_LIMIT)
+		);
+	}
+}
+
+
+/// Row-major int8 weight matrix with symmetric float scales, either one per
+/// row or one shared by the whole matrix. A quarter the size of the float
+/// matrix it's built from, products are accumulated in int32 and scaled
+/// back once per row.
+template <
+	class t_FloatType = ::FloatType,
+	template <class T> class t_ListInterface = ::ListInterface
+>
+class QuantizedMatrix
+{
+	public:
+		template <class T>
+		using ListInterface = t_ListInterface<T>;
+
+		using FloatType  = t_FloatType;
+		using WeightType = std::int8_t;
+
+		using FloatList  = ListInterface<FloatType>;
+		using WeightList = ListInterface<WeightType>;
+
+		/// All weights zero.
+		QuantizedMatrix(std::size_t rowCount = 0, std::size_t columnCount = 0) :
+			rowCount_    {rowCount},
+			columnCount_ {columnCount},
+			weights_     (rowCount * columnCount),
+			scales_      (rowCount) {}
+
+		/// @param getWeight Called as getWeight(row, column).
+		template <class GetWeight>
+		static QuantizedMatrix fromDense(std::size_t       rowCount,
+		                                 std::size_t       columnCount,
+		                                 GetWeight         getWeight,
+		                                 QuantizationScale granularity) {
+			QuantizedMatrix matrix (rowCount, columnCount);
+			FloatList row (columnCount);
+
+			FloatType matrixScale {0};
+
+			if (granularity == QuantizationScale::perLayer) {
+				for (std::size_t r {0}; r < rowCount; ++r) {
+					for (std::size_t c {0}; c < columnCount; ++c)
+						row[c] = getWeight(r, c);
+
+					matrixScale = std::max(matrixScale, findInt8Scale(row.data(), columnCount));
+				}
+			}
+
+			for (std::size_t r {0}; r < rowCount; ++r) {
+				for (std::size_t c {0}; c < columnCount; ++c)
+					row[c] = getWeight(r, c);
+
+				auto const scale = granularity == QuantizationScale::perRow ?
+					findInt8Scale(row.data(), columnCount) : matrixScale;
+
+				matrix.scales_[r] = scale;
+				quantizeInt8(row.data(), columnCount, scale, matrix.getRow(r));
+			}
+
+			return matrix;
+		}
+
+		std::size_t getRowCount()    const { return rowCount_; }
+		std::size_t getColumnCount() const { return columnCount_; }
+
+		WeightType       * getRow(std::size_t row)       { return weights_.data() + row * columnCount_; }
+		WeightType const * getRow(std::size_t row) const { return weights_.data() + row * columnCount_; }
+
+		FloatType getScale(std::size_t row) const { return scales_[row]; }
+
+		/// The weight as seen by multiply, after quantization.
+		FloatType getWeight(std::size_t row, std::size_t column) const {
+			return getRow(row)[column] * getScale(row);
+		}
+
+		std::size_t getByteCount() const {
+			return weights_.size() * sizeof(WeightType) + scales_.size() * sizeof(FloatType);
+		}
+
+		/// outputs[r] = dot(row r, inputs) * scale[r] * inputScale
+		/// @param inputs columnCount values quantized with inputScale.
+		void multiply(WeightType const * inputs,
+		              FloatType          inputScale,
+		              FloatType        * outputs) const {
+			for (std::size_t r {0}; r < rowCount_; ++r) {
+				outputs[r] = static_cast<FloatType>(dotInt8(getRow(r), inputs, columnCount_)) *
+				             (scales_[r] * inputScale);
+			}
+		}
+
+		/// Batched multiply, each row is applied to every sample while it's
+		/// in cache.
+		/// @param inputs      sampleCount rows of getColumnCount() values.
+		/// @param inputScales One scale per sample row.
+		/// @param outputs     sampleCount rows of getRowCount() values.
+		void multiplyBatch(WeightType const * inputs,
+		                   FloatType  const * inputScales,
+		                   std::size_t        sampleCount,
+		                   FloatType        * outputs) const {
+			for (std::size_t r {0}; r < rowCount_; ++r) {
+				auto const row = getRow(r);
+
+				for (std::size_t s {0}; s < sampleCount; ++s) {
+					auto const sum = dotInt8(row, inputs + s * columnCount_, columnCount_);
+					outputs[s * rowCount_ + r] =
+						static_cast<FloatType>(sum) * (scales_[r] * inputScales[s]);
+				}
+			}
+		}
+
+
+	private:
+		std::size_t rowCount_;
+		std::size_t columnCount_;
+
+		WeightList weights_;
+		FloatList  scales_;
+};
+
+		}
+	}
+}
+
+#endif
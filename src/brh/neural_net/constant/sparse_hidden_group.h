@@ -0,0 +1,362 @@
+#ifndef NEURAL_NET_TESTING_SRC_CONSTANT_SPARSE_HIDDEN_GROUP_H
+#define NEURAL_NET_TESTING_SRC_CONSTANT_SPARSE_HIDDEN_GROUP_H
+
+#include "../common.h"
+#include "../activation_functions.h"
+#include "../activation_stats.h"
+
+#include "csr_matrix.h"
+
+namespace brh {
+	namespace neural {
+		namespace constant {
+
+/// HiddenGroup with CSR weight matrices, laid out like DenseHiddenGroup
+/// (one row of incoming weights per destination node) but holding only the
+/// nonzero weights. Usually built from a dense group with pruneHiddenGroup.
+template <
+	class t_NodeType,
+	template <class T> class t_ListInterface = ::ListInterface,
+	class t_Activation = SoftStep
+>
+class SparseHiddenGroup
+{
+	public:
+		template <class T>
+		using ListInterface = t_ListInterface<T>;
+
+
+		using NodeType       = t_NodeType;
+		using NodePtr        = NodeType *;
+		using ActivationType = t_Activation;
+		using FloatType      = typename NodeType::FloatType;
+
+		using FloatList = ListInterface<FloatType>;
+
+		using FloatPtr      = FloatType       *;
+		using ConstFloatPtr = FloatType const *;
+
+		using MatrixType = CsrMatrix<FloatType, t_ListInterface>;
+		using MatrixList = ListInterface<MatrixType>;
+
+		/// All weights start out absent (zero).
+		SparseHiddenGroup(std::size_t inputNodeCount,
+		                  std::size_t outputNodeCount,
+		                  std::size_t layerCount,
+		                  std::size_t nodesPerLayer) :
+			inputNodeCount_  {inputNodeCount},
+			outputNodeCount_ {outputNodeCount},
+			layerCount_      {layerCount},
+			nodesPerLayer_   {nodesPerLayer},
+			inputMatrix_     (nodesPerLayer, inputNodeCount),
+			hiddenMatrices_  (layerCount - 1, MatrixType(nodesPerLayer, nodesPerLayer)),
+			outputMatrix_    (outputNodeCount, nodesPerLayer),
+			values_          (layerCount * nodesPerLayer),
+			outputValues_    (outputNodeCount),
+			inputValues_     (inputNodeCount) {}
+
+		std::size_t getInputNodeCount()  const { return inputNodeCount_; }
+		std::size_t getOutputNodeCount() const { return outputNodeCount_; }
+		std::size_t getLayerCount()      const { return layerCount_; }
+		std::size_t getNodesPerLayer()   const { return nodesPerLayer_; }
+
+		std::size_t getNonTerminalLayerCount() const {
+			return getLayerCount() - 1;
+		}
+
+		FloatList execute(NodePtr nodes, ActivationType const & activation) {
+			FloatList outValues (getOutputNodeCount());
+			execute(nodes, outValues.data(), activation);
+			return outValues;
+		}
+
+		FloatList execute(ConstFloatPtr inputs, ActivationType const & activation) {
+			FloatList outValues (getOutputNodeCount());
+			execute(inputs, outValues.data(), activation);
+			return outValues;
+		}
+
+		/// See DenseHiddenGroup::execute.
+		void execute(NodePtr                nodes,
+		             FloatPtr               outValues,
+		             ActivationType const & activation) {
+			for (std::size_t i {0}; i < getInputNodeCount(); ++i)
+				inputValues_[i] = nodes[i].getValue();
+
+			execute(inputValues_.data(), outValues, activation);
+		}
+
+		void execute(ConstFloatPtr          inputs,
+		             FloatPtr               outValues,
+		             ActivationType const & activation) {
+			executeLayers(inputs, values_.data(), getLayerCount(), outValues, activation);
+		}
+
+		/// See DenseHiddenGroup::executeInto.
+		std::size_t getWorkspaceSize() const {
+			return 2 * getNodesPerLayer();
+		}
+
+		void executeInto(ConstFloatPtr          inputs,
+		                 FloatPtr               outValues,
+		                 FloatPtr               workspace,
+		                 ActivationType const & activation) const {
+			executeLayers(inputs, workspace, 2, outValues, activation);
+		}
+
+		/// See HiddenGroup::executeBatch.
+		FloatList executeBatch(ConstFloatPtr          inputs,
+		                       std::size_t            sampleCount,
+		                       ActivationType const & activation) {
+			if (sampleCount == 1)
+				return execute(inputs, activation);
+
+			auto const width = getNodesPerLayer();
+
+			FloatList current (sampleCount * width);
+			FloatList next    (sampleCount * width);
+
+			inputMatrix_.multiplyBatch(inputs, sampleCount, current.data());
+			applyActivation(current.data(), current.size(), activation);
+
+			for (auto const & matrix : hiddenMatrices_) {
+				matrix.multiplyBatch(current.data(), sampleCount, next.data());
+				applyActivation(next.data(), next.size(), activation);
+				current.swap(next);
+			}
+
+			FloatList outValues (sampleCount * getOutputNodeCount());
+
+			outputMatrix_.multiplyBatch(current.data(), sampleCount, outValues.data());
+			applyActivation(outValues.data(), outValues.size(), activation);
+
+			return outValues;
+		}
+
+		// Row-range execution, see DenseHiddenGroup::executeStageRows.
+
+		std::size_t getStageCount() const {
+			return getLayerCount() + 1;
+		}
+
+		std::size_t getStageRowCount(std::size_t stage) const {
+			return stage < getLayerCount() ? getNodesPerLayer() : getOutputNodeCount();
+		}
+
+		std::size_t getStageColumnCount(std::size_t stage) const {
+			return stage == 0 ? getInputNodeCount() : getNodesPerLayer();
+		}
+
+		void executeStageRows(std::size_t            stage,
+		                      ConstFloatPtr          inputs,
+		                      std::size_t            rowBegin,
+		                      std::size_t            rowEnd,
+		                      ActivationType const & activation) {
+			FloatPtr stageOutputs;
+
+			if (stage == 0) {
+				stageOutputs = getLayerValues(0);
+				inputMatrix_.multiply(inputs, stageOutputs, rowBegin, rowEnd);
+			}
+			else if (stage < getLayerCount()) {
+				stageOutputs = getLayerValues(stage);
+				hiddenMatrices_[stage - 1].multiply(
+					getLayerValues(stage - 1), stageOutputs, rowBegin, rowEnd
+				);
+			}
+			else {
+				stageOutputs = outputValues_.data();
+				outputMatrix_.multiply(
+					getLayerValues(getNonTerminalLayerCount()), stageOutputs, rowBegin, rowEnd
+				);
+			}
+
+			applyActivationConcurrent(stageOutputs + rowBegin, rowEnd - rowBegin, activation);
+		}
+
+		ConstFloatPtr getStageOutputs() const {
+			return outputValues_.data();
+		}
+
+		/// Activates values in place, sampling them into the
+		/// ActivationTracer when tracing is enabled.
+		void applyActivation(FloatPtr               values,
+		                     std::size_t            count,
+		                     ActivationType const & activation) {
+			if (!ActivationTracer::isEnabled()) {
+				activation(values, count);
+				return;
+			}
+
+			tracedValues_.assign(values, values + count);
+			activation(values, count);
+			ActivationTracer::record(tracedValues_.data(), values, count);
+		}
+
+
+		FloatPtr getLayerValues(std::size_t layerIndex) {
+			return values_.data() + layerIndex * getNodesPerLayer();
+		}
+
+		/// [nodesPerLayer][inputNodeCount]
+		MatrixType       & getInputMatrix()       { return inputMatrix_; }
+		MatrixType const & getInputMatrix() const { return inputMatrix_; }
+
+		/// [nodesPerLayer][nodesPerLayer], from layer layerIndex to the next.
+		MatrixType       & getHiddenMatrix(std::size_t layerIndex) {
+			return hiddenMatrices_.at(layerIndex);
+		}
+
+		MatrixType const & getHiddenMatrix(std::size_t layerIndex) const {
+			return hiddenMatrices_.at(layerIndex);
+		}
+
+		/// [outputNodeCount][nodesPerLayer]
+		MatrixType       & getOutputMatrix()       { return outputMatrix_; }
+		MatrixType const & getOutputMatrix() const { return outputMatrix_; }
+
+		std::size_t getNonZeroCount() const {
+			std::size_t count {inputMatrix_.getNonZeroCount()};
+
+			for (auto const & i : hiddenMatrices_)
+				count += i.getNonZeroCount();
+
+			return count + outputMatrix_.getNonZeroCount();
+		}
+
+		std::size_t getWeightCount() const {
+			return getNodesPerLayer() * (
+				getInputNodeCount() +
+				getNodesPerLayer() * getNonTerminalLayerCount() +
+				getOutputNodeCount()
+			);
+		}
+
+		double getDensity() const {
+			auto const total = getWeightCount();
+			return total == 0 ? 0 :
+				static_cast<double>(getNonZeroCount()) / static_cast<double>(total);
+		}
+
+
+	private:
+		/// Layer l's values go to slot l % slotCount of values, see
+		/// DenseHiddenGroup::executeFromSecondLayer.
+		void executeLayers(ConstFloatPtr          inputs,
+		                   FloatPtr               values,
+		                   std::size_t            slotCount,
+		                   FloatPtr               outValues,
+		                   ActivationType const & activation) const {
+			auto const width = getNodesPerLayer();
+
+			auto layer = [&](std::size_t layerIndex) {
+				return values + (layerIndex % slotCount) * width;
+			};
+
+			inputMatrix_.multiply(inputs, layer(0));
+			applyActivationConcurrent(layer(0), width, activation);
+
+			for (std::size_t layerIndex {1}; layerIndex < getLayerCount(); ++layerIndex) {
+				hiddenMatrices_[layerIndex - 1].multiply(
+					layer(layerIndex - 1), layer(layerIndex)
+				);
+				applyActivationConcurrent(layer(layerIndex), width, activation);
+			}
+
+			outputMatrix_.multiply(layer(getNonTerminalLayerCount()), outValues);
+			applyActivationConcurrent(outValues, getOutputNodeCount(), activation);
+		}
+
+		/// applyActivation for code that may run on several threads at
+		/// once, which can't share tracedValues_. Allocates while tracing.
+		static void applyActivationConcurrent(FloatPtr               values,
+		                                      std::size_t            count,
+		                                      ActivationType const & activation) {
+			if (!ActivationTracer::isEnabled()) {
+				activation(values, count);
+				return;
+			}
+
+			FloatList const preActivation (values, values + count);
+			activation(values, count);
+			ActivationTracer::record(preActivation.data(), values, count);
+		}
+
+		std::size_t inputNodeCount_;
+		std::size_t outputNodeCount_;
+		std::size_t layerCount_;
+		std::size_t nodesPerLayer_;
+
+		MatrixType inputMatrix_;
+		MatrixList hiddenMatrices_;
+		MatrixType outputMatrix_;
+
+		FloatList values_;
+
+		/// Results of the last stage of executeStageRows.
+		FloatList outputValues_;
+
+		/// Input node values gathered for execute(NodePtr, ...).
+		FloatList inputValues_;
+
+		/// Pre-activation copy, only filled in while tracing.
+		FloatList tracedValues_;
+};
+
+
+/// Magnitude pruning, converts a dense group (HiddenGroup or
+/// DenseHiddenGroup) to sparse form keeping the largest density fraction of
+/// each weight matrix.
+template <class t_HiddenGroup>
+SparseHiddenGroup<
+	typename t_HiddenGroup::NodeType,
+	t_HiddenGroup::template ListInterface,
+	typename t_HiddenGroup::ActivationType
+>
+pruneHiddenGroup(t_HiddenGroup & group, double density) {
+	using SparseType = SparseHiddenGroup<
+		typename t_HiddenGroup::NodeType,
+		t_HiddenGroup::template ListInterface,
+		typename t_HiddenGroup::ActivationType
+	>;
+	using MatrixType = typename SparseType::MatrixType;
+
+	auto const width = group.getNodesPerLayer();
+
+	SparseType sparse {
+		group.getInputNodeCount(), group.getOutputNodeCount(),
+		group.getLayerCount(), width
+	};
+
+	sparse.getInputMatrix() = MatrixType::fromDense(
+		width, group.getInputNodeCount(),
+		[&](std::size_t r, std::size_t c) { return *group.getInputWeight(c, r); },
+		density
+	);
+
+	for (std::size_t l {0}; l < group.getNonTerminalLayerCount(); ++l) {
+		sparse.getHiddenMatrix(l) = MatrixType::fromDense(
+			width, width,
+			[&](std::size_t r, std::size_t c) {
+				return *group.getNonTerminalElement(l, c).getWeight(r);
+			},
+			density
+		);
+	}
+
+	sparse.getOutputMatrix() = MatrixType::fromDense(
+		group.getOutputNodeCount(), width,
+		[&](std::size_t r, std::size_t c) {
+			return *group.getTerminalElement(c).getWeight(r);
+		},
+		density
+	);
+
+	return sparse;
+}
+
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,252 @@
+#ifndef NEURAL_NET_TESTING_SRC_CONSTANT_WEIGHT_INIT_H
+#define NEURAL_NET_TESTING_SRC_CONSTANT_WEIGHT_INIT_H
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+#include "../common.h"
+#include "../philox.h"
+
+namespace brh {
+	namespace neural {
+		namespace constant {
+
+enum class WeightDistribution
+{
+	uniform,
+	normal,
+
+	/// Glorot & Bengio, variance 2 / (fanIn + fanOut).
+	xavierUniform,
+	xavierNormal,
+
+	/// He et al., variance 2 / fanIn.
+	heUniform,
+	heNormal
+};
+
+
+/// How to initialize a hidden group's weights. Every weight is a pure
+/// function of (seed, group, stage, index), see initializeStageRows, so the
+/// result doesn't depend on how the work is split between threads.
+struct WeightInit
+{
+	WeightDistribution distribution;
+
+	/// Lower bound or mean, unused by the scaled distributions.
+	FloatType first;
+
+	/// Upper bound or standard deviation, unused by the scaled
+	/// distributions.
+	FloatType second;
+
+	std::uint64_t seed;
+
+	static WeightInit uniform(FloatType min, FloatType max, std::uint64_t seed = 0) {
+		return {WeightDistribution::uniform, min, max, seed};
+	}
+
+	static WeightInit normal(FloatType mean, FloatType deviation, std::uint64_t seed = 0) {
+		return {WeightDistribution::normal, mean, deviation, seed};
+	}
+
+	static WeightInit scaled(WeightDistribution distribution, std::uint64_t seed = 0) {
+		return {distribution, 0, 0, seed};
+	}
+
+	bool isNormal() const {
+		return distribution == WeightDistribution::normal ||
+		       distribution == WeightDistribution::xavierNormal ||
+		       distribution == WeightDistribution::heNormal;
+	}
+
+	/// (offset, scale) applied to a standard uniform [0, 1) or standard
+	/// normal value for a layer with the given fan-in and fan-out.
+	void getTransform(std::size_t fanIn,
+	                  std::size_t fanOut,
+	                  FloatType & offset,
+	                  FloatType & scale) const {
+		auto const xavier = static_cast<FloatType>(2) / static_cast<FloatType>(fanIn + fanOut);
+		auto const he     = static_cast<FloatType>(2) / static_cast<FloatType>(fanIn);
+
+		// A uniform over [-limit, limit) has variance limit^2 / 3.
+		switch (distribution) {
+			case WeightDistribution::uniform:
+				offset = first;
+				scale  = second - first;
+				break;
+
+			case WeightDistribution::normal:
+				offset = first;
+				scale  = second;
+				break;
+
+			case WeightDistribution::xavierUniform:
+				scale  = 2 * std::sqrt(3 * xavier);
+				offset = -scale / 2;
+				break;
+
+			case WeightDistribution::xavierNormal:
+				offset = 0;
+				scale  = std::sqrt(xavier);
+				break;
+
+			case WeightDistribution::heUniform:
+				scale  = 2 * std::sqrt(3 * he);
+				offset = -scale / 2;
+				break;
+
+			case WeightDistribution::heNormal:
+				offset = 0;
+				scale  = std::sqrt(he);
+				break;
+		}
+	}
+};
+
+
+/// Fills values with weights [firstIndex, firstIndex + count) of one stage.
+/// Weight i comes from Philox block (i / 4, stage, group) under the seed,
+/// normal values pairing the block's words for Box-Muller.
+template <class FloatType>
+void generateWeights(WeightInit const & init,
+                     std::size_t        groupIndex,
+                     std::size_t        stage,
+                     std::size_t        fanIn,
+                     std::size_t        fanOut,
+                     std::size_t        firstIndex,
+                     std::size_t        count,
+                     FloatType        * values) {
+	Philox4x32 const generator (init.seed);
+	bool const normal {init.isNormal()};
+
+	FloatType offset {0};
+	FloatType scale  {1};
+	init.getTransform(fanIn, fanOut, offset, scale);
+
+	auto const endIndex = firstIndex + count;
+
+	for (auto index = firstIndex; index < endIndex;) {
+		auto const blockIndex = static_cast<std::uint64_t>(index / 4);
+
+		auto const block = generator(
+			static_cast<std::uint32_t>(blockIndex),
+			static_cast<std::uint32_t>(blockIndex >> 32),
+			static_cast<std::uint32_t>(stage),
+			static_cast<std::uint32_t>(groupIndex)
+		);
+
+		float standard[4];
+
+		if (normal) {
+			Philox4x32::toNormalPair(block.words[0], block.words[1], standard[0], standard[1]);
+			Philox4x32::toNormalPair(block.words[2], block.words[3], standard[2], standard[3]);
+		}
+		else {
+			for (std::size_t i {0}; i < 4; ++i)
+				standard[i] = Philox4x32::toUniform(block.words[i]);
+		}
+
+		auto const blockEnd = std::min<std::size_t>(blockIndex * 4 + 4, endIndex);
+
+		for (; index < blockEnd; ++index)
+			*values++ = offset + scale * static_cast<FloatType>(standard[index % 4]);
+	}
+}
+
+
+/// Rows (destination nodes) and columns (source nodes) of a group's
+/// stages, numbered as DenseHiddenGroup does: stage 0 is the input matrix,
+/// stage l the hidden matrix from layer l - 1 to layer l and the last stage
+/// the output matrix.
+template <class HiddenGroupType>
+std::size_t getInitStageRowCount(HiddenGroupType const & group, std::size_t stage) {
+	return stage < group.getLayerCount() ? group.getNodesPerLayer() : group.getOutputNodeCount();
+}
+
+template <class HiddenGroupType>
+std::size_t getInitStageColumnCount(HiddenGroupType const & group, std::size_t stage) {
+	return stage == 0 ? group.getInputNodeCount() : group.getNodesPerLayer();
+}
+
+/// Whether the group's weights may be written. Groups reading a mapped
+/// model file (DenseHiddenGroup::hasMappedWeights) can't be, the mapping
+/// is read-only and a write through the accessors faults.
+template <class HiddenGroupType>
+auto hasWritableWeights(HiddenGroupType const & group, int)
+	-> decltype(group.hasMappedWeights(), bool()) {
+	return !group.hasMappedWeights();
+}
+
+template <class HiddenGroupType>
+bool hasWritableWeights(HiddenGroupType const &, long) {
+	return true;
+}
+
+/// Throws std::invalid_argument unless hasWritableWeights(group).
+template <class HiddenGroupType>
+void requireWritableWeights(HiddenGroupType const & group) {
+	if (!hasWritableWeights(group, 0))
+		throw std::invalid_argument("Hidden group weights are mapped read-only");
+}
+
+/// Initializes rows [rowBegin, rowEnd) of one stage. Weight (row, column)
+/// is stage index row * columnCount + column, whatever the group's
+/// storage layout, so any group type gets the same weights. May run on a
+/// pool thread, so callers check requireWritableWeights beforehand.
+template <class HiddenGroupType>
+void initializeStageRows(HiddenGroupType  & group,
+                         WeightInit const & init,
+                         std::size_t        groupIndex,
+                         std::size_t        stage,
+                         std::size_t        rowBegin,
+                         std::size_t        rowEnd) {
+	using FloatType = typename HiddenGroupType::FloatType;
+
+	assert(hasWritableWeights(group, 0));
+
+	auto const rowCount    = getInitStageRowCount(group, stage);
+	auto const columnCount = getInitStageColumnCount(group, stage);
+
+	ListInterface<FloatType> row (columnCount);
+
+	for (auto r = rowBegin; r < rowEnd; ++r) {
+		generateWeights(
+			init, groupIndex, stage, columnCount, rowCount,
+			r * columnCount, columnCount, row.data()
+		);
+
+		if (stage == 0) {
+			for (std::size_t c {0}; c < columnCount; ++c)
+				*group.getInputWeight(c, r) = row[c];
+		}
+		else if (stage < group.getLayerCount()) {
+			for (std::size_t c {0}; c < columnCount; ++c)
+				*group.getNonTerminalElement(stage - 1, c).getWeight(r) = row[c];
+		}
+		else {
+			for (std::size_t c {0}; c < columnCount; ++c)
+				*group.getTerminalElement(c).getWeight(r) = row[c];
+		}
+	}
+}
+
+/// Initializes every weight of a group on the calling thread.
+template <class HiddenGroupType>
+void initializeHiddenGroup(HiddenGroupType  & group,
+                           WeightInit const & init,
+                           std::size_t        groupIndex = 0) {
+	requireWritableWeights(group);
+
+	for (std::size_t stage {0}; stage <= group.getLayerCount(); ++stage)
+		initializeStageRows(group, init, groupIndex, stage, 0, getInitStageRowCount(group, stage));
+}
+
+		}
+	}
+}
+
+#endif
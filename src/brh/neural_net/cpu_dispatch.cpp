@@ -0,0 +1,256 @@
+#include "cpu_dispatch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+namespace brh {
+	namespace neural {
+
+namespace {
+
+constexpr char const * ISA_VARIABLE {"BRH_NEURAL_NET_ISA"};
+
+constexpr Isa ISA_LEVELS[] {Isa::scalar, Isa::sse42, Isa::avx2, Isa::avx512};
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/// Register state the operating system saves on context switches.
+std::uint64_t getEnabledStates() {
+	std::uint32_t low;
+	std::uint32_t high;
+	__asm__ ("xgetbv" : "=a" (low), "=d" (high) : "c" (0));
+	return (static_cast<std::uint64_t>(high) << 32) | low;
+}
+
+#endif
+
+bool parseIsa(std::string const & name, Isa & isa) {
+	for (auto level : ISA_LEVELS) {
+		if (name == getIsaName(level)) {
+			isa = level;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+KernelTable selectKernels() {
+	auto isa = detectIsa();
+
+	if (char const * value = std::getenv(ISA_VARIABLE)) {
+		Isa requested;
+
+		if (!parseIsa(value, requested))
+			std::cerr << ISA_VARIABLE << ": unknown instruction set " << value << '\n';
+		else if (requested > isa)
+			std::cerr << ISA_VARIABLE << ": " << value << " isn't supported, using "
+			          << getIsaName(isa) << '\n';
+		else
+			isa = requested;
+	}
+
+	// Falls back a level at a time past variants this build lacks.
+	KernelTable table;
+
+	while (!getKernelTable(isa, table))
+		isa = static_cast<Isa>(static_cast<int>(isa) - 1);
+
+	return table;
+}
+
+
+/// Largest difference from the reference over the largest difference
+/// allowed.
+struct SelfTestResult
+{
+	double maxError;
+	double maxRatio;
+
+	SelfTestResult() : maxError {0}, maxRatio {0} {}
+
+	void add(double value, double reference, double tolerance) {
+		auto const error = std::abs(value - reference);
+
+		maxError = std::max(maxError, error);
+		maxRatio = std::max(maxRatio, tolerance == 0 ?
+			(error == 0 ? 0 : HUGE_VAL) : error / tolerance);
+	}
+
+	bool passed() const { return maxRatio <= 1; }
+};
+
+void printSelfTestResult(std::ostream       & out,
+                         Isa                  isa,
+                         char const         * kernel,
+                         SelfTestResult const & result) {
+	out << std::left << std::setw(8) << getIsaName(isa)
+	    << std::setw(9) << kernel << std::right
+	    << "max error " << std::scientific << std::setprecision(2) << result.maxError
+	    << (result.passed() ? "  ok\n" : "  FAILED\n");
+}
+
+}
+
+
+char const * getIsaName(Isa isa) {
+	switch (isa) {
+		case Isa::scalar: return "scalar";
+		case Isa::sse42:  return "sse4.2";
+		case Isa::avx2:   return "avx2";
+		case Isa::avx512: return "avx512";
+	}
+
+	return "unknown";
+}
+
+Isa detectIsa() {
+#if defined(__x86_64__) || defined(__i386__)
+	unsigned int eax, ebx, ecx, edx;
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_2))
+		return Isa::scalar;
+
+	// AVX needs the operating system to save the ymm registers, AVX-512
+	// the opmask and zmm registers on top.
+	bool const osAvx {(ecx & bit_OSXSAVE) && (getEnabledStates() & 0x06) == 0x06};
+	bool const fma   {(ecx & bit_AVX) && (ecx & bit_FMA)};
+
+	if (!osAvx || !fma || !__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) ||
+	    !(ebx & bit_AVX2))
+		return Isa::sse42;
+
+	if ((ebx & bit_AVX512F) && (getEnabledStates() & 0xe6) == 0xe6)
+		return Isa::avx512;
+
+	return Isa::avx2;
+#else
+	return Isa::scalar;
+#endif
+}
+
+bool getKernelTable(Isa isa, KernelTable & table) {
+	switch (isa) {
+		case Isa::scalar: return detail::getScalarKernels(table);
+		case Isa::sse42:  return detail::getSse42Kernels(table);
+		case Isa::avx2:   return detail::getAvx2Kernels(table);
+		case Isa::avx512: return detail::getAvx512Kernels(table);
+	}
+
+	return false;
+}
+
+KernelTable const & getKernels() {
+	static KernelTable const table {selectKernels()};
+	return table;
+}
+
+bool runKernelSelfTest(std::ostream & out) {
+	constexpr std::size_t MAX_COUNT  {1037};
+	constexpr std::size_t MAX_OFFSET {4};
+
+	// Vectorized sums are reordered and fused, so dot and axpy are held
+	// to a few ulps of the magnitudes involved. sigmoid has to match.
+	constexpr double SUM_TOLERANCE {1e-6};
+
+	KernelTable reference;
+	detail::getScalarKernels(reference);
+
+	out << "Kernels in use: " << getIsaName(getKernels().isa)
+	    << ", detected: " << getIsaName(detectIsa()) << '\n';
+
+	std::mt19937 engine {1};
+	std::uniform_real_distribution<float> unit     {-1, 1};
+	std::uniform_real_distribution<float> argument {-100, 100};
+
+	std::vector<float> a (MAX_COUNT + MAX_OFFSET);
+	std::vector<float> b (MAX_COUNT + MAX_OFFSET);
+	std::vector<float> expected (MAX_COUNT + MAX_OFFSET);
+	std::vector<float> actual   (MAX_COUNT + MAX_OFFSET);
+
+	std::vector<std::size_t> counts;
+
+	for (std::size_t count {0}; count <= 70; ++count)
+		counts.push_back(count);
+
+	counts.insert(counts.end(), {255, 256, 257, 1000, MAX_COUNT});
+
+	bool passed {true};
+
+	for (auto isa : ISA_LEVELS) {
+		KernelTable table;
+
+		if (isa == Isa::scalar || isa > detectIsa())
+			continue;
+
+		if (!getKernelTable(isa, table)) {
+			out << std::left << std::setw(8) << getIsaName(isa) << "not built\n";
+			continue;
+		}
+
+		SelfTestResult dotResult, axpyResult, sigmoidResult;
+
+		for (auto count : counts) {
+			for (std::size_t offset {0}; offset < MAX_OFFSET; ++offset) {
+				float const * x {a.data() + offset};
+				float const * y {b.data() + offset};
+
+				for (auto & value : a) value = unit(engine);
+				for (auto & value : b) value = unit(engine);
+
+				double magnitude {0};
+
+				for (std::size_t i {0}; i < count; ++i)
+					magnitude += std::abs(x[i] * y[i]);
+
+				dotResult.add(table.dot(x, y, count), reference.dot(x, y, count),
+				              SUM_TOLERANCE * std::max(magnitude, 1.0));
+
+				auto const scale = unit(engine);
+				std::copy(b.begin(), b.end(), expected.begin());
+				std::copy(b.begin(), b.end(), actual.begin());
+
+				reference.axpy(scale, x, expected.data() + offset, count);
+				table.axpy(scale, x, actual.data() + offset, count);
+
+				// Writing past count shows up as a mismatch too.
+				for (std::size_t i {0}; i < actual.size(); ++i) {
+					axpyResult.add(actual[i], expected[i],
+					               SUM_TOLERANCE * (std::abs(scale * a[i]) + std::abs(b[i])));
+				}
+
+				for (auto & value : expected) value = argument(engine);
+				std::copy(expected.begin(), expected.end(), actual.begin());
+
+				reference.sigmoid(expected.data() + offset, count);
+				table.sigmoid(actual.data() + offset, count);
+
+				for (std::size_t i {0}; i < actual.size(); ++i)
+					sigmoidResult.add(actual[i], expected[i], 0);
+			}
+		}
+
+		printSelfTestResult(out, isa, "dot",     dotResult);
+		printSelfTestResult(out, isa, "axpy",    axpyResult);
+		printSelfTestResult(out, isa, "sigmoid", sigmoidResult);
+
+		passed = passed && dotResult.passed() && axpyResult.passed() &&
+		         sigmoidResult.passed();
+	}
+
+	return passed;
+}
+
+	}
+}
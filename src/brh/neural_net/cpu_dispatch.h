@@ -0,0 +1,78 @@
+#ifndef NEURAL_NET_TESTING_CPU_DISPATCH_H
+#define NEURAL_NET_TESTING_CPU_DISPATCH_H
+
+#include <cstddef>
+#include <iosfwd>
+
+namespace brh {
+	namespace neural {
+
+/// Instruction set levels the dense kernels are compiled for, in
+/// ascending order. Each level's kernels live in their own translation
+/// unit built with that level's compiler flags, see CMakeLists.txt.
+enum class Isa
+{
+	scalar,
+	sse42,
+	avx2,
+	avx512
+};
+
+
+/// The dispatched kernels of one Isa. Every variant takes unaligned
+/// pointers and any count.
+struct KernelTable
+{
+	Isa isa;
+
+	/// sum of a[i] * b[i].
+	float (*dot)(float const * a, float const * b, std::size_t count);
+
+	/// y[i] += a * x[i].
+	void (*axpy)(float a, float const * x, float * y, std::size_t count);
+
+	/// In place activation::sigmoid<Accuracy::polynomial>. The exp
+	/// polynomial is evaluated without fused multiply-adds in every
+	/// variant, so the results are the same whatever variant runs.
+	void (*sigmoid)(float * values, std::size_t count);
+};
+
+
+/// Name as accepted by the BRH_NEURAL_NET_ISA environment variable:
+/// "scalar", "sse4.2", "avx2" or "avx512".
+char const * getIsaName(Isa isa);
+
+/// Highest level both the processor and the operating system support,
+/// read with cpuid and xgetbv. Always Isa::scalar off x86.
+Isa detectIsa();
+
+/// Fills table with the kernels of isa. Returns false if this build has no
+/// kernels for it, without checking the processor.
+bool getKernelTable(Isa isa, KernelTable & table);
+
+/// Kernels picked on first use: detectIsa(), lowered to BRH_NEURAL_NET_ISA
+/// when that names a supported level. An unknown or unsupported name is
+/// reported on std::cerr and ignored.
+KernelTable const & getKernels();
+
+/// Compares every variant the processor supports against the scalar
+/// kernels over a range of sizes and misalignments, printing one line per
+/// variant and kernel. Returns true if all of them agree.
+bool runKernelSelfTest(std::ostream & out);
+
+
+namespace detail {
+
+/// Defined by kernels_<isa>.cpp, return false when that file was built
+/// without its instruction set.
+bool getScalarKernels(KernelTable & table);
+bool getSse42Kernels (KernelTable & table);
+bool getAvx2Kernels  (KernelTable & table);
+bool getAvx512Kernels(KernelTable & table);
+
+}
+
+	}
+}
+
+#endif
@@ -0,0 +1,324 @@
+#ifndef NEURAL_NET_TESTING_SRC_DYNAMIC_COMPILED_GRAPH_H
+#define NEURAL_NET_TESTING_SRC_DYNAMIC_COMPILED_GRAPH_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "../common.h"
+#include "../activation_functions.h"
+
+namespace brh {
+	namespace neural {
+		namespace dynamic {
+
+/// Flat execution schedule for a dynamic::Network.
+///
+/// Nodes are renumbered by topological level (the longest path from an
+/// input node) so every level is a contiguous range of one value array,
+/// input nodes making up level 0. Incoming edges are stored per node in
+/// CSR form, 32-bit source indices and weights packed in node order, so
+/// evaluating a level walks both arrays front to back and applies the
+/// activation to the whole level at once.
+///
+/// The schedule is a snapshot, it has to be rebuilt with fromNetwork after
+/// the network's structure or weights change.
+template <
+	class t_FloatType = ::FloatType,
+	template <class T> class t_ListInterface = ::ListInterface,
+	class t_Activation = SoftStep
+>
+class CompiledGraph
+{
+	public:
+		template <class T>
+		using ListInterface = t_ListInterface<T>;
+
+		using FloatType      = t_FloatType;
+		using IndexType      = std::uint32_t;
+		using ActivationType = t_Activation;
+
+		using FloatList  = ListInterface<FloatType>;
+		using IndexList  = ListInterface<IndexType>;
+		using OffsetList = ListInterface<std::size_t>;
+
+		using FloatPtr      = FloatType       *;
+		using ConstFloatPtr = FloatType const *;
+
+		CompiledGraph() : inputCount_ {0} {}
+
+		/// Orders the network's nodes and packs its edges. Edges into input
+		/// nodes are ignored, their values always come from the caller.
+		/// Throws std::invalid_argument if the hidden and output nodes form
+		/// a cycle or an edge leads out of the network.
+		template <class NetworkType>
+		static CompiledGraph fromNetwork(NetworkType const & network) {
+			using NodePtr = decltype(std::declval<typename NetworkType::PointerType>().node);
+
+			auto const & inputNodes  = network.getInputNodes();
+			auto const & hiddenNodes = network.getHiddenNodes();
+			auto const & outputNodes = network.getOutputNodes();
+
+			auto const inputCount = inputNodes.size();
+			auto const nodeCount  = network.getNodeCount();
+
+			if (nodeCount > std::numeric_limits<IndexType>::max())
+				throw std::invalid_argument("Too many nodes to compile");
+
+			// Original numbering: inputs, hidden nodes, then outputs.
+			ListInterface<NodePtr> nodes;
+			nodes.reserve(nodeCount);
+
+			for (auto const & list : {&inputNodes, &hiddenNodes, &outputNodes}) {
+				for (auto const & block : *list)
+					nodes.push_back(block.getPtr());
+			}
+
+			std::unordered_map<NodePtr, IndexType> originalIndices;
+			originalIndices.reserve(nodeCount);
+
+			for (std::size_t i {0}; i < nodeCount; ++i)
+				originalIndices[nodes[i]] = static_cast<IndexType>(i);
+
+			auto const getTarget = [&](NodePtr node) {
+				auto const found = originalIndices.find(node);
+
+				if (found == originalIndices.end())
+					throw std::invalid_argument("Connection to a node outside the network");
+
+				return found->second;
+			};
+
+			// Kahn's algorithm, tracking each node's longest path from level 0.
+			IndexList pendingInputs (nodeCount, 0);
+			IndexList levels        (nodeCount, 1);
+			std::size_t edgeCount {0};
+
+			for (std::size_t i {0}; i < nodeCount; ++i) {
+				for (auto const & connection : nodes[i]->getConnections()) {
+					auto const target = getTarget(connection.node);
+
+					if (target >= inputCount) {
+						++pendingInputs[target];
+						++edgeCount;
+					}
+				}
+			}
+
+			IndexList ready;
+			ready.reserve(nodeCount);
+
+			for (std::size_t i {0}; i < nodeCount; ++i) {
+				if (i < inputCount)
+					levels[i] = 0;
+
+				if (pendingInputs[i] == 0)
+					ready.push_back(static_cast<IndexType>(i));
+			}
+
+			for (std::size_t next {0}; next < ready.size(); ++next) {
+				auto const source = ready[next];
+
+				for (auto const & connection : nodes[source]->getConnections()) {
+					auto const target = getTarget(connection.node);
+
+					if (target < inputCount)
+						continue;
+
+					levels[target] = std::max(levels[target], levels[source] + 1);
+
+					if (--pendingInputs[target] == 0)
+						ready.push_back(target);
+				}
+			}
+
+			if (ready.size() != nodeCount)
+				throw std::invalid_argument("Dynamic network has a cycle");
+
+			CompiledGraph graph;
+			graph.inputCount_ = inputCount;
+
+			// Stable counting sort by level, inputs keep their order at the
+			// front.
+			IndexType levelCount {0};
+
+			for (auto level : levels)
+				levelCount = std::max(levelCount, level + 1);
+
+			graph.levelOffsets_.assign(levelCount + 1, 0);
+
+			for (auto level : levels)
+				++graph.levelOffsets_[level + 1];
+
+			for (std::size_t l {0}; l < levelCount; ++l)
+				graph.levelOffsets_[l + 1] += graph.levelOffsets_[l];
+
+			IndexList newIndices (nodeCount);
+			IndexList order      (nodeCount);
+			{
+				OffsetList positions (graph.levelOffsets_.begin(), graph.levelOffsets_.end() - 1);
+
+				for (std::size_t i {0}; i < nodeCount; ++i) {
+					auto const position = positions[levels[i]]++;
+					newIndices[i]   = static_cast<IndexType>(position);
+					order[position] = static_cast<IndexType>(i);
+				}
+			}
+
+			// Incoming edges per node. Sources are visited in schedule
+			// order so each row's sources come out ascending.
+			graph.edgeOffsets_.assign(nodeCount + 1, 0);
+
+			for (std::size_t i {0}; i < nodeCount; ++i) {
+				for (auto const & connection : nodes[i]->getConnections()) {
+					auto const target = getTarget(connection.node);
+
+					if (target >= inputCount)
+						++graph.edgeOffsets_[newIndices[target] + 1];
+				}
+			}
+
+			for (std::size_t n {0}; n < nodeCount; ++n)
+				graph.edgeOffsets_[n + 1] += graph.edgeOffsets_[n];
+
+			graph.sources_.resize(edgeCount);
+			graph.weights_.resize(edgeCount);
+			{
+				OffsetList positions (graph.edgeOffsets_.begin(), graph.edgeOffsets_.end() - 1);
+
+				for (std::size_t n {0}; n < nodeCount; ++n) {
+					for (auto const & connection : nodes[order[n]]->getConnections()) {
+						auto const target = getTarget(connection.node);
+
+						if (target < inputCount)
+							continue;
+
+						auto const position = positions[newIndices[target]]++;
+						graph.sources_[position] = static_cast<IndexType>(n);
+						graph.weights_[position] = connection.weight;
+					}
+				}
+			}
+
+			graph.outputIndices_.reserve(outputNodes.size());
+
+			for (std::size_t i {0}; i < outputNodes.size(); ++i)
+				graph.outputIndices_.push_back(newIndices[nodeCount - outputNodes.size() + i]);
+
+			graph.values_.assign(nodeCount, 0);
+
+			return graph;
+		}
+
+		std::size_t getNodeCount()   const { return values_.size(); }
+		std::size_t getEdgeCount()   const { return sources_.size(); }
+		std::size_t getInputCount()  const { return inputCount_; }
+		std::size_t getOutputCount() const { return outputIndices_.size(); }
+
+		/// Level 0 holds the input nodes.
+		std::size_t getLevelCount() const {
+			return levelOffsets_.empty() ? 0 : levelOffsets_.size() - 1;
+		}
+
+		/// Nodes [getLevelBegin(l), getLevelBegin(l + 1)) make up level l.
+		std::size_t getLevelBegin(std::size_t level) const {
+			return levelOffsets_[level];
+		}
+
+		/// Edges [getEdgeBegin(n), getEdgeBegin(n + 1)) lead into node n.
+		std::size_t getEdgeBegin(std::size_t node) const {
+			return edgeOffsets_[node];
+		}
+
+		IndexType getEdgeSource(std::size_t edge) const { return sources_[edge]; }
+		FloatType getEdgeWeight(std::size_t edge) const { return weights_[edge]; }
+
+		/// Schedule index of the i'th output node, in creation order.
+		IndexType getOutputIndex(std::size_t i) const { return outputIndices_[i]; }
+
+		/// Every node's value from the last execute, by schedule index.
+		FloatList const & getValues() const { return values_; }
+
+		FloatList execute(ConstFloatPtr inputs, ActivationType const & activation) {
+			FloatList outValues (getOutputCount());
+			execute(inputs, outValues.data(), activation);
+			return outValues;
+		}
+
+		/// @param inputs    getInputCount() values, in input node creation
+		///                  order.
+		/// @param outValues getOutputCount() values, in output node creation
+		///                  order.
+		void execute(ConstFloatPtr          inputs,
+		             FloatPtr               outValues,
+		             ActivationType const & activation) {
+			setInputs(inputs);
+
+			for (std::size_t l {1}; l < getLevelCount(); ++l)
+				executeLevel(l, activation);
+
+			getOutputs(outValues);
+		}
+
+		void setInputs(ConstFloatPtr inputs) {
+			std::copy(inputs, inputs + inputCount_, values_.begin());
+		}
+
+		void getOutputs(FloatPtr outValues) const {
+			for (std::size_t i {0}; i < getOutputCount(); ++i)
+				outValues[i] = values_[outputIndices_[i]];
+		}
+
+		/// Sums and activates every node of one level, the levels before it
+		/// must be up to date.
+		void executeLevel(std::size_t level, ActivationType const & activation) {
+			executeRange(levelOffsets_[level], levelOffsets_[level + 1], activation);
+		}
+
+		/// Sums and activates nodes [begin, end) of a single level.
+		void executeRange(std::size_t            begin,
+		                  std::size_t            end,
+		                  ActivationType const & activation) {
+			executeNodes(begin, end);
+			activation(values_.data() + begin, end - begin);
+		}
+
+		/// Weighted sums into nodes [begin, end), without activation. Only
+		/// writes those nodes' values, so disjoint ranges whose sources are
+		/// up to date can run concurrently.
+		void executeNodes(std::size_t begin, std::size_t end) {
+			FloatPtr            values  {values_.data()};
+			IndexType const   * sources {sources_.data()};
+			ConstFloatPtr       weights {weights_.data()};
+
+			for (std::size_t n {begin}; n < end; ++n) {
+				FloatType sum {0};
+
+				for (auto e = edgeOffsets_[n]; e < edgeOffsets_[n + 1]; ++e)
+					sum += weights[e] * values[sources[e]];
+
+				values[n] = sum;
+			}
+		}
+
+
+	private:
+		std::size_t inputCount_;
+
+		OffsetList levelOffsets_;
+		OffsetList edgeOffsets_;
+		IndexList  sources_;
+		FloatList  weights_;
+		IndexList  outputIndices_;
+
+		FloatList values_;
+};
+
+		}
+	}
+}
+
+#endif
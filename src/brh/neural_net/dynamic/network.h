@@ -1,17 +1,54 @@
 #ifndef NEURAL_NET_TESTING_SRC_DYNAMIC_NETWORK_H
 #define NEURAL_NET_TESTING_SRC_DYNAMIC_NETWORK_H
 
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
 #include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 
+#include "../arena_allocator.h"
+#include "compiled_graph.h"
 #include "node.h"
 
 namespace brh {
 	namespace neural {
 		namespace dynamic {
 
+/// Whether t_Allocator can drop everything it constructed at once.
+template <class t_Allocator, class = void>
+struct HasRelease : std::false_type {};
+
+template <class t_Allocator>
+struct HasRelease<t_Allocator,
+                  decltype(std::declval<t_Allocator &>().release(), void())> :
+	std::true_type {};
+
+
+/// What one event-driven evaluation did, see Network::executeEvents.
+struct EventStats
+{
+	/// Nodes that reached their threshold and fanned out.
+	std::size_t eventCount;
+
+	/// Edges followed by those events.
+	std::size_t deliveryCount;
+
+	std::size_t nodeCount;
+
+	double getActiveFraction() const {
+		return nodeCount == 0 ? 0 :
+			static_cast<double>(eventCount) / static_cast<double>(nodeCount);
+	}
+};
+
+
 template <
 	class t_NodeType,
-  class t_Allocator,
+  class t_Allocator = ArenaAllocator,
   std::size_t t_MAX_NEURON_COUNT = std::numeric_limits<std::size_t>::max(),
   template <class T> class t_ListInterface = ::ListInterface
 >
@@ -20,46 +57,362 @@ class Network
 	public:
 		using NodeType      = t_NodeType;
 		using Allocator     = t_Allocator;
-		using NodeBlock     = typename Allocator::BlockType<NodeType>;
+		using NodeBlock     = typename Allocator::template BlockType<NodeType>;
 		using NodeReference = NodeType &;
 
+		using EventState  = typename NodeType::EventState;
+		using PointerType = typename NodeType::PointerType;
+		using PointerList = typename NodeType::PointerList;
+		using FloatType   = typename NodeType::FloatType;
+
 		template <class T>
 		using ListInterface = t_ListInterface<T>;
 		using NodeList      = ListInterface<NodeBlock>;
 
+		using FloatPtr      = FloatType       *;
+		using ConstFloatPtr = FloatType const *;
+
+		static constexpr std::size_t MAX_NEURON_COUNT {t_MAX_NEURON_COUNT};
+
+		Network() :
+			eventEpoch_       {0},
+			eventLevelsValid_ {false} {}
+
 		template <class ... ArgPack>
-		Network(ArgPack ... allocatorArgs) :
-			allocator_ (std::forward(allocatorArgs)...) {}
+		explicit Network(ArgPack && ... allocatorArgs) :
+			allocator_        (std::forward<ArgPack>(allocatorArgs)...),
+			eventEpoch_       {0},
+			eventLevelsValid_ {false} {}
 
-		Network() {}
+		Network(Network const &) = delete;
+		Network & operator=(Network const &) = delete;
 
 		~Network() {
-			destructNodeList(inputNodes_);
-			destructNodeList(outputNodes_);
-			destructNodeList(hiddenNodes_);
+			destructNodes();
 		}
 
 
 		NodeReference createInputNode() {
-
+			return createNode(inputNodes_);
 		}
 
 		NodeReference createOutputNode() {
-
+			return createNode(outputNodes_);
 		}
 
 		NodeReference createHiddenNode() {
+			return createNode(hiddenNodes_);
+		}
+
+		/// Adds an edge carrying from's value, times weight, into to.
+		void connect(NodeReference from, NodeReference to, FloatType weight) {
+			from.getConnections().push_back({&to, weight});
+			invalidateEventLevels();
+		}
+
+		/// Has executeEvents renumber the nodes' levels before its next
+		/// run. Creating, connecting and clearing nodes through the network
+		/// does this already, editing a node's getConnections() directly
+		/// needs it.
+		void invalidateEventLevels() {
+			eventLevelsValid_ = false;
+		}
+
+		/// Drops every node, keeping the allocator's memory for the next
+		/// graph.
+		void clear() {
+			destructNodes();
+
+			inputNodes_.clear();
+			outputNodes_.clear();
+			hiddenNodes_.clear();
+
+			invalidateEventLevels();
+		}
+
+		/// Flat, index-based schedule of the graph as it is now, see
+		/// CompiledGraph. Has to be redone after the graph changes.
+		template <class t_Activation = SoftStep>
+		CompiledGraph<FloatType, t_ListInterface, t_Activation> compile() const {
+			return CompiledGraph<FloatType, t_ListInterface, t_Activation>::fromNetwork(*this);
+		}
+
+		/// Sparse evaluation driven by the nodes' thresholds.
+		///
+		/// Nodes are visited level by level, in the topological levels
+		/// CompiledGraph uses, so every contribution a node will get has
+		/// arrived by the time its level comes up. Input nodes whose value
+		/// reaches their threshold fire first, passing their value through
+		/// as it is. A node anything was delivered to is queued in its
+		/// level's bucket; when the level comes up it fires (is activated
+		/// and adds its value times the weight to every connection) if its
+		/// sum reached its threshold and stays silent otherwise. Nodes
+		/// nothing reaches are never visited: their values are cleared
+		/// lazily the next time an event touches them, so the cost follows
+		/// the activity rather than the graph size. With every threshold at
+		/// -infinity the outputs match CompiledGraph's.
+		///
+		/// The levels are computed on the first call after the graph
+		/// changed. Throws std::invalid_argument if the hidden and output
+		/// nodes form a cycle or an edge leads out of the network.
+		///
+		/// @param inputs    One value per input node, in creation order.
+		/// @param outValues One value per output node, in creation order. Zero
+		///                  for outputs that didn't fire.
+		EventStats executeEvents(ConstFloatPtr inputs, FloatPtr outValues) {
+			if (!eventLevelsValid_)
+				updateEventLevels();
+
+			beginEventEpoch();
+
+			EventStats stats {0, 0, getNodeCount()};
+
+			auto & inputBucket = eventBuckets_.front();
+
+			for (std::size_t i {0}; i < inputNodes_.size(); ++i) {
+				auto & node = *inputNodes_[i].getPtr();
+
+				touch(node);
+				node.setValue(inputs[i]);
+
+				if (node.checkReady()) {
+					node.setEventState(EventState::queued);
+					inputBucket.push_back(&node);
+				}
+				else {
+					node.setEventState(EventState::silent);
+				}
+			}
+
+			for (std::size_t level {0}; level < eventBuckets_.size(); ++level) {
+				auto & bucket = eventBuckets_[level];
+
+				// Connections only lead to higher levels, so the bucket
+				// doesn't grow while it's walked.
+				for (auto nodePtr : bucket) {
+					auto & node = *nodePtr;
+
+					if (level != 0) {
+						if (!node.checkReady()) {
+							node.setEventState(EventState::silent);
+							continue;
+						}
+
+						node.applyActivation();
+					}
+
+					node.setEventState(EventState::done);
+
+					auto const value = node.getValue();
+
+					for (auto const & connection : node.getConnections()) {
+						auto & target = static_cast<NodeReference>(*connection.node);
+
+						// Edges into input nodes are ignored.
+						if (target.getEventLevel() == 0)
+							continue;
+
+						touch(target);
+						target.addToValue(value * connection.weight);
+
+						if (target.getEventState() == EventState::idle) {
+							target.setEventState(EventState::queued);
+							eventBuckets_[target.getEventLevel()].push_back(&target);
+						}
+					}
+
+					++stats.eventCount;
+					stats.deliveryCount += node.getConnections().size();
+				}
+
+				bucket.clear();
+			}
+
+			for (std::size_t i {0}; i < outputNodes_.size(); ++i) {
+				auto const & node = *outputNodes_[i].getPtr();
+
+				bool const fired {
+					node.getEventEpoch() == eventEpoch_ &&
+					node.getEventState() == EventState::done
+				};
+
+				outValues[i] = fired ? node.getValue() : 0;
+			}
+
+			return stats;
+		}
 
+		std::size_t getNodeCount() const {
+			return inputNodes_.size() + outputNodes_.size() + hiddenNodes_.size();
 		}
 
+		NodeList const & getInputNodes()  const { return inputNodes_; }
+		NodeList const & getOutputNodes() const { return outputNodes_; }
+		NodeList const & getHiddenNodes() const { return hiddenNodes_; }
+
+		Allocator const & getAllocator() const { return allocator_; }
+		Allocator       & getAllocator()       { return allocator_; }
+
 
 	private:
+		/// Nodes can be dropped without running their destructors when
+		/// those don't release anything but allocator memory.
+		using CanReleaseAll = std::integral_constant<bool,
+			HasRelease<Allocator>::value &&
+			(std::is_trivially_destructible<NodeType>::value ||
+			 IsArenaList<PointerList>::value)
+		>;
+
+		NodeReference createNode(NodeList & list) {
+			assert(getNodeCount() < MAX_NEURON_COUNT);
+
+			invalidateEventLevels();
+
+			auto block = constructNode(IsArenaList<PointerList>());
+			list.push_back(block);
+
+			return *block.getPtr();
+		}
+
+		/// Connection lists come out of the same arena as the nodes.
+		NodeBlock constructNode(std::true_type) {
+			return allocator_.template construct<NodeType>(
+				PointerList(allocator_.template getStdAllocator<PointerType>())
+			);
+		}
+
+		NodeBlock constructNode(std::false_type) {
+			return allocator_.template construct<NodeType>();
+		}
+
+		/// Starts a new evaluation, wrapping around means every node has
+		/// to forget the epoch it last saw.
+		void beginEventEpoch() {
+			if (++eventEpoch_ == 0) {
+				for (auto const & list : {&inputNodes_, &outputNodes_, &hiddenNodes_}) {
+					for (auto const & block : *list)
+						block.getPtr()->setEventEpoch(0);
+				}
+
+				eventEpoch_ = 1;
+			}
+		}
+
+		/// Sets every node's event level, the longest path from an input
+		/// node as in CompiledGraph, by Kahn's algorithm, and sizes the
+		/// buckets executeEvents queues nodes in.
+		void updateEventLevels() {
+			// Incoming edges not yet ordered per hidden and output node,
+			// INPUT_NODE marks the input nodes.
+			constexpr std::size_t INPUT_NODE {std::numeric_limits<std::size_t>::max()};
+
+			std::unordered_map<NodeType const *, std::size_t> pendingInputs;
+			pendingInputs.reserve(getNodeCount());
+
+			ListInterface<NodeType *> ready;
+			ready.reserve(getNodeCount());
+
+			for (auto const & block : inputNodes_) {
+				block.getPtr()->setEventLevel(0);
+				pendingInputs[block.getPtr()] = INPUT_NODE;
+				ready.push_back(block.getPtr());
+			}
+
+			for (auto const & list : {&hiddenNodes_, &outputNodes_}) {
+				for (auto const & block : *list) {
+					block.getPtr()->setEventLevel(1);
+					pendingInputs[block.getPtr()] = 0;
+				}
+			}
+
+			auto const getPending = [&](NodeType const & node) -> std::size_t & {
+				auto const found = pendingInputs.find(&node);
+
+				if (found == pendingInputs.end())
+					throw std::invalid_argument("Connection to a node outside the network");
+
+				return found->second;
+			};
+
+			for (auto const & list : {&inputNodes_, &hiddenNodes_, &outputNodes_}) {
+				for (auto const & block : *list) {
+					for (auto const & connection : block.getPtr()->getConnections()) {
+						auto & pending = getPending(static_cast<NodeReference>(*connection.node));
+
+						if (pending != INPUT_NODE)
+							++pending;
+					}
+				}
+			}
+
+			for (auto const & list : {&hiddenNodes_, &outputNodes_}) {
+				for (auto const & block : *list) {
+					if (pendingInputs[block.getPtr()] == 0)
+						ready.push_back(block.getPtr());
+				}
+			}
+
+			std::uint32_t levelCount {1};
+
+			for (std::size_t next {0}; next < ready.size(); ++next) {
+				auto const & source = *ready[next];
+
+				for (auto const & connection : source.getConnections()) {
+					auto & target  = static_cast<NodeReference>(*connection.node);
+					auto & pending = getPending(target);
+
+					if (pending == INPUT_NODE)
+						continue;
+
+					target.setEventLevel(std::max(target.getEventLevel(), source.getEventLevel() + 1));
+
+					if (--pending == 0)
+						ready.push_back(&target);
+				}
+
+				levelCount = std::max(levelCount, source.getEventLevel() + 1);
+			}
+
+			if (ready.size() != getNodeCount())
+				throw std::invalid_argument("Dynamic network has a cycle");
+
+			eventBuckets_.resize(levelCount);
+
+			for (auto & bucket : eventBuckets_)
+				bucket.clear();
+
+			eventLevelsValid_ = true;
+		}
+
+		/// Clears what a node kept from an earlier evaluation.
+		void touch(NodeReference node) {
+			if (node.getEventEpoch() != eventEpoch_) {
+				node.setEventEpoch(eventEpoch_);
+				node.setEventState(EventState::idle);
+				node.clearValue();
+			}
+		}
+
+		void destructNodes() {
+			destructNodes(CanReleaseAll());
+		}
+
+		void destructNodes(std::true_type) {
+			allocator_.release();
+		}
+
+		void destructNodes(std::false_type) {
+			destructNodeList(inputNodes_);
+			destructNodeList(outputNodes_);
+			destructNodeList(hiddenNodes_);
+		}
+
 		static void pushUniqueToList(NodeBlock block, NodeList & list) {
 			auto const listSize = list.size();
 
 			bool found {false};
 			for (std::size_t i {0}; i < listSize; ++i) {
-				if (list[i] == block.getPtr())
+				if (list[i].getPtr() == block.getPtr())
 					found = true;
 			}
 
@@ -77,6 +430,12 @@ class Network
 		NodeList inputNodes_;
 		NodeList outputNodes_;
 		NodeList hiddenNodes_;
+
+		std::uint32_t eventEpoch_;
+
+		/// Nodes queued for executeEvents, one bucket per level.
+		ListInterface<ListInterface<NodeType *> > eventBuckets_;
+		bool                                      eventLevelsValid_;
 };
 
 		}
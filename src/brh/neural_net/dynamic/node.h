@@ -1,8 +1,12 @@
 #ifndef NEURAL_NET_TESTING_SRC_DYNAMIC_NODE_H
 #define NEURAL_NET_TESTING_SRC_DYNAMIC_NODE_H
 
+#include <cmath>
+#include <cstdint>
+
 #include <brh/brh_supports.h>
 
+#include "../arena_allocator.h"
 #include "../common.h"
 
 namespace brh {
@@ -29,9 +33,26 @@ class NodeBase
 		using PointerType   = PointerWeightPair;
 		using PointerList   = ListInterface<PointerType>;
 
+		/// Where the node stands in the current event-driven evaluation,
+		/// see Network::executeEvents.
+		enum class EventState : std::uint8_t
+		{
+			idle,
+			queued,
+			/// Fired, its value went out along its connections.
+			done,
+			/// Its level came up without its sum reaching the threshold.
+			silent
+		};
+
 		NodeBase() : NodeBase(PointerList()) {}
 		NodeBase(PointerList connections) :
-			connections_ (std::move(connections)), value_ {0} {
+			connections_ (std::move(connections)),
+			value_       {0},
+			threshold_   {0},
+			eventEpoch_  {0},
+			eventLevel_  {0},
+			eventState_  {EventState::idle} {
 			connections_.reserve(4);
 		}
 
@@ -42,10 +63,25 @@ class NodeBase
 		void addToValue(FloatType amount) { value_ += amount; }
 		void clearValue() { setValue(0); }
 
-		bool checkReady() {
-			return supports::marginCompare(value_, threshold_, threshold_ * 0.01);
+		FloatType getThreshold() const { return threshold_; }
+		void setThreshold(FloatType threshold) { threshold_ = threshold; }
+
+		/// Whether the value has reached the threshold, within 1%.
+		bool checkReady() const {
+			return value_ > threshold_ ||
+			       supports::marginCompare(value_, threshold_, std::abs(threshold_) / 100);
 		}
 
+		std::uint32_t getEventEpoch() const { return eventEpoch_; }
+		EventState    getEventState() const { return eventState_; }
+
+		void setEventEpoch(std::uint32_t epoch) { eventEpoch_ = epoch; }
+		void setEventState(EventState state)    { eventState_ = state; }
+
+		/// Longest path from an input node, kept up to date by the network.
+		std::uint32_t getEventLevel() const { return eventLevel_; }
+		void setEventLevel(std::uint32_t level) { eventLevel_ = level; }
+
 		PointerList const & getConnections() const { return connections_; }
 		PointerList       & getConnections()       { return connections_; }
 
@@ -54,15 +90,25 @@ class NodeBase
 		PointerList connections_;
 		FloatType   value_;
 		FloatType   threshold_;
+
+		std::uint32_t eventEpoch_;
+		std::uint32_t eventLevel_;
+		EventState    eventState_;
 };
 
 
+/// NodeBase whose connection lists come out of the arena of the Network
+/// holding the node, so the network drops a whole graph with one arena
+/// reset. Outside an arena the lists fall back to operator new.
+using ArenaNodeBase = NodeBase<ArenaList>;
+
+
 template <
 	class t_ActivationFunc,
 	class t_ActivationDerivativeFunc,
 	t_ActivationFunc           ACTIVATION_FUNC,
 	t_ActivationDerivativeFunc ACTIVATION_DERIVATIVE_FUNC,
-  class t_NodeBase = NodeBase<>>
+  class t_NodeBase = ArenaNodeBase>
 class BasicNode : public t_NodeBase
 {
 	public:
@@ -0,0 +1,357 @@
+#ifndef NEURAL_NET_TESTING_SRC_DYNAMIC_PARALLEL_EXECUTOR_H
+#define NEURAL_NET_TESTING_SRC_DYNAMIC_PARALLEL_EXECUTOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <thread>
+
+#include "../common.h"
+#include "../thread_pool.h"
+
+namespace brh {
+	namespace neural {
+		namespace dynamic {
+
+/// Runs a CompiledGraph on a ThreadPool without level barriers.
+///
+/// Each level of the schedule is cut into batches of consecutive nodes
+/// holding about BATCH_COST edges and nodes, so cheap nodes don't cost a
+/// task each. Every batch has an atomic count of the batches it reads
+/// from; finishing a batch decrements its successors' counts and a batch
+/// becomes ready when its count reaches zero. Ready batches go onto the
+/// finishing worker's own deque, workers take their newest batch first and
+/// steal the oldest of another worker's once theirs runs dry.
+/// See buildDependencies for batches that read from a whole level.
+///
+/// The executor refers to the graph's structure, it has to be rebuilt along
+/// with the graph.
+template <class t_Graph>
+class ParallelExecutor
+{
+	public:
+		using GraphType      = t_Graph;
+		using FloatType      = typename GraphType::FloatType;
+		using IndexType      = typename GraphType::IndexType;
+		using ActivationType = typename GraphType::ActivationType;
+
+		template <class T>
+		using ListInterface = typename GraphType::template ListInterface<T>;
+
+		using FloatList  = typename GraphType::FloatList;
+		using IndexList  = typename GraphType::IndexList;
+		using OffsetList = typename GraphType::OffsetList;
+
+		using FloatPtr      = FloatType       *;
+		using ConstFloatPtr = FloatType const *;
+
+		/// Edges plus nodes summed per batch, before the level runs out.
+		static constexpr std::size_t BATCH_COST {2048};
+
+		/// Most batches of one level a batch links to individually.
+		static constexpr std::size_t LEVEL_LINK_LIMIT {8};
+
+		ParallelExecutor(GraphType  & graph,
+		                 ThreadPool & pool,
+		                 std::size_t  batchCost = BATCH_COST) :
+			graph_     (graph),
+			pool_      (pool),
+			remaining_ {0} {
+			buildBatches(std::max<std::size_t>(batchCost, 1));
+			buildDependencies();
+
+			queues_.reset(new WorkerQueue[getThreadCount()]);
+
+			for (std::size_t i {0}; i < getThreadCount(); ++i)
+				queues_[i].tasks.resize(getBatchCount());
+		}
+
+		std::size_t getThreadCount() const { return pool_.getThreadCount(); }
+		std::size_t getBatchCount()  const { return batchBegins_.size() - 1; }
+
+		FloatList execute(ConstFloatPtr inputs, ActivationType const & activation) {
+			FloatList outValues (graph_.getOutputCount());
+			execute(inputs, outValues.data(), activation);
+			return outValues;
+		}
+
+		/// Same results as GraphType::execute.
+		void execute(ConstFloatPtr          inputs,
+		             FloatPtr               outValues,
+		             ActivationType const & activation) {
+			graph_.setInputs(inputs);
+
+			auto const threadCount = getThreadCount();
+
+			for (std::size_t i {0}; i < threadCount; ++i)
+				queues_[i].top = queues_[i].bottom = 0;
+
+			// Batches that only read inputs are dealt out round robin.
+			std::size_t seeded {0};
+
+			for (std::size_t t {0}; t < initialPending_.size(); ++t)
+				pending_[t].store(initialPending_[t], std::memory_order_relaxed);
+
+			for (std::size_t b {0}; b < getBatchCount(); ++b) {
+				if (initialPending_[b] == 0) {
+					auto & queue = queues_[seeded++ % threadCount];
+					queue.tasks[queue.bottom++] = static_cast<IndexType>(b);
+				}
+			}
+
+			remaining_.store(getBatchCount(), std::memory_order_release);
+
+			pool_.run(threadCount, [&](std::size_t worker) {
+				work(worker, activation);
+			});
+
+			graph_.getOutputs(outValues);
+		}
+
+
+	private:
+		/// Fixed array deque guarded by a spinlock. Every batch is pushed
+		/// once per execute, so getBatchCount() slots never run out and the
+		/// indices never wrap.
+		struct WorkerQueue
+		{
+			WorkerQueue() : locked {false}, top {0}, bottom {0} {}
+
+			void lock() {
+				while (locked.exchange(true, std::memory_order_acquire))
+					std::this_thread::yield();
+			}
+
+			void unlock() {
+				locked.store(false, std::memory_order_release);
+			}
+
+			std::atomic<bool> locked;
+
+			IndexList   tasks;
+			std::size_t top;
+			std::size_t bottom;
+
+			// Keeps neighbouring queues' locks off this cache line.
+			char padding[64];
+		};
+
+		bool pop(std::size_t worker, IndexType & batch) {
+			auto & queue = queues_[worker];
+			bool found {false};
+
+			queue.lock();
+
+			if (queue.bottom > queue.top) {
+				batch = queue.tasks[--queue.bottom];
+				found = true;
+			}
+
+			queue.unlock();
+
+			return found;
+		}
+
+		bool steal(std::size_t worker, IndexType & batch) {
+			auto const threadCount = getThreadCount();
+
+			for (std::size_t i {1}; i < threadCount; ++i) {
+				auto & queue = queues_[(worker + i) % threadCount];
+
+				bool found {false};
+
+				queue.lock();
+
+				if (queue.bottom > queue.top) {
+					batch = queue.tasks[queue.top++];
+					found = true;
+				}
+
+				queue.unlock();
+
+				if (found)
+					return true;
+			}
+
+			return false;
+		}
+
+		void push(std::size_t worker, IndexType batch) {
+			auto & queue = queues_[worker];
+
+			queue.lock();
+			queue.tasks[queue.bottom++] = batch;
+			queue.unlock();
+		}
+
+		void work(std::size_t worker, ActivationType const & activation) {
+			IndexType batch;
+
+			while (remaining_.load(std::memory_order_acquire) != 0) {
+				if (!pop(worker, batch) && !steal(worker, batch)) {
+					std::this_thread::yield();
+					continue;
+				}
+
+				graph_.executeRange(batchBegins_[batch], batchBegins_[batch + 1], activation);
+				finish(worker, batch);
+
+				remaining_.fetch_sub(1, std::memory_order_acq_rel);
+			}
+		}
+
+		/// Releases a finished task's successors. Level markers have no work
+		/// of their own and finish as soon as they're ready.
+		void finish(std::size_t worker, IndexType task) {
+			for (auto s = successorOffsets_[task]; s < successorOffsets_[task + 1]; ++s) {
+				auto const successor = successors_[s];
+
+				if (pending_[successor].fetch_sub(1, std::memory_order_acq_rel) != 1)
+					continue;
+
+				if (successor >= getBatchCount())
+					finish(worker, successor);
+				else
+					push(worker, successor);
+			}
+		}
+
+		/// Cuts each level after level 0 into batches.
+		void buildBatches(std::size_t batchCost) {
+			batchBegins_.clear();
+			batchLevels_.clear();
+			nodeBatches_.assign(graph_.getNodeCount(), NO_BATCH);
+
+			for (std::size_t l {1}; l < graph_.getLevelCount(); ++l) {
+				auto const end = graph_.getLevelBegin(l + 1);
+				std::size_t cost {batchCost};
+
+				for (auto n = graph_.getLevelBegin(l); n < end; ++n) {
+					if (cost >= batchCost) {
+						batchBegins_.push_back(n);
+						batchLevels_.push_back(static_cast<IndexType>(l));
+						cost = 0;
+					}
+
+					nodeBatches_[n] = static_cast<IndexType>(batchBegins_.size() - 1);
+					cost += 1 + graph_.getEdgeBegin(n + 1) - graph_.getEdgeBegin(n);
+				}
+			}
+
+			batchBegins_.push_back(graph_.getNodeCount());
+		}
+
+		/// Distinct batch to batch edges, as successor lists and
+		/// predecessor counts. A batch reading from more than
+		/// LEVEL_LINK_LIMIT batches of one level waits on that level's
+		/// marker task instead, which completes with the level's last batch.
+		/// Otherwise graphs whose edges reach all over the earlier levels
+		/// would need about one atomic decrement per edge.
+		void buildDependencies() {
+			auto const batchCount = getBatchCount();
+			auto const taskCount  = batchCount + graph_.getLevelCount();
+
+			initialPending_.assign(taskCount, 0);
+			pending_.reset(new std::atomic<IndexType>[taskCount]);
+
+			// (predecessor, successor) task pairs.
+			ListInterface<std::pair<IndexType, IndexType> > links;
+			ListInterface<bool> levelsWaitedOn (graph_.getLevelCount(), false);
+			IndexList predecessors;
+
+			for (std::size_t b {0}; b < batchCount; ++b) {
+				predecessors.clear();
+
+				for (auto n = batchBegins_[b]; n < batchBegins_[b + 1]; ++n) {
+					for (auto e = graph_.getEdgeBegin(n); e < graph_.getEdgeBegin(n + 1); ++e) {
+						auto const source = nodeBatches_[graph_.getEdgeSource(e)];
+
+						if (source != NO_BATCH)
+							predecessors.push_back(source);
+					}
+				}
+
+				std::sort(predecessors.begin(), predecessors.end());
+				predecessors.erase(
+					std::unique(predecessors.begin(), predecessors.end()), predecessors.end()
+				);
+
+				// Batches are numbered level by level, so each level's
+				// predecessors form one run.
+				for (std::size_t i {0}; i < predecessors.size();) {
+					auto const level = batchLevels_[predecessors[i]];
+					auto runEnd = i;
+
+					while (runEnd < predecessors.size() && batchLevels_[predecessors[runEnd]] == level)
+						++runEnd;
+
+					if (runEnd - i > LEVEL_LINK_LIMIT) {
+						levelsWaitedOn[level] = true;
+						links.emplace_back(getLevelTask(level), static_cast<IndexType>(b));
+					}
+					else {
+						for (; i < runEnd; ++i)
+							links.emplace_back(predecessors[i], static_cast<IndexType>(b));
+					}
+
+					i = runEnd;
+				}
+			}
+
+			for (std::size_t b {0}; b < batchCount; ++b) {
+				if (levelsWaitedOn[batchLevels_[b]])
+					links.emplace_back(static_cast<IndexType>(b), getLevelTask(batchLevels_[b]));
+			}
+
+			successorOffsets_.assign(taskCount + 1, 0);
+
+			for (auto const & link : links) {
+				++successorOffsets_[link.first + 1];
+				++initialPending_[link.second];
+			}
+
+			for (std::size_t t {0}; t < taskCount; ++t)
+				successorOffsets_[t + 1] += successorOffsets_[t];
+
+			successors_.resize(links.size());
+
+			OffsetList positions (successorOffsets_.begin(), successorOffsets_.end() - 1);
+
+			for (auto const & link : links)
+				successors_[positions[link.first]++] = link.second;
+		}
+
+		IndexType getLevelTask(std::size_t level) const {
+			return static_cast<IndexType>(getBatchCount() + level);
+		}
+
+		static constexpr IndexType NO_BATCH {std::numeric_limits<IndexType>::max()};
+
+		GraphType  & graph_;
+		ThreadPool & pool_;
+
+		/// Batch b is nodes [batchBegins_[b], batchBegins_[b + 1]).
+		OffsetList batchBegins_;
+		IndexList  batchLevels_;
+		IndexList  nodeBatches_;
+
+		/// Successors of batches, then of one marker task per level.
+
+		OffsetList successorOffsets_;
+		IndexList  successors_;
+		IndexList  initialPending_;
+
+		std::unique_ptr<std::atomic<IndexType>[]> pending_;
+		std::unique_ptr<WorkerQueue[]>             queues_;
+		std::atomic<std::size_t>                   remaining_;
+};
+
+template <class t_Graph>
+constexpr typename ParallelExecutor<t_Graph>::IndexType ParallelExecutor<t_Graph>::NO_BATCH;
+
+		}
+	}
+}
+
+#endif
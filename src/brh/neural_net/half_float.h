@@ -0,0 +1,114 @@
+#ifndef NEURAL_NET_TESTING_HALF_FLOAT_H
+#define NEURAL_NET_TESTING_HALF_FLOAT_H
+
+#include <cstdint>
+#include <cstring>
+
+namespace brh {
+	namespace neural {
+
+inline std::uint32_t floatToBits(float value) {
+	std::uint32_t bits;
+	std::memcpy(&bits, &value, sizeof bits);
+	return bits;
+}
+
+inline float bitsToFloat(std::uint32_t bits) {
+	float value;
+	std::memcpy(&value, &bits, sizeof value);
+	return value;
+}
+
+
+/// IEEE 754 binary16 storage type, 11 bits of precision over +-65504.
+/// Only meant for storing values, arithmetic goes through float.
+struct Float16
+{
+	std::uint16_t bits;
+
+	Float16() = default;
+
+	/// Rounds to nearest even, out of range values become infinity.
+	Float16(float value) : bits {fromFloat(value)} {}
+
+	operator float() const { return toFloat(bits); }
+
+	static float toFloat(std::uint16_t half) {
+		std::uint32_t const sign     {static_cast<std::uint32_t>(half & 0x8000) << 16};
+		std::uint32_t const exponent {(half >> 10) & 0x1fu};
+		std::uint32_t const mantissa {half & 0x3ffu};
+
+		if (exponent == 0x1f)
+			return bitsToFloat(sign | 0x7f800000 | (mantissa << 13));
+
+		if (exponent == 0) {
+			// Zero or subnormal, mantissa * 2^-24.
+			float const magnitude {static_cast<float>(mantissa) * (1.0f / 16777216.0f)};
+			return bitsToFloat(sign | floatToBits(magnitude));
+		}
+
+		return bitsToFloat(sign | ((exponent + 112) << 23) | (mantissa << 13));
+	}
+
+	static std::uint16_t fromFloat(float value) {
+		std::uint32_t const bits {floatToBits(value)};
+		std::uint16_t const sign {static_cast<std::uint16_t>((bits >> 16) & 0x8000)};
+		std::uint32_t const magnitude {bits & 0x7fffffff};
+
+		if (magnitude >= 0x7f800000) {
+			// Infinity stays infinity, NaN keeps a quiet mantissa bit.
+			return sign | 0x7c00 | (magnitude > 0x7f800000 ? 0x200 : 0);
+		}
+
+		if (magnitude >= 0x477ff000)
+			return sign | 0x7c00;
+
+		if (magnitude < 0x38800000) {
+			// Subnormal result, let float addition do the rounding: adding
+			// 0.5 pushes the value's top bits into the low mantissa bits.
+			float const shifted {bitsToFloat(magnitude) + 0.5f};
+			return sign | static_cast<std::uint16_t>(floatToBits(shifted) - 0x3f000000);
+		}
+
+		std::uint32_t const oddBit {(magnitude >> 13) & 1};
+		std::uint32_t const rounded {magnitude - (112u << 23) + 0xfff + oddBit};
+
+		return sign | static_cast<std::uint16_t>(rounded >> 13);
+	}
+};
+
+
+/// bfloat16 storage type, float's exponent range with 8 bits of
+/// precision. Converting to float is a shift, so it's the cheaper of the
+/// two to unpack.
+struct BFloat16
+{
+	std::uint16_t bits;
+
+	BFloat16() = default;
+
+	/// Rounds to nearest even.
+	BFloat16(float value) : bits {fromFloat(value)} {}
+
+	operator float() const { return toFloat(bits); }
+
+	static float toFloat(std::uint16_t half) {
+		return bitsToFloat(static_cast<std::uint32_t>(half) << 16);
+	}
+
+	static std::uint16_t fromFloat(float value) {
+		std::uint32_t const bits {floatToBits(value)};
+
+		if ((bits & 0x7fffffff) > 0x7f800000)
+			return static_cast<std::uint16_t>((bits >> 16) | 0x40);
+
+		std::uint32_t const oddBit {(bits >> 16) & 1};
+
+		return static_cast<std::uint16_t>((bits + 0x7fff + oddBit) >> 16);
+	}
+};
+
+	}
+}
+
+#endif
@@ -0,0 +1,129 @@
+#include "image_batch.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace brh {
+	namespace neural {
+
+namespace {
+
+bool isDirectory(std::string const & path)
+{
+	struct stat status;
+	return ::stat(path.c_str(), &status) == 0 && S_ISDIR(status.st_mode);
+}
+
+bool isRegularFile(std::string const & path)
+{
+	struct stat status;
+	return ::stat(path.c_str(), &status) == 0 && S_ISREG(status.st_mode);
+}
+
+void appendDirectory(std::string const & directory, PathList & files)
+{
+	DIR * handle {::opendir(directory.c_str())};
+
+	if (handle == nullptr)
+		throw std::runtime_error("Unable to open directory " + directory);
+
+	PathList entries;
+
+	while (dirent * entry = ::readdir(handle)) {
+		auto path = directory + '/' + entry->d_name;
+
+		if (isRegularFile(path))
+			entries.push_back(std::move(path));
+	}
+
+	::closedir(handle);
+
+	std::sort(entries.begin(), entries.end());
+	files.insert(files.end(), entries.begin(), entries.end());
+}
+
+/// Reads up to size bytes, returning how many were read.
+std::size_t readFile(std::string const & path, unsigned char * buffer, std::size_t size)
+{
+	int descriptor {::open(path.c_str(), O_RDONLY)};
+
+	if (descriptor < 0)
+		throw std::runtime_error("Unable to open " + path);
+
+	std::size_t total {0};
+
+	while (total < size) {
+		auto count = ::read(descriptor, buffer + total, size - total);
+
+		if (count < 0) {
+			::close(descriptor);
+			throw std::runtime_error("Unable to read " + path);
+		}
+
+		if (count == 0)
+			break;
+
+		total += static_cast<std::size_t>(count);
+	}
+
+	::close(descriptor);
+
+	return total;
+}
+
+}
+
+
+PathList listImageFiles(PathList const & paths)
+{
+	PathList files;
+
+	for (auto const & i : paths) {
+		if (isDirectory(i))
+			appendDirectory(i, files);
+		else
+			files.push_back(i);
+	}
+
+	return files;
+}
+
+
+
+ImageBatch::ImageBatch(std::size_t capacity, std::size_t imageSize) :
+	capacity_  {capacity},
+	imageSize_ {imageSize},
+	count_     {0},
+	bytes_     (capacity * imageSize),
+	values_    (capacity * imageSize) {}
+
+
+void ImageBatch::load(PathList const & files, std::size_t first)
+{
+	count_ = std::min(capacity_, files.size() - std::min(first, files.size()));
+
+	for (std::size_t i {0}; i < count_; ++i) {
+		auto image = bytes_.data() + i * imageSize_;
+		auto read = readFile(files[first + i], image, imageSize_);
+
+		std::fill(image + read, image + imageSize_, 0);
+	}
+
+	auto const byteCount = count_ * imageSize_;
+
+	for (std::size_t i {0}; i < byteCount; ++i)
+		values_[i] = static_cast<FloatType>(bytes_[i]) / 256;
+}
+
+std::size_t ImageBatch::getCount()     const { return count_; }
+std::size_t ImageBatch::getImageSize() const { return imageSize_; }
+
+FloatType const * ImageBatch::getValues() const { return values_.data(); }
+
+	}
+}
@@ -0,0 +1,137 @@
+#ifndef NEURAL_NET_TESTING_IMAGE_BATCH_H
+#define NEURAL_NET_TESTING_IMAGE_BATCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "common.h"
+
+namespace brh {
+	namespace neural {
+
+using PathList = std::vector<std::string>;
+
+/// Expands every directory in paths to the regular files inside it, sorted
+/// by name. Other paths are kept as given.
+PathList listImageFiles(PathList const & paths);
+
+
+/// One batch of raw frames. Files are read whole with read(2) into a byte
+/// buffer sized once for the batch, then converted to input values.
+class ImageBatch
+{
+	public:
+		/// @param capacity  Images per batch.
+		/// @param imageSize Bytes (and input values) per image, shorter files
+		///                  are zero-padded and longer ones cut off.
+		ImageBatch(std::size_t capacity, std::size_t imageSize);
+
+		/// Loads files [first, first + capacity) of files, or fewer at the end.
+		void load(PathList const & files, std::size_t first);
+
+		std::size_t getCount()     const;
+		std::size_t getImageSize() const;
+
+		/// getCount() rows of getImageSize() values, each byte / 256.
+		FloatType const * getValues() const;
+
+
+	private:
+		std::size_t capacity_;
+		std::size_t imageSize_;
+		std::size_t count_;
+
+		std::vector<unsigned char> bytes_;
+		ListType                   values_;
+};
+
+
+struct BatchStats
+{
+	std::size_t imageCount;
+	double      seconds;
+
+	double getImagesPerSecond() const {
+		return seconds > 0 ? imageCount / seconds : 0;
+	}
+};
+
+
+/// Pushes every file through network batchSize images at a time.
+/// The next batch is loaded on another thread while the current one
+/// executes, and each batch's outputs (one byte per output node, value
+/// * 256) are appended to outputPath with a single write.
+template <class NetworkType>
+BatchStats processImageBatches(NetworkType       & network,
+                               PathList    const & files,
+                               std::size_t         batchSize,
+                               std::string const & outputPath) {
+	auto const start = std::chrono::steady_clock::now();
+
+	auto const imageSize   = network.getInputNodeCount();
+	auto const outputCount = network.getOutputNodeCount();
+
+	std::ofstream outFile (outputPath, std::ios::binary | std::ios::trunc);
+
+	if (!outFile)
+		throw std::runtime_error("Unable to create " + outputPath);
+
+	ImageBatch batches[2] {{batchSize, imageSize}, {batchSize, imageSize}};
+	std::vector<char> outBytes (batchSize * outputCount);
+
+	if (!files.empty())
+		batches[0].load(files, 0);
+
+	std::size_t current {0};
+
+	for (std::size_t first {0}; first < files.size(); first += batchSize) {
+		auto & batch = batches[current];
+		auto & next  = batches[1 - current];
+
+		std::future<void> loading;
+		auto const nextFirst = first + batchSize;
+
+		if (nextFirst < files.size()) {
+			loading = std::async(std::launch::async, [&, nextFirst] {
+				next.load(files, nextFirst);
+			});
+		}
+
+		auto const outputs = network.executeBatch(batch.getValues(), batch.getCount());
+		auto const valueCount = batch.getCount() * outputCount;
+
+		for (std::size_t i {0}; i < valueCount; ++i) {
+			auto const scaled = std::round(outputs[i] * 256);
+			outBytes[i] = static_cast<char>(
+				static_cast<unsigned char>(std::min<FloatType>(std::max<FloatType>(scaled, 0), 255))
+			);
+		}
+
+		outFile.write(outBytes.data(), static_cast<std::streamsize>(valueCount));
+
+		if (loading.valid())
+			loading.get();
+
+		current = 1 - current;
+	}
+
+	if (!outFile)
+		throw std::runtime_error("Unable to write " + outputPath);
+
+	std::chrono::duration<double> const elapsed {
+		std::chrono::steady_clock::now() - start
+	};
+
+	return {files.size(), elapsed.count()};
+}
+
+	}
+}
+
+#endif
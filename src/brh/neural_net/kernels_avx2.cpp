@@ -0,0 +1,136 @@
+// AVX2 + FMA kernels, built with -mavx2 -mfma -ffp-contract=off.
+//
+// Only the constants of activation_kernels.h are used here, see
+// kernels_sse42.cpp. Fused multiply-adds are written out where wanted, the
+// exp polynomial keeps separate multiplies and adds to match the scalar
+// kernels bit for bit.
+
+#include "cpu_dispatch.h"
+#include "activation_kernels.h"
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+namespace brh {
+	namespace neural {
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+namespace {
+
+using namespace activation::detail;
+
+constexpr std::size_t WIDTH {8};
+
+/// Lanes [0, count) set, for the masked loads and stores of a tail.
+__m256i getTailMask(std::size_t count) {
+	__m256i const lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	return _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(count)), lanes);
+}
+
+float horizontalSum(__m256 sums) {
+	__m128 const half = _mm_add_ps(_mm256_castps256_ps128(sums),
+	                               _mm256_extractf128_ps(sums, 1));
+	float lanes[4];
+	_mm_storeu_ps(lanes, half);
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+float dotAvx2(float const * a, float const * b, std::size_t count) {
+	__m256 sum0 = _mm256_setzero_ps();
+	__m256 sum1 = _mm256_setzero_ps();
+
+	std::size_t i {0};
+
+	for (; i + 2 * WIDTH <= count; i += 2 * WIDTH) {
+		sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i),         _mm256_loadu_ps(b + i),         sum0);
+		sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + WIDTH), _mm256_loadu_ps(b + i + WIDTH), sum1);
+	}
+
+	for (; i < count; i += WIDTH) {
+		__m256i const mask = getTailMask(count - i);
+		sum0 = _mm256_fmadd_ps(_mm256_maskload_ps(a + i, mask),
+		                       _mm256_maskload_ps(b + i, mask), sum0);
+	}
+
+	return horizontalSum(_mm256_add_ps(sum0, sum1));
+}
+
+void axpyAvx2(float a, float const * x, float * y, std::size_t count) {
+	__m256 const scale = _mm256_set1_ps(a);
+
+	std::size_t i {0};
+
+	for (; i + WIDTH <= count; i += WIDTH) {
+		_mm256_storeu_ps(y + i, _mm256_fmadd_ps(scale, _mm256_loadu_ps(x + i),
+		                                        _mm256_loadu_ps(y + i)));
+	}
+
+	if (i < count) {
+		__m256i const mask = getTailMask(count - i);
+		_mm256_maskstore_ps(y + i, mask, _mm256_fmadd_ps(
+			scale, _mm256_maskload_ps(x + i, mask), _mm256_maskload_ps(y + i, mask)
+		));
+	}
+}
+
+__m256 sigmoidVector(__m256 x) {
+	// sigmoid(x) = 1 / (1 + exp(-x)), exp as in expPolynomial.
+	x = _mm256_sub_ps(_mm256_setzero_ps(), x);
+	x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(EXP_MIN)), _mm256_set1_ps(EXP_MAX));
+
+	__m256 const n = _mm256_floor_ps(
+		_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(LOG2E)), _mm256_set1_ps(0.5f))
+	);
+
+	x = _mm256_sub_ps(x, _mm256_mul_ps(n, _mm256_set1_ps(LN2_HIGH)));
+	x = _mm256_sub_ps(x, _mm256_mul_ps(n, _mm256_set1_ps(LN2_LOW)));
+
+	__m256 const z = _mm256_mul_ps(x, x);
+	__m256 y = _mm256_set1_ps(EXP_P0);
+	y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(EXP_P1));
+	y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(EXP_P2));
+	y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(EXP_P3));
+	y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(EXP_P4));
+	y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(EXP_P5));
+	y = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(y, z), x), _mm256_set1_ps(1.0f));
+
+	__m256i const bits = _mm256_slli_epi32(
+		_mm256_add_epi32(_mm256_cvttps_epi32(n), _mm256_set1_epi32(127)), 23
+	);
+
+	__m256 const one = _mm256_set1_ps(1.0f);
+	return _mm256_div_ps(one, _mm256_add_ps(one, _mm256_mul_ps(y, _mm256_castsi256_ps(bits))));
+}
+
+void sigmoidAvx2(float * values, std::size_t count) {
+	std::size_t i {0};
+
+	for (; i + WIDTH <= count; i += WIDTH)
+		_mm256_storeu_ps(values + i, sigmoidVector(_mm256_loadu_ps(values + i)));
+
+	if (i < count) {
+		__m256i const mask = getTailMask(count - i);
+		_mm256_maskstore_ps(values + i, mask,
+		                    sigmoidVector(_mm256_maskload_ps(values + i, mask)));
+	}
+}
+
+}
+
+bool detail::getAvx2Kernels(KernelTable & table) {
+	table = {Isa::avx2, dotAvx2, axpyAvx2, sigmoidAvx2};
+	return true;
+}
+
+#else
+
+bool detail::getAvx2Kernels(KernelTable &) {
+	return false;
+}
+
+#endif
+
+	}
+}
@@ -0,0 +1,125 @@
+// AVX-512F kernels, built with -mavx512f -mfma -ffp-contract=off.
+//
+// Only the constants of activation_kernels.h are used here, see
+// kernels_sse42.cpp. Tails use masked loads and stores.
+
+#include "cpu_dispatch.h"
+#include "activation_kernels.h"
+
+#ifdef __AVX512F__
+#include <immintrin.h>
+#endif
+
+namespace brh {
+	namespace neural {
+
+#ifdef __AVX512F__
+
+namespace {
+
+using namespace activation::detail;
+
+constexpr std::size_t WIDTH {16};
+
+__mmask16 getTailMask(std::size_t count) {
+	return static_cast<__mmask16>((1u << count) - 1);
+}
+
+float dotAvx512(float const * a, float const * b, std::size_t count) {
+	__m512 sum0 = _mm512_setzero_ps();
+	__m512 sum1 = _mm512_setzero_ps();
+
+	std::size_t i {0};
+
+	for (; i + 2 * WIDTH <= count; i += 2 * WIDTH) {
+		sum0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i),         _mm512_loadu_ps(b + i),         sum0);
+		sum1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + WIDTH), _mm512_loadu_ps(b + i + WIDTH), sum1);
+	}
+
+	for (; i < count; i += WIDTH) {
+		__mmask16 const mask = count - i < WIDTH ? getTailMask(count - i) : 0xffff;
+		sum0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i),
+		                       _mm512_maskz_loadu_ps(mask, b + i), sum0);
+	}
+
+	return _mm512_reduce_add_ps(_mm512_add_ps(sum0, sum1));
+}
+
+void axpyAvx512(float a, float const * x, float * y, std::size_t count) {
+	__m512 const scale = _mm512_set1_ps(a);
+
+	std::size_t i {0};
+
+	for (; i + WIDTH <= count; i += WIDTH) {
+		_mm512_storeu_ps(y + i, _mm512_fmadd_ps(scale, _mm512_loadu_ps(x + i),
+		                                        _mm512_loadu_ps(y + i)));
+	}
+
+	if (i < count) {
+		__mmask16 const mask = getTailMask(count - i);
+		_mm512_mask_storeu_ps(y + i, mask, _mm512_fmadd_ps(
+			scale, _mm512_maskz_loadu_ps(mask, x + i), _mm512_maskz_loadu_ps(mask, y + i)
+		));
+	}
+}
+
+__m512 sigmoidVector(__m512 x) {
+	// sigmoid(x) = 1 / (1 + exp(-x)), exp as in expPolynomial.
+	x = _mm512_sub_ps(_mm512_setzero_ps(), x);
+	x = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(EXP_MIN)), _mm512_set1_ps(EXP_MAX));
+
+	__m512 const n = _mm512_roundscale_ps(
+		_mm512_add_ps(_mm512_mul_ps(x, _mm512_set1_ps(LOG2E)), _mm512_set1_ps(0.5f)),
+		_MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC
+	);
+
+	x = _mm512_sub_ps(x, _mm512_mul_ps(n, _mm512_set1_ps(LN2_HIGH)));
+	x = _mm512_sub_ps(x, _mm512_mul_ps(n, _mm512_set1_ps(LN2_LOW)));
+
+	__m512 const z = _mm512_mul_ps(x, x);
+	__m512 y = _mm512_set1_ps(EXP_P0);
+	y = _mm512_add_ps(_mm512_mul_ps(y, x), _mm512_set1_ps(EXP_P1));
+	y = _mm512_add_ps(_mm512_mul_ps(y, x), _mm512_set1_ps(EXP_P2));
+	y = _mm512_add_ps(_mm512_mul_ps(y, x), _mm512_set1_ps(EXP_P3));
+	y = _mm512_add_ps(_mm512_mul_ps(y, x), _mm512_set1_ps(EXP_P4));
+	y = _mm512_add_ps(_mm512_mul_ps(y, x), _mm512_set1_ps(EXP_P5));
+	y = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(y, z), x), _mm512_set1_ps(1.0f));
+
+	__m512i const bits = _mm512_slli_epi32(
+		_mm512_add_epi32(_mm512_cvttps_epi32(n), _mm512_set1_epi32(127)), 23
+	);
+
+	__m512 const one = _mm512_set1_ps(1.0f);
+	return _mm512_div_ps(one, _mm512_add_ps(one, _mm512_mul_ps(y, _mm512_castsi512_ps(bits))));
+}
+
+void sigmoidAvx512(float * values, std::size_t count) {
+	std::size_t i {0};
+
+	for (; i + WIDTH <= count; i += WIDTH)
+		_mm512_storeu_ps(values + i, sigmoidVector(_mm512_loadu_ps(values + i)));
+
+	if (i < count) {
+		__mmask16 const mask = getTailMask(count - i);
+		_mm512_mask_storeu_ps(values + i, mask,
+		                      sigmoidVector(_mm512_maskz_loadu_ps(mask, values + i)));
+	}
+}
+
+}
+
+bool detail::getAvx512Kernels(KernelTable & table) {
+	table = {Isa::avx512, dotAvx512, axpyAvx512, sigmoidAvx512};
+	return true;
+}
+
+#else
+
+bool detail::getAvx512Kernels(KernelTable &) {
+	return false;
+}
+
+#endif
+
+	}
+}
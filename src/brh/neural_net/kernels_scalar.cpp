@@ -0,0 +1,39 @@
+// Plain C++ kernels, the fallback on every host and the reference the
+// self-test compares the vectorized variants against.
+
+#include "cpu_dispatch.h"
+#include "activation_kernels.h"
+
+namespace brh {
+	namespace neural {
+
+namespace {
+
+float dotScalar(float const * a, float const * b, std::size_t count) {
+	float sum {0};
+
+	for (std::size_t i {0}; i < count; ++i)
+		sum += a[i] * b[i];
+
+	return sum;
+}
+
+void axpyScalar(float a, float const * x, float * y, std::size_t count) {
+	for (std::size_t i {0}; i < count; ++i)
+		y[i] += a * x[i];
+}
+
+void sigmoidScalar(float * values, std::size_t count) {
+	for (std::size_t i {0}; i < count; ++i)
+		values[i] = activation::detail::sigmoidPolynomial(values[i]);
+}
+
+}
+
+bool detail::getScalarKernels(KernelTable & table) {
+	table = {Isa::scalar, dotScalar, axpyScalar, sigmoidScalar};
+	return true;
+}
+
+	}
+}
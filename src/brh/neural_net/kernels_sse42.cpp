@@ -0,0 +1,129 @@
+// SSE4.2 kernels, built with -msse4.2.
+//
+// Only the constants of activation_kernels.h are used here. Calling one of
+// its inline functions would emit a copy built with this file's flags,
+// which the linker is free to pick for the whole program.
+
+#include "cpu_dispatch.h"
+#include "activation_kernels.h"
+
+#ifdef __SSE4_2__
+#include <smmintrin.h>
+#endif
+
+namespace brh {
+	namespace neural {
+
+#ifdef __SSE4_2__
+
+namespace {
+
+using namespace activation::detail;
+
+constexpr std::size_t WIDTH {4};
+
+float horizontalSum(__m128 sums) {
+	float lanes[WIDTH];
+	_mm_storeu_ps(lanes, sums);
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+float dotSse42(float const * a, float const * b, std::size_t count) {
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+
+	std::size_t i {0};
+
+	for (; i + 2 * WIDTH <= count; i += 2 * WIDTH) {
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i),         _mm_loadu_ps(b + i)));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a + i + WIDTH), _mm_loadu_ps(b + i + WIDTH)));
+	}
+
+	float sum {horizontalSum(_mm_add_ps(sum0, sum1))};
+
+	for (; i < count; ++i)
+		sum += a[i] * b[i];
+
+	return sum;
+}
+
+void axpySse42(float a, float const * x, float * y, std::size_t count) {
+	__m128 const scale = _mm_set1_ps(a);
+
+	std::size_t i {0};
+
+	for (; i + WIDTH <= count; i += WIDTH) {
+		_mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i),
+		                                _mm_mul_ps(scale, _mm_loadu_ps(x + i))));
+	}
+
+	for (; i < count; ++i)
+		y[i] += a * x[i];
+}
+
+__m128 sigmoidVector(__m128 x) {
+	// sigmoid(x) = 1 / (1 + exp(-x)), exp as in expPolynomial.
+	x = _mm_sub_ps(_mm_setzero_ps(), x);
+	x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(EXP_MIN)), _mm_set1_ps(EXP_MAX));
+
+	__m128 const n = _mm_floor_ps(
+		_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(LOG2E)), _mm_set1_ps(0.5f))
+	);
+
+	x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(LN2_HIGH)));
+	x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(LN2_LOW)));
+
+	__m128 const z = _mm_mul_ps(x, x);
+	__m128 y = _mm_set1_ps(EXP_P0);
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P1));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P2));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P3));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P4));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P5));
+	y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(y, z), x), _mm_set1_ps(1.0f));
+
+	__m128i const bits = _mm_slli_epi32(
+		_mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(127)), 23
+	);
+
+	__m128 const one = _mm_set1_ps(1.0f);
+	return _mm_div_ps(one, _mm_add_ps(one, _mm_mul_ps(y, _mm_castsi128_ps(bits))));
+}
+
+void sigmoidSse42(float * values, std::size_t count) {
+	std::size_t i {0};
+
+	for (; i + WIDTH <= count; i += WIDTH)
+		_mm_storeu_ps(values + i, sigmoidVector(_mm_loadu_ps(values + i)));
+
+	// The tail goes through a zero padded vector rather than scalar code.
+	if (i < count) {
+		float lanes[WIDTH] {0, 0, 0, 0};
+
+		for (std::size_t j {i}; j < count; ++j)
+			lanes[j - i] = values[j];
+
+		_mm_storeu_ps(lanes, sigmoidVector(_mm_loadu_ps(lanes)));
+
+		for (std::size_t j {i}; j < count; ++j)
+			values[j] = lanes[j - i];
+	}
+}
+
+}
+
+bool detail::getSse42Kernels(KernelTable & table) {
+	table = {Isa::sse42, dotSse42, axpySse42, sigmoidSse42};
+	return true;
+}
+
+#else
+
+bool detail::getSse42Kernels(KernelTable &) {
+	return false;
+}
+
+#endif
+
+	}
+}
@@ -1,141 +1,179 @@
 #include "layered.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <random>
 
+#include "activation_kernels.h"
+#include "cpu_dispatch.h"
+#include "thread_pool.h"
+
 namespace layered {
 
-Node::Node() : Node(ListType()) {}
-Node::Node(ListType weights) : weights_ (std::move(weights)), value_ {0} {}
+constexpr std::size_t Layer::ROW_ALIGNMENT;
+constexpr std::size_t Layer::TASK_WEIGHT_COUNT;
+
+
+Layer::Layer(std::size_t size, std::size_t nextSize) :
+	size_     {size},
+	nextSize_ {nextSize},
+	stride_   {(size + ROW_ALIGNMENT - 1) / ROW_ALIGNMENT * ROW_ALIGNMENT},
+	values_   (size, 0),
+	weights_  (nextSize * stride_, 0) {}
 
-void Node::clearValue() { value_ = 0; }
 
-void Node::setValue(FloatType value) { value_ = value; }
+std::size_t Layer::getSize()     const { return size_; }
+std::size_t Layer::getNextSize() const { return nextSize_; }
+std::size_t Layer::getStride()   const { return stride_; }
 
-void Node::addValue(FloatType value) { value_ += value; }
+FloatType Layer::getValue(std::size_t index) const { return values_[index]; }
 
-FloatType Node::getValue() const { return value_; }
+void Layer::setValue(std::size_t index, FloatType value) { values_[index] = value; }
 
-void Node::applyActivation()
+FloatType const * Layer::getValues() const { return values_.data(); }
+FloatType       * Layer::getValues()       { return values_.data(); }
+
+FloatType Layer::getWeight(std::size_t from, std::size_t to) const
 {
-	value_ = static_cast<FloatType>(1.0 / (1 + std::pow(MATH_E, -value_)));
+	return weights_[to * stride_ + from];
 }
 
-FloatType Node::getWeighted(std::size_t index) const
+FloatType & Layer::getWeight(std::size_t from, std::size_t to)
 {
-	return value_ * weights_.at(index);
+	return weights_[to * stride_ + from];
 }
 
-ListType const & Node::getWeights() const { return weights_; }
-ListType       & Node::getWeights()       { return weights_; }
+FloatType const * Layer::getWeightRow(std::size_t to) const { return &weights_[to * stride_]; }
+FloatType       * Layer::getWeightRow(std::size_t to)       { return &weights_[to * stride_]; }
 
 
+void Layer::propagate(Layer & nextLayer, brh::neural::ThreadPool * pool) const
+{
+	assert(nextLayer.getSize() == nextSize_);
 
-Layer::Layer(NodeList nodes) : nodes_ (std::move(nodes)) {}
+	// Task boundaries fall on whole cache lines of the next layer's
+	// values, so no two tasks write the same line.
+	auto rowsPerTask = std::max<std::size_t>(TASK_WEIGHT_COUNT / std::max<std::size_t>(stride_, 1), 1);
+	rowsPerTask = (rowsPerTask + ROW_ALIGNMENT - 1) / ROW_ALIGNMENT * ROW_ALIGNMENT;
 
+	auto const taskCount = (nextSize_ + rowsPerTask - 1) / rowsPerTask;
 
-void Layer::clearValues()
-{
-	for (auto & i : nodes_)
-		i.clearValue();
-}
+	if (pool == nullptr || taskCount < 2) {
+		for (std::size_t begin {0}; begin < nextSize_; begin += rowsPerTask)
+			propagateRows(nextLayer, begin, std::min(begin + rowsPerTask, nextSize_));
 
+		return;
+	}
 
-void Layer::propagate(Layer & nextLayer)
+	pool->run(taskCount, [&](std::size_t task) {
+		auto const begin = task * rowsPerTask;
+		propagateRows(nextLayer, begin, std::min(begin + rowsPerTask, nextSize_));
+	});
+}
+
+void Layer::propagateRows(Layer & nextLayer, std::size_t begin, std::size_t end) const
 {
-	auto thisSize = nodes_.size();
-	auto nextSize = nextLayer.nodes_.size();
-	for (std::size_t i {0}; i < thisSize; ++i) {
-		assert(nodes_[i].getWeights().size() == nextSize);
+	using namespace brh::neural::activation;
 
-		for (std::size_t j {0}; j < nextSize; ++j) {
-			nextLayer.nodes_[j].addValue(nodes_[i].getWeighted(j));
-		}
-	}
+	auto const dot = brh::neural::getKernels().dot;
+
+	FloatType * sums {nextLayer.getValues()};
+
+	for (std::size_t j {begin}; j < end; ++j)
+		sums[j] = dot(getWeightRow(j), values_.data(), size_);
+
+	sigmoid<Accuracy::polynomial>(sums + begin, end - begin);
 }
 
 void Layer::applyActivation()
 {
-	for (auto & i : nodes_)
-		i.applyActivation();
+	using namespace brh::neural::activation;
+	sigmoid<Accuracy::polynomial>(values_.data(), size_);
 }
 
-NodeList const & Layer::getNodes() const { return nodes_; }
-NodeList       & Layer::getNodes()       { return nodes_; }
 
 
-Node& Layer::getNode(std::size_t index) { return nodes_.at(index); }
+Network::Network(LayerList layers) :
+	layers_ (std::move(layers)),
+	pool_   {nullptr} {}
 
-
-
-Network::Network(LayerList layers) : layers_ (std::move(layers)) {}
-
-void Network::execute(ListType inputValues)
+void Network::execute(ListType const & inputValues)
 {
-	auto & nodeList = layers_[0].getNodes();
+	auto & inputLayer = layers_[0];
 
 	auto size = inputValues.size();
 
-	assert(size == nodeList.size());
+	assert(size == inputLayer.getSize());
 
-	for (std::size_t i {0}; i < size; ++i) {
-		nodeList[i].setValue(inputValues[i]);
-	}
+	std::copy(inputValues.begin(), inputValues.end(), inputLayer.getValues());
 
 	execute();
 }
 
 void Network::execute()
 {
-	for (std::size_t i {1}; i < layers_.size(); ++i) {
-		auto & previous = layers_[i - 1];
-		auto & current  = layers_[i];
+	for (std::size_t i {1}; i < layers_.size(); ++i)
+		layers_[i - 1].propagate(layers_[i], pool_);
+}
 
-		current.clearValues();
-		previous.propagate(current);
-		current.applyActivation();
-	}
+void Network::setThreadPool(brh::neural::ThreadPool * pool) { pool_ = pool; }
 
-	/*auto & previous = *(layers_.end() - 2);
-	auto & current  =   layers_.back();
-
-	current.clearValues();
-	previous.propagate(current);*/
-}
+brh::neural::ThreadPool * Network::getThreadPool() const { return pool_; }
 
 LayerList const & Network::getLayers() const { return layers_; }
 LayerList       & Network::getLayers()       { return layers_; }
 
 
-NodeList generateRandomNodes(std::size_t count, std::size_t connectionCount)
+Layer generateRandomLayer(std::size_t size, std::size_t nextSize)
 {
 	static std::mt19937 randEngine;
 	std::uniform_real_distribution<FloatType> dist {0, 1};
 
-	NodeList nodes;
-
-	for (std::size_t i {0}; i < count; ++i) {
-		ListType weights;
-		weights.resize(connectionCount);
+	Layer layer (size, nextSize);
 
-		for (std::size_t j {0}; j < connectionCount; ++j) {
-			weights[j] = dist(randEngine);
+	// Drawn node by node, as when every node kept its own weights.
+	for (std::size_t i {0}; i < size; ++i) {
+		for (std::size_t j {0}; j < nextSize; ++j) {
+			layer.getWeight(i, j) = dist(randEngine);
 		}
-
-		nodes.emplace_back(std::move(weights));
 	}
 
-	return nodes;
+	return layer;
 }
 
 
+brh::neural::PipelineLayerList getPipelineLayers(Network const & network)
+{
+	brh::neural::PipelineLayerList pipelineLayers;
+
+	auto const & layers = network.getLayers();
+
+	for (std::size_t l {0}; l + 1 < layers.size(); ++l) {
+		Layer const * layer {&layers[l]};
+
+		pipelineLayers.push_back({layer->getSize(), layer->getNextSize(),
+			[layer](FloatType const * values, FloatType * sums) {
+				using namespace brh::neural::activation;
+
+				auto const dot = brh::neural::getKernels().dot;
+
+				for (std::size_t j {0}; j < layer->getNextSize(); ++j)
+					sums[j] = dot(layer->getWeightRow(j), values, layer->getSize());
+
+				sigmoid<Accuracy::polynomial>(sums, layer->getNextSize());
+			}
+		});
+	}
+
+	return pipelineLayers;
+}
+
 Network generateNetwork(std::size_t hiddenLayerCount,
                         std::size_t inputLayerSize,
                         std::size_t hiddenLayerSize,
                         std::size_t outputLayerSize)
 {
-	constexpr std::size_t inputLayerIndex {0};
 	constexpr std::size_t hiddenLayersBegin {1};
 
 	std::size_t const hiddenLayersEnd  {hiddenLayersBegin + hiddenLayerCount};
@@ -146,18 +184,16 @@ Network generateNetwork(std::size_t hiddenLayerCount,
 	LayerList layers;
 	layers.reserve(layerCount);
 
-	layers.emplace_back(generateRandomNodes(inputLayerSize, hiddenLayerSize));
+	layers.emplace_back(generateRandomLayer(inputLayerSize, hiddenLayerSize));
 
 	for (std::size_t i {0}; i < hiddenLayerCount - 1; ++i) {
 		layers.emplace_back(
-			generateRandomNodes(hiddenLayerSize, hiddenLayerSize)
+			generateRandomLayer(hiddenLayerSize, hiddenLayerSize)
 		);
 	}
 
-	layers.emplace_back(generateRandomNodes(hiddenLayerSize, outputLayerSize));
-
-	NodeList outputNodes (outputLayerSize);
-	layers.emplace_back(std::move(outputNodes));
+	layers.emplace_back(generateRandomLayer(hiddenLayerSize, outputLayerSize));
+	layers.emplace_back(outputLayerSize);
 
 	return {std::move(layers)};
 }
@@ -2,54 +2,79 @@
 #define NEURAL_NET_TESTING_LAYERED_H
 
 #include "common.h"
+#include "aligned_allocator.h"
+#include "pipeline.h"
+
+namespace brh {
+	namespace neural {
+		class ThreadPool;
+	}
+}
 
 namespace layered {
 
-class Node
+using ValueList = brh::neural::AlignedList<FloatType>;
+
+
+/// One layer's node values and the weights leading out of it.
+///
+/// The weights form a row-major getNextSize() x getSize() matrix, row j
+/// holding the weights from every node of this layer into node j of the
+/// next. Rows are padded to whole cache lines so each one starts aligned,
+/// and propagate pulls every value of the next layer as one dot product
+/// over a row.
+class Layer
 {
 	public:
-		Node();
-		Node(ListType weights);
+		/// Floats per cache line, the row stride is a multiple of it.
+		static constexpr std::size_t ROW_ALIGNMENT {16};
 
-		void clearValue();
-		void setValue(FloatType value);
-		void addValue(FloatType value);
-		FloatType getValue() const;
+		/// Weights handled by each task when propagate splits its rows
+		/// over a pool.
+		static constexpr std::size_t TASK_WEIGHT_COUNT {32 * 1024};
 
-		void applyActivation();
+		/// @param nextSize Nodes in the next layer, 0 for the output layer.
+		explicit Layer(std::size_t size, std::size_t nextSize = 0);
 
-		FloatType getWeighted(std::size_t index) const;
+		std::size_t getSize()     const;
+		std::size_t getNextSize() const;
 
-		ListType const & getWeights() const;
-		ListType       & getWeights();
+		/// Distance between the starts of consecutive weight rows.
+		std::size_t getStride() const;
 
+		FloatType getValue(std::size_t index) const;
+		void setValue(std::size_t index, FloatType value);
 
-	private:
-		ListType  weights_;
-		FloatType value_;
-};
+		FloatType const * getValues() const;
+		FloatType       * getValues();
 
-using NodeList = std::vector<Node>;
+		/// Weight from node `from` of this layer into node `to` of the next.
+		FloatType   getWeight(std::size_t from, std::size_t to) const;
+		FloatType & getWeight(std::size_t from, std::size_t to);
 
+		/// The getSize() weights leading into node `to` of the next layer.
+		FloatType const * getWeightRow(std::size_t to) const;
+		FloatType       * getWeightRow(std::size_t to);
 
-class Layer
-{
-	public:
-		Layer(NodeList nodes);
+		/// Sets every value of nextLayer to the activated weighted sum of
+		/// this layer's values. Each block of rows is summed and activated
+		/// while it's still in cache, so nothing needs clearing first.
+		/// @param pool Splits the rows when given and the matrix is larger
+		///             than one task, nullptr runs on the calling thread.
+		void propagate(Layer & nextLayer, brh::neural::ThreadPool * pool = nullptr) const;
 
-		void clearValues();
-
-		void propagate(Layer & nextLayer);
 		void applyActivation();
 
-		NodeList const & getNodes() const;
-		NodeList       & getNodes();
 
-		Node & getNode(std::size_t index);
+	private:
+		void propagateRows(Layer & nextLayer, std::size_t begin, std::size_t end) const;
 
+		std::size_t size_;
+		std::size_t nextSize_;
+		std::size_t stride_;
 
-	private:
-		NodeList nodes_;
+		ValueList values_;
+		ValueList weights_;
 };
 
 using LayerList = std::vector<Layer>;
@@ -60,19 +85,32 @@ class Network
 	public:
 		Network(LayerList layers);
 
-		void execute(ListType inputValues);
+		void execute(ListType const & inputValues);
 		void execute();
 
+		/// Pool propagate splits large layers over, nullptr (the default)
+		/// keeps execution on the calling thread. The pool has to outlive
+		/// its use here.
+		void setThreadPool(brh::neural::ThreadPool * pool);
+		brh::neural::ThreadPool * getThreadPool() const;
+
 		LayerList const & getLayers() const;
 		LayerList       & getLayers();
 
 	private:
 		LayerList layers_;
+
+		brh::neural::ThreadPool * pool_;
 };
 
 
-/// @param connectionCount How many connections each node has.
-NodeList generateRandomNodes(std::size_t count, std::size_t connectionCount);
+/// @param nextSize How many connections each node has.
+Layer generateRandomLayer(std::size_t size, std::size_t nextSize);
+
+/// One pipeline layer per weight matrix, each computing what propagate
+/// does. They only read the weights, so the network must outlive them and
+/// its layers must not be resized or trained while they run.
+brh::neural::PipelineLayerList getPipelineLayers(Network const & network);
 
 Network generateNetwork(std::size_t hiddenLayerCount,
                         std::size_t inputLayerSize,
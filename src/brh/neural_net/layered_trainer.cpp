@@ -0,0 +1,261 @@
+#include "layered_trainer.h"
+
+#include <algorithm>
+
+#include "activation_kernels.h"
+#include "cpu_dispatch.h"
+#include "thread_pool.h"
+
+namespace layered {
+
+Trainer::Trainer(Network                 & network,
+                 brh::neural::ThreadPool & pool,
+                 TrainingOptions           options) :
+	network_ (network),
+	pool_    (pool),
+	options_ (options)
+{
+	auto const & layers = network_.getLayers();
+
+	layerOffsets_.push_back(0);
+
+	for (auto const & layer : layers)
+		layerOffsets_.push_back(layerOffsets_.back() + layer.getNextSize() * layer.getStride());
+
+	velocities_.assign(layerOffsets_.back(), 0);
+
+	shards_.resize(pool_.getThreadCount());
+
+	for (auto & shard : shards_) {
+		for (auto const & layer : layers) {
+			shard.activations.emplace_back(layer.getSize(), 0);
+			shard.deltas.emplace_back(layer.getSize(), 0);
+		}
+
+		shard.gradients.assign(layerOffsets_.back(), 0);
+		shard.loss = 0;
+	}
+}
+
+TrainingOptions const & Trainer::getOptions() const { return options_; }
+
+void Trainer::setOptions(TrainingOptions options) { options_ = options; }
+
+
+FloatType Trainer::trainBatch(FloatType const * inputs,
+                              FloatType const * targets,
+                              std::size_t       sampleCount)
+{
+	if (sampleCount == 0)
+		return 0;
+
+	auto const loss = runShards(inputs, targets, sampleCount, true);
+	update(sampleCount);
+
+	return loss / sampleCount;
+}
+
+FloatType Trainer::trainEpoch(FloatType const * inputs,
+                              FloatType const * targets,
+                              std::size_t       sampleCount)
+{
+	auto const inputSize  = network_.getLayers().front().getSize();
+	auto const outputSize = network_.getLayers().back().getSize();
+	auto const batchSize  = std::max<std::size_t>(options_.batchSize, 1);
+
+	double loss {0};
+
+	for (std::size_t begin {0}; begin < sampleCount; begin += batchSize) {
+		auto const count = std::min(batchSize, sampleCount - begin);
+
+		loss += static_cast<double>(trainBatch(
+			inputs + begin * inputSize, targets + begin * outputSize, count
+		)) * count;
+	}
+
+	return sampleCount == 0 ? 0 : static_cast<FloatType>(loss / sampleCount);
+}
+
+FloatType Trainer::evaluate(FloatType const * inputs,
+                            FloatType const * targets,
+                            std::size_t       sampleCount)
+{
+	if (sampleCount == 0)
+		return 0;
+
+	return runShards(inputs, targets, sampleCount, false) / sampleCount;
+}
+
+
+FloatType Trainer::runShards(FloatType const * inputs,
+                             FloatType const * targets,
+                             std::size_t       sampleCount,
+                             bool              train)
+{
+	auto const inputSize  = network_.getLayers().front().getSize();
+	auto const outputSize = network_.getLayers().back().getSize();
+	auto const shardCount = std::min(shards_.size(), sampleCount);
+
+	pool_.run(shardCount, [&](std::size_t s) {
+		auto & shard = shards_[s];
+
+		auto const begin = s * sampleCount / shardCount;
+		auto const end   = (s + 1) * sampleCount / shardCount;
+
+		FloatType loss {0};
+
+		for (auto i = begin; i < end; ++i) {
+			forward(shard, inputs + i * inputSize);
+
+			if (train) {
+				loss += backward(shard, targets + i * outputSize);
+				continue;
+			}
+
+			auto const & outputs = shard.activations.back();
+
+			for (std::size_t o {0}; o < outputSize; ++o) {
+				auto const error = outputs[o] - targets[i * outputSize + o];
+				loss += error * error / 2;
+			}
+		}
+
+		shard.loss = loss;
+	});
+
+	FloatType loss {0};
+
+	for (std::size_t s {0}; s < shardCount; ++s)
+		loss += shards_[s].loss;
+
+	return loss;
+}
+
+void Trainer::forward(Shard & shard, FloatType const * input) const
+{
+	using namespace brh::neural::activation;
+
+	auto const & layers = network_.getLayers();
+	auto const dot = brh::neural::getKernels().dot;
+
+	std::copy(input, input + layers.front().getSize(), shard.activations.front().begin());
+
+	for (std::size_t l {0}; l + 1 < layers.size(); ++l) {
+		auto const & layer  = layers[l];
+		auto const & values = shard.activations[l];
+		auto       & sums   = shard.activations[l + 1];
+
+		for (std::size_t j {0}; j < layer.getNextSize(); ++j)
+			sums[j] = dot(layer.getWeightRow(j), values.data(), layer.getSize());
+
+		sigmoid<Accuracy::polynomial>(sums.data(), sums.size());
+	}
+}
+
+FloatType Trainer::backward(Shard & shard, FloatType const * target) const
+{
+	using namespace brh::neural::activation;
+
+	auto const & layers = network_.getLayers();
+	auto const axpy = brh::neural::getKernels().axpy;
+
+	auto const last = layers.size() - 1;
+	FloatType loss {0};
+
+	{
+		auto const & outputs = shard.activations[last];
+		auto       & deltas  = shard.deltas[last];
+
+		sigmoidDerivative(outputs.data(), deltas.data(), outputs.size());
+
+		for (std::size_t o {0}; o < outputs.size(); ++o) {
+			auto const error = outputs[o] - target[o];
+			loss += error * error / 2;
+			deltas[o] *= error;
+		}
+	}
+
+	for (auto l = last; l-- > 0;) {
+		auto const & layer      = layers[l];
+		auto const & values     = shard.activations[l];
+		auto const & nextDeltas = shard.deltas[l + 1];
+		auto       & deltas     = shard.deltas[l];
+
+		FloatType * gradients {shard.gradients.data() + layerOffsets_[l]};
+
+		// The input layer's deltas aren't needed.
+		bool const propagate {l != 0};
+
+		if (propagate)
+			std::fill(deltas.begin(), deltas.end(), FloatType {0});
+
+		for (std::size_t j {0}; j < layer.getNextSize(); ++j) {
+			auto const delta = nextDeltas[j];
+
+			axpy(delta, values.data(), gradients + j * layer.getStride(), layer.getSize());
+
+			if (propagate)
+				axpy(delta, layer.getWeightRow(j), deltas.data(), layer.getSize());
+		}
+
+		if (propagate) {
+			for (std::size_t i {0}; i < deltas.size(); ++i)
+				deltas[i] *= values[i] * (1 - values[i]);
+		}
+	}
+
+	return loss;
+}
+
+void Trainer::update(std::size_t sampleCount)
+{
+	// Whole cache lines of the flat buffers per task, matching the rows'
+	// alignment so tasks never write the same line.
+	constexpr std::size_t TASK_SIZE {16 * 1024};
+	static_assert(TASK_SIZE % Layer::ROW_ALIGNMENT == 0, "Tasks must cover whole lines");
+
+	auto const total     = layerOffsets_.back();
+	auto const taskCount = (total + TASK_SIZE - 1) / TASK_SIZE;
+
+	auto const scale    = -options_.learningRate / static_cast<FloatType>(sampleCount);
+	auto const momentum = options_.momentum;
+
+	auto & layers = network_.getLayers();
+
+	pool_.run(taskCount, [&](std::size_t task) {
+		auto const begin = task * TASK_SIZE;
+		auto const end   = std::min(begin + TASK_SIZE, total);
+
+		// Shard 0's buffer collects the sum.
+		FloatType * sum {shards_[0].gradients.data()};
+
+		for (std::size_t s {1}; s < shards_.size(); ++s) {
+			FloatType * gradients {shards_[s].gradients.data()};
+
+			for (auto i = begin; i < end; ++i) {
+				sum[i] += gradients[i];
+				gradients[i] = 0;
+			}
+		}
+
+		// Walks the layers the range overlaps.
+		for (std::size_t l {0}; l < layers.size(); ++l) {
+			auto const layerBegin = std::max(begin, layerOffsets_[l]);
+			auto const layerEnd   = std::min(end,   layerOffsets_[l + 1]);
+
+			if (layerBegin >= layerEnd)
+				continue;
+
+			FloatType * weights {layers[l].getWeightRow(0)};
+			auto const offset = layerOffsets_[l];
+
+			for (auto i = layerBegin; i < layerEnd; ++i) {
+				velocities_[i] = momentum * velocities_[i] + scale * sum[i];
+				weights[i - offset] += velocities_[i];
+				sum[i] = 0;
+			}
+		}
+	});
+}
+
+}
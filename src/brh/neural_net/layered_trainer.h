@@ -0,0 +1,108 @@
+#ifndef NEURAL_NET_TESTING_LAYERED_TRAINER_H
+#define NEURAL_NET_TESTING_LAYERED_TRAINER_H
+
+#include "layered.h"
+
+namespace layered {
+
+struct TrainingOptions
+{
+	FloatType   learningRate {0.5f};
+	FloatType   momentum     {0.9f};
+	std::size_t batchSize    {64};
+};
+
+
+/// Minibatch SGD with momentum for a layered::Network, minimizing half the
+/// squared error of the output layer. The forward pass matches
+/// Network::execute and the backward pass uses the sigmoid's derivative
+/// y * (1 - y) at every layer.
+///
+/// Each minibatch is split into one shard per pool thread. A shard runs
+/// forward and backward over its samples with its own activations and
+/// accumulates into its own gradient buffer, laid out like the layers'
+/// weight matrices one after the other. The buffers are then summed in
+/// cache line aligned column ranges, each range applied to the velocities
+/// and weights and cleared in the same pass, so every step updates the
+/// weights once.
+class Trainer
+{
+	public:
+		/// The network and pool are referred to, not copied. The network's
+		/// layer sizes must not change while the trainer is in use.
+		Trainer(Network                 & network,
+		        brh::neural::ThreadPool & pool,
+		        TrainingOptions           options = TrainingOptions());
+
+		TrainingOptions const & getOptions() const;
+		void setOptions(TrainingOptions options);
+
+		/// One update from the mean gradient over sampleCount samples.
+		/// @param inputs  sampleCount rows of input layer size values.
+		/// @param targets sampleCount rows of output layer size values.
+		/// @return Mean loss over the samples, before the update.
+		FloatType trainBatch(FloatType const * inputs,
+		                     FloatType const * targets,
+		                     std::size_t       sampleCount);
+
+		/// trainBatch over consecutive getOptions().batchSize slices of the
+		/// samples, the last one possibly shorter.
+		/// @return Mean loss over the epoch.
+		FloatType trainEpoch(FloatType const * inputs,
+		                     FloatType const * targets,
+		                     std::size_t       sampleCount);
+
+		/// Mean loss over the samples without training, split over the
+		/// pool the same way.
+		FloatType evaluate(FloatType const * inputs,
+		                   FloatType const * targets,
+		                   std::size_t       sampleCount);
+
+
+	private:
+		/// Per thread scratch. Its buffers are allocated separately and the
+		/// loss is only written once per batch, so shards don't contend for
+		/// cache lines.
+		struct Shard
+		{
+			/// Every layer's values for the sample in flight.
+			std::vector<ValueList> activations;
+
+			/// Loss gradients with respect to every layer's sums.
+			std::vector<ValueList> deltas;
+
+			/// Summed over the shard's samples since the last update.
+			ValueList gradients;
+
+			FloatType loss;
+		};
+
+		/// Forward and, when train is set, backward passes over the shards
+		/// of a batch. Returns the summed loss.
+		FloatType runShards(FloatType const * inputs,
+		                    FloatType const * targets,
+		                    std::size_t       sampleCount,
+		                    bool              train);
+
+		void forward(Shard & shard, FloatType const * input) const;
+		FloatType backward(Shard & shard, FloatType const * target) const;
+
+		/// Sums the shards' gradients and applies them.
+		void update(std::size_t sampleCount);
+
+		Network                 & network_;
+		brh::neural::ThreadPool & pool_;
+		TrainingOptions           options_;
+
+		/// Where each layer's weights start in the flat gradient and
+		/// velocity buffers, one past the end last.
+		std::vector<std::size_t> layerOffsets_;
+
+		ValueList velocities_;
+
+		std::vector<Shard> shards_;
+};
+
+}
+
+#endif
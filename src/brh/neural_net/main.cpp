@@ -1,12 +1,15 @@
 #include <iostream>
-#include <random>
 #include <fstream>
 
-//#include "layered.h"
+#include "layered.h"
 #include "activation_functions.h"
+#include "activation_stats.h"
+#include "cpu_dispatch.h"
+#include "image_batch.h"
 
 #include "dynamic/node.h"
 
+#include "constant/model_file.h"
 #include "constant/network.h"
 #include "constant/node.h"
 
@@ -18,53 +21,29 @@ constexpr std::size_t calcImageNodeCount(std::size_t width,
 	return width * height * 3;
 }
 
-template <class T>
-int randomizeGroupWeights(HiddenGroup<T, ::ListInterface> & group,
-                          FloatType min = 0, FloatType max = 1) {
-	static std::mt19937 engine;
-	static std::uniform_real_distribution<FloatType> dist {min, max};
+/// Maps the network from modelPath if it was saved by an earlier run,
+/// otherwise builds and initializes it and saves it there for the next one.
+/// A saved network of other dimensions is replaced.
+template <class NetworkType>
+NetworkType loadOrCreateImageNet(std::string const & modelPath,
+                                 std::size_t         nodeCount) {
+	if (std::ifstream(modelPath).good()) {
+		auto network = loadModel<NetworkType>(modelPath);
 
-	auto nodesPerLayer = group.getNodesPerLayer();
+		if (network.getInputNodeCount()  == nodeCount &&
+		    network.getOutputNodeCount() == nodeCount)
+			return network;
 
-	auto inputNodeCount = group.getInputNodeCount();
-	for (std::size_t j {0}; j < inputNodeCount; ++j) {
-		for (std::size_t k {0}; k < nodesPerLayer; ++k) {
-			*group.getInputWeight(j, k) = dist(engine);
-		}
-	}
-
-	auto nonTerminalLayerCount = group.getNonTerminalLayerCount();
-	for (std::size_t j {0}; j < nonTerminalLayerCount; ++j) {
-		for (std::size_t k {0}; k < nodesPerLayer; ++k) {
-			for (std::size_t l {0}; l < nodesPerLayer; ++l) {
-				*group.getNonTerminalElement(j, k).getWeight(l) = dist(engine);
-			}
-		}
+		std::cerr << "Rebuilding " << modelPath << ", its dimensions don't match\n";
 	}
 
-	for (std::size_t j {0}; j < nodesPerLayer; ++j) {
-		for (std::size_t k {0}; k < group.getOutputNodeCount(); ++k) {
-			*group.getTerminalElement(j).getWeight(k) = dist(engine);
-		}
-	}
-
-	return 0;
-}
-
-template <class T>
-void randomizeWeights(Network<T> & network, FloatType min = 0, FloatType max = 1) {
-	auto hiddenGroupCount = network.getHiddenGroupCount();
-	std::vector<std::future<int> > futureList (hiddenGroupCount);
+	// The stale network, and with it the mapping, is gone before the file
+	// is rewritten.
+	NetworkType network (2, nodeCount, nodeCount, 10, 10);
+	network.initializeWeights(WeightInit::uniform(0, .5));
+	saveModel(network, modelPath);
 
-	for (std::size_t i {0}; i < hiddenGroupCount; ++i) {
-		futureList[i] = std::async(
-			std::launch::async, randomizeGroupWeights<T>,
-			std::ref(network.getHiddenGroup(i)), min, max
-		);
-	}
-
-	for (auto & i : futureList)
-		i.get();
+	return network;
 }
 
 int main(int argc, char * argv[])
@@ -98,7 +77,7 @@ int main(int argc, char * argv[])
 
 	std::cout << net2.getLayers().back().getNode(0).getValue() << '\n';*/
 
-	using Net = Network<Node, ::ListInterface>;
+	using Net = DenseNetwork<Node, ::ListInterface, Sigmoid<> >;
 
 	/*Net net {4, 10, 10, 2};
 
@@ -144,7 +123,7 @@ int main(int argc, char * argv[])
 	std::cout << needed << ' ' << index << '\n';*/
 
 	/*Net net (2, 1, 1, 2, 1);
-	randomizeWeights(net);
+	net.initializeWeights(WeightInit::uniform(0, 1));
 
 	net.getInputNode(0).setValue(0.1);
 
@@ -175,14 +154,91 @@ int main(int argc, char * argv[])
 
 	//net.execute(softStep);
 
+	// Bulk mode:
+	//  --batch <files or directories...> [--batch-size N] [--output FILE]
+	//          [--int8]
+	// --int8 calibrates an int8 copy of the network on the first batch and
+	// runs that instead.
+	PathList batchPaths;
+	std::size_t batchSize {64};
+	std::string outputPath {"batch_out.data"};
+	bool quantize {false};
+	bool selfTest {false};
+
+	{
+		bool inBatch {false};
+
+		for (int i {1}; i < argc; ++i) {
+			std::string const arg {argv[i]};
+			bool const isOption {arg.compare(0, 2, "--") == 0};
+
+			if (isOption)
+				inBatch = false;
+
+			if (arg == "--self-test-kernels")
+				selfTest = true;
+			else if (arg == "--batch")
+				inBatch = true;
+			else if (arg == "--int8")
+				quantize = true;
+			else if (arg == "--batch-size" && i + 1 < argc)
+				batchSize = std::max<std::size_t>(std::stoul(argv[++i]), 1);
+			else if (arg == "--output" && i + 1 < argc)
+				outputPath = argv[++i];
+			else if (inBatch && !isOption)
+				batchPaths.push_back(arg);
+			else {
+				std::cerr << "Unknown argument " << arg << '\n';
+				return 1;
+			}
+		}
+	}
+
+	if (selfTest)
+		return runKernelSelfTest(std::cout) ? 0 : 1;
+
 	constexpr std::size_t WIDTH  {100};
 	constexpr std::size_t HEIGHT {100};
 	constexpr std::size_t NODE_COUNT {calcImageNodeCount(WIDTH, HEIGHT)};
 
-	std::ifstream inFile ("image1.data", std::ios::binary);
+	auto bigNet = loadOrCreateImageNet<Net>("image_net.model", NODE_COUNT);
+
+	if (!batchPaths.empty()) {
+		auto const files = listImageFiles(batchPaths);
+		BatchStats stats;
+
+		if (quantize) {
+			ImageBatch calibration {batchSize, bigNet.getInputNodeCount()};
+			calibration.load(files, 0);
 
-	Net bigNet (2, NODE_COUNT, NODE_COUNT, 10, 10);
-	randomizeWeights(bigNet, 0, .5);
+			auto const samples = calibration.getValues();
+			Net::FloatList const sampleList (
+				samples, samples + calibration.getCount() * calibration.getImageSize()
+			);
+
+			QuantizationReport report {};
+			auto quantizedNet = quantizeNetwork(
+				bigNet, sampleList, calibration.getCount(),
+				QuantizationScale::perRow, &report
+			);
+
+			// Nothing was measured without calibration samples.
+			if (calibration.getCount() > 0)
+				report.print(std::cout);
+
+			stats = processImageBatches(quantizedNet, files, batchSize, outputPath);
+		}
+		else {
+			stats = processImageBatches(bigNet, files, batchSize, outputPath);
+		}
+
+		std::cout << stats.imageCount << " images in " << stats.seconds << " s, "
+		          << stats.getImagesPerSecond() << " images/s\n";
+
+		return 0;
+	}
+
+	std::ifstream inFile ("image1.data", std::ios::binary);
 
 	{
 		std::size_t i {0};
@@ -193,7 +249,12 @@ int main(int argc, char * argv[])
 		}
 	}
 
-	bigNet.execute(softStep);
+	ActivationTracer::setSampleRate(64);
+
+	bigNet.execute();
+
+	if (ActivationTracer::COMPILED_IN)
+		ActivationTracer::dump(std::cout);
 
 	std::ofstream outFile("image1_out.data", std::ios::binary);
 
@@ -0,0 +1,99 @@
+#ifndef NEURAL_NET_TESTING_PHILOX_H
+#define NEURAL_NET_TESTING_PHILOX_H
+
+#include <cmath>
+#include <cstdint>
+
+namespace brh {
+	namespace neural {
+
+/// Philox4x32-10 counter-based generator (Salmon et al., "Parallel random
+/// numbers: as easy as 1, 2, 3"). Every 128-bit counter maps to four
+/// random words under a 64-bit key with no state in between, so any
+/// element of a stream can be computed directly and in any order.
+class Philox4x32
+{
+	public:
+		struct Block
+		{
+			std::uint32_t words[4];
+		};
+
+		static constexpr std::size_t ROUND_COUNT {10};
+
+		explicit Philox4x32(std::uint64_t key) :
+			key0_ {static_cast<std::uint32_t>(key)},
+			key1_ {static_cast<std::uint32_t>(key >> 32)} {}
+
+		Block operator()(std::uint32_t counter0,
+		                 std::uint32_t counter1,
+		                 std::uint32_t counter2,
+		                 std::uint32_t counter3) const {
+			Block block {{counter0, counter1, counter2, counter3}};
+
+			std::uint32_t key0 {key0_};
+			std::uint32_t key1 {key1_};
+
+			for (std::size_t i {0}; i < ROUND_COUNT; ++i) {
+				if (i != 0) {
+					key0 += WEYL0;
+					key1 += WEYL1;
+				}
+
+				round(block, key0, key1);
+			}
+
+			return block;
+		}
+
+		/// [0, 1) with 24 random bits.
+		static float toUniform(std::uint32_t word) {
+			return static_cast<float>(word >> 8) * (1.0f / 16777216.0f);
+		}
+
+		/// (0, 1], safe to take the log of.
+		static float toUniformNonZero(std::uint32_t word) {
+			return static_cast<float>((word >> 8) + 1) * (1.0f / 16777216.0f);
+		}
+
+		/// Two standard normal values from two words, Box-Muller.
+		static void toNormalPair(std::uint32_t   word0,
+		                         std::uint32_t   word1,
+		                         float         & normal0,
+		                         float         & normal1) {
+			float const radius {std::sqrt(-2.0f * std::log(toUniformNonZero(word0)))};
+			float const angle  {TWO_PI * toUniform(word1)};
+
+			normal0 = radius * std::cos(angle);
+			normal1 = radius * std::sin(angle);
+		}
+
+
+	private:
+		static constexpr std::uint32_t MULTIPLIER0 {0xd2511f53};
+		static constexpr std::uint32_t MULTIPLIER1 {0xcd9e8d57};
+		static constexpr std::uint32_t WEYL0       {0x9e3779b9};
+		static constexpr std::uint32_t WEYL1       {0xbb67ae85};
+
+		static constexpr float TWO_PI {6.28318530717958647692f};
+
+		static void round(Block & block, std::uint32_t key0, std::uint32_t key1) {
+			std::uint64_t const product0 {static_cast<std::uint64_t>(MULTIPLIER0) * block.words[0]};
+			std::uint64_t const product1 {static_cast<std::uint64_t>(MULTIPLIER1) * block.words[2]};
+
+			block = {{
+				static_cast<std::uint32_t>(product1 >> 32) ^ block.words[1] ^ key0,
+				static_cast<std::uint32_t>(product1),
+				static_cast<std::uint32_t>(product0 >> 32) ^ block.words[3] ^ key1,
+				static_cast<std::uint32_t>(product0)
+			}};
+		}
+
+		std::uint32_t key0_;
+		std::uint32_t key1_;
+};
+
+	}
+}
+
+#endif
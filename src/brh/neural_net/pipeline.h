@@ -0,0 +1,542 @@
+#ifndef NEURAL_NET_TESTING_PIPELINE_H
+#define NEURAL_NET_TESTING_PIPELINE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+#include "common.h"
+
+namespace brh {
+	namespace neural {
+
+/// One layer of a network as the pipeline sees it.
+struct PipelineLayer
+{
+	std::size_t inputSize;
+	std::size_t outputSize;
+
+	/// Writes the layer's outputSize activated values from inputSize
+	/// values. Has to be safe to call while other layers' functions run
+	/// on other threads, so it may only read state shared with them.
+	std::function<void(FloatType const *, FloatType *)> run;
+};
+
+using PipelineLayerList = std::vector<PipelineLayer>;
+
+
+/// Bounded single-producer, single-consumer queue of activation vectors.
+/// Slots are allocated up front and filled in place: the producer fills
+/// getBack() and calls push, the consumer reads getFront() and calls pop.
+/// waitBack and waitFront poll briefly and then sleep until the other side
+/// pushes or pops, so an idle end doesn't hold on to a core.
+class SpscRing
+{
+	public:
+		struct Slot
+		{
+			ListType    values;
+			std::size_t sampleIndex;
+
+			std::chrono::steady_clock::time_point submitTime;
+		};
+
+		/// Polls made before a waiting thread goes to sleep.
+		static constexpr std::size_t SPIN_COUNT {1 << 14};
+
+		SpscRing(std::size_t capacity, std::size_t width) :
+			slots_    (std::max<std::size_t>(capacity, 1)),
+			head_     {0},
+			tail_     {0},
+			sleepers_ {0} {
+			for (auto & slot : slots_)
+				slot.values.resize(width);
+		}
+
+		std::size_t getCapacity() const { return slots_.size(); }
+
+		/// Producer side, nullptr while the ring is full.
+		Slot * getBack() {
+			auto const tail = tail_.value.load(std::memory_order_relaxed);
+
+			if (tail - head_.value.load(std::memory_order_acquire) == slots_.size())
+				return nullptr;
+
+			return &slots_[tail % slots_.size()];
+		}
+
+		void push() {
+			tail_.value.store(tail_.value.load(std::memory_order_relaxed) + 1,
+			                  std::memory_order_release);
+			notify();
+		}
+
+		/// getBack, waiting for room. nullptr once stopping is set.
+		Slot * waitBack(std::atomic<bool> const & stopping) {
+			return wait([this] { return getBack(); }, stopping);
+		}
+
+		/// Consumer side, nullptr while the ring is empty.
+		Slot * getFront() {
+			auto const head = head_.value.load(std::memory_order_relaxed);
+
+			if (head == tail_.value.load(std::memory_order_acquire))
+				return nullptr;
+
+			return &slots_[head % slots_.size()];
+		}
+
+		void pop() {
+			head_.value.store(head_.value.load(std::memory_order_relaxed) + 1,
+			                  std::memory_order_release);
+			notify();
+		}
+
+		/// getFront, waiting for a slot. nullptr once stopping is set.
+		Slot * waitFront(std::atomic<bool> const & stopping) {
+			return wait([this] { return getFront(); }, stopping);
+		}
+
+		/// Wakes both ends, for them to see a stopping flag just set.
+		void wake() {
+			std::lock_guard<std::mutex> guard (mutex_);
+			condition_.notify_all();
+		}
+
+
+	private:
+		/// Padded to a cache line so the producer's and consumer's counters
+		/// never share one. Padding rather than alignas, which new only
+		/// honours from C++17.
+		struct Counter
+		{
+			Counter(std::size_t initial) : value {initial} {}
+
+			std::atomic<std::size_t> value;
+
+			char padding[64 - sizeof(std::atomic<std::size_t>)];
+		};
+
+		template <class Poll>
+		Slot * wait(Poll poll, std::atomic<bool> const & stopping) {
+			for (std::size_t i {0}; i < SPIN_COUNT; ++i) {
+				if (auto slot = poll())
+					return slot;
+
+				if (stopping.load(std::memory_order_acquire))
+					return nullptr;
+			}
+
+			std::unique_lock<std::mutex> lock (mutex_);
+
+			// Announced before polling again, and push and pop check for
+			// sleepers after publishing, so either this poll sees the
+			// change or the other side sees the sleeper and notifies.
+			sleepers_.fetch_add(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			Slot * slot;
+
+			condition_.wait(lock, [&] {
+				slot = poll();
+				return slot != nullptr || stopping.load(std::memory_order_acquire);
+			});
+
+			sleepers_.fetch_sub(1, std::memory_order_relaxed);
+
+			return slot;
+		}
+
+		void notify() {
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			if (sleepers_.load(std::memory_order_relaxed) != 0)
+				wake();
+		}
+
+		std::vector<Slot> slots_;
+
+		Counter head_;
+		Counter tail_;
+
+		/// Threads asleep on condition_, at most one per end.
+		std::atomic<std::size_t> sleepers_;
+		std::mutex               mutex_;
+		std::condition_variable  condition_;
+};
+
+
+struct PipelineStats
+{
+	std::size_t sampleCount;
+	double      seconds;
+
+	/// Submit to receive time of every sample, in seconds.
+	std::vector<double> latencies;
+
+	double getThroughput() const {
+		return seconds == 0 ? 0 : sampleCount / seconds;
+	}
+
+	/// @param fraction In [0, 1], .5 for the median.
+	double getLatencyPercentile(double fraction) const {
+		if (latencies.empty())
+			return 0;
+
+		auto sorted = latencies;
+		auto const index = std::min(
+			static_cast<std::size_t>(fraction * sorted.size()), sorted.size() - 1
+		);
+
+		std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+		return sorted[index];
+	}
+};
+
+
+/// Streams samples through a network one layer range (stage) per thread.
+///
+/// Each stage runs on its own thread and hands its output to the next
+/// stage through an SpscRing, so stage k works on sample i while stage
+/// k + 1 works on sample i - 1 and throughput is set by the slowest stage.
+/// The stage boundaries are chosen from each layer's cost, measured when
+/// the pipeline is built, to keep the stages' total costs as even as
+/// contiguous ranges allow.
+///
+/// One thread submits and receives. Samples come out in submission order.
+/// Stages with nothing to do sleep after a short spin, so a pipeline
+/// waiting for input costs no CPU time.
+class StreamingPipeline
+{
+	public:
+		static constexpr std::size_t DEFAULT_CAPACITY {4};
+
+		/// Calls of each layer timed to measure its cost.
+		static constexpr std::size_t COST_SAMPLE_COUNT {16};
+
+		/// @param stageCount Threads to run, at most one per layer.
+		/// @param capacity   Vectors each ring between stages holds.
+		/// @param pinThreads Binds stage s to core s + 1 modulo the core
+		///                   count where supported, leaving core 0 to the
+		///                   submitting thread.
+		StreamingPipeline(PipelineLayerList layers,
+		                  std::size_t       stageCount,
+		                  std::size_t       capacity   = DEFAULT_CAPACITY,
+		                  bool              pinThreads = false) :
+			layers_   (std::move(layers)),
+			stopping_ {false} {
+			if (layers_.empty())
+				throw std::invalid_argument("Pipeline needs at least one layer");
+
+			for (std::size_t l {1}; l < layers_.size(); ++l) {
+				if (layers_[l].inputSize != layers_[l - 1].outputSize)
+					throw std::invalid_argument("Pipeline layer sizes don't chain");
+			}
+
+			measureLayerCosts();
+			partitionStages(std::min(std::max<std::size_t>(stageCount, 1), layers_.size()));
+
+			// Ring s feeds stage s, the last one holds the outputs.
+			for (std::size_t s {0}; s <= getStageCount(); ++s) {
+				auto const width = s == getStageCount() ?
+					layers_.back().outputSize : layers_[stageBegins_[s]].inputSize;
+
+				rings_.emplace_back(new SpscRing(capacity, width));
+			}
+
+			for (std::size_t s {0}; s < getStageCount(); ++s) {
+				threads_.emplace_back(&StreamingPipeline::runStage, this, s);
+
+				if (pinThreads)
+					pinThread(threads_.back(), s + 1);
+			}
+		}
+
+		StreamingPipeline(StreamingPipeline const &) = delete;
+		StreamingPipeline & operator=(StreamingPipeline const &) = delete;
+
+		~StreamingPipeline() {
+			stopping_.store(true, std::memory_order_release);
+
+			for (auto & ring : rings_)
+				ring->wake();
+
+			for (auto & thread : threads_)
+				thread.join();
+		}
+
+		std::size_t getLayerCount() const { return layers_.size(); }
+		std::size_t getStageCount() const { return stageBegins_.size() - 1; }
+
+		std::size_t getInputSize()  const { return layers_.front().inputSize; }
+		std::size_t getOutputSize() const { return layers_.back().outputSize; }
+
+		/// Layers [getStageBegin(s), getStageBegin(s + 1)) make up stage s.
+		std::size_t getStageBegin(std::size_t stage) const { return stageBegins_[stage]; }
+
+		/// Measured seconds per call of each layer.
+		std::vector<double> const & getLayerCosts() const { return layerCosts_; }
+
+		double getStageCost(std::size_t stage) const {
+			double cost {0};
+
+			for (auto l = stageBegins_[stage]; l < stageBegins_[stage + 1]; ++l)
+				cost += layerCosts_[l];
+
+			return cost;
+		}
+
+		/// Queues getInputSize() values, false if the first stage's ring is
+		/// full.
+		bool trySubmit(FloatType const * input) {
+			auto slot = rings_.front()->getBack();
+
+			if (slot == nullptr)
+				return false;
+
+			std::copy(input, input + getInputSize(), slot->values.begin());
+			slot->sampleIndex = submitted_++;
+			slot->submitTime  = Clock::now();
+
+			rings_.front()->push();
+			return true;
+		}
+
+		void submit(FloatType const * input) {
+			rings_.front()->waitBack(stopping_);
+
+			trySubmit(input);
+		}
+
+		/// Takes the oldest finished sample's getOutputSize() values, false
+		/// if none is ready.
+		/// @param latency Set to the sample's submit to receive time in
+		///                seconds when given.
+		bool tryReceive(FloatType * output, double * latency = nullptr) {
+			auto slot = rings_.back()->getFront();
+
+			if (slot == nullptr)
+				return false;
+
+			std::copy(slot->values.begin(), slot->values.end(), output);
+
+			if (latency != nullptr)
+				*latency = std::chrono::duration<double>(Clock::now() - slot->submitTime).count();
+
+			rings_.back()->pop();
+			return true;
+		}
+
+		/// Waits for a sample to finish, at least one must be in flight.
+		void receive(FloatType * output, double * latency = nullptr) {
+			rings_.back()->waitFront(stopping_);
+
+			tryReceive(output, latency);
+		}
+
+		/// Streams sampleCount input rows through, submitting whenever the
+		/// first ring has room so every stage stays busy, and writes the
+		/// output rows in order. Finished samples are taken as soon as the
+		/// submitting thread gets to them, it only waits when it can't
+		/// submit. Nothing may be in flight when called.
+		PipelineStats process(FloatType const * inputs,
+		                      std::size_t       sampleCount,
+		                      FloatType       * outputs) {
+			PipelineStats stats {sampleCount, 0, {}};
+			stats.latencies.resize(sampleCount);
+
+			auto const start = Clock::now();
+
+			std::size_t submitted {0};
+			std::size_t received  {0};
+
+			auto const receiveInto = [&](bool wait) {
+				auto const output  = outputs + received * getOutputSize();
+				auto const latency = &stats.latencies[received];
+
+				if (wait)
+					receive(output, latency);
+				else if (!tryReceive(output, latency))
+					return false;
+
+				++received;
+				return true;
+			};
+
+			while (received < sampleCount) {
+				while (received < submitted && receiveInto(false)) {}
+
+				if (submitted < sampleCount && trySubmit(inputs + submitted * getInputSize())) {
+					++submitted;
+					continue;
+				}
+
+				// The first ring is full or everything is submitted, either
+				// way a sample is in flight.
+				if (received < sampleCount)
+					receiveInto(true);
+			}
+
+			stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+			return stats;
+		}
+
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		void measureLayerCosts() {
+			std::size_t width {0};
+
+			for (auto const & layer : layers_)
+				width = std::max({width, layer.inputSize, layer.outputSize});
+
+			ListType input  (width, .5f);
+			ListType output (width);
+
+			layerCosts_.clear();
+
+			for (auto const & layer : layers_) {
+				// The first call warms the caches.
+				layer.run(input.data(), output.data());
+
+				auto const start = Clock::now();
+
+				for (std::size_t i {0}; i < COST_SAMPLE_COUNT; ++i)
+					layer.run(input.data(), output.data());
+
+				layerCosts_.push_back(
+					std::chrono::duration<double>(Clock::now() - start).count() / COST_SAMPLE_COUNT
+				);
+			}
+		}
+
+		/// Splits the layers into stageCount contiguous ranges minimizing
+		/// the most expensive range, by dynamic programming over
+		/// (stages, layers) prefixes.
+		void partitionStages(std::size_t stageCount) {
+			auto const layerCount = layers_.size();
+
+			std::vector<double> prefix (layerCount + 1, 0);
+
+			for (std::size_t l {0}; l < layerCount; ++l)
+				prefix[l + 1] = prefix[l] + layerCosts_[l];
+
+			auto const infinity = std::numeric_limits<double>::infinity();
+
+			// best[s][l], the least maximum stage cost of the first l layers
+			// in s stages, split[s][l] where its last stage begins.
+			std::vector<std::vector<double> >      best  (stageCount + 1, std::vector<double>(layerCount + 1, infinity));
+			std::vector<std::vector<std::size_t> > split (stageCount + 1, std::vector<std::size_t>(layerCount + 1, 0));
+
+			best[0][0] = 0;
+
+			for (std::size_t s {1}; s <= stageCount; ++s) {
+				for (auto l = s; l <= layerCount; ++l) {
+					for (auto begin = s - 1; begin < l; ++begin) {
+						auto const cost = std::max(best[s - 1][begin], prefix[l] - prefix[begin]);
+
+						if (cost < best[s][l]) {
+							best[s][l]  = cost;
+							split[s][l] = begin;
+						}
+					}
+				}
+			}
+
+			stageBegins_.assign(stageCount + 1, layerCount);
+
+			for (auto s = stageCount, l = layerCount; s > 0; --s) {
+				l = split[s][l];
+				stageBegins_[s - 1] = l;
+			}
+		}
+
+		static void pinThread(std::thread & thread, std::size_t core) {
+#ifdef __linux__
+			cpu_set_t cpus;
+			CPU_ZERO(&cpus);
+			CPU_SET(core % std::max(std::thread::hardware_concurrency(), 1u), &cpus);
+			pthread_setaffinity_np(thread.native_handle(), sizeof cpus, &cpus);
+#else
+			(void)thread;
+			(void)core;
+#endif
+		}
+
+		/// Moves samples from ring stage to ring stage + 1 through the
+		/// stage's layers, ping-ponging between two scratch vectors in
+		/// between.
+		void runStage(std::size_t stage) {
+			auto & input  = *rings_[stage];
+			auto & output = *rings_[stage + 1];
+
+			auto const begin = stageBegins_[stage];
+			auto const end   = stageBegins_[stage + 1];
+
+			std::size_t width {0};
+
+			for (auto l = begin; l < end; ++l)
+				width = std::max(width, layers_[l].outputSize);
+
+			ListType scratch[2] {ListType(width), ListType(width)};
+
+			while (true) {
+				auto const from = input.waitFront(stopping_);
+
+				if (from == nullptr)
+					return;
+
+				auto const to = output.waitBack(stopping_);
+
+				if (to == nullptr)
+					return;
+
+				FloatType const * values {from->values.data()};
+
+				for (auto l = begin; l < end; ++l) {
+					FloatType * result {l + 1 == end ? to->values.data() : scratch[(l - begin) % 2].data()};
+
+					layers_[l].run(values, result);
+					values = result;
+				}
+
+				to->sampleIndex = from->sampleIndex;
+				to->submitTime  = from->submitTime;
+
+				output.push();
+				input.pop();
+			}
+		}
+
+		PipelineLayerList   layers_;
+		std::vector<double> layerCosts_;
+
+		/// Stage s is layers [stageBegins_[s], stageBegins_[s + 1]).
+		std::vector<std::size_t> stageBegins_;
+
+		std::vector<std::unique_ptr<SpscRing> > rings_;
+		std::vector<std::thread>                threads_;
+		std::atomic<bool>                       stopping_;
+
+		/// Only touched by the submitting thread.
+		std::size_t submitted_ {0};
+};
+
+	}
+}
+
+#endif
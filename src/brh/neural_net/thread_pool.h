@@ -0,0 +1,197 @@
+#ifndef NEURAL_NET_TESTING_THREAD_POOL_H
+#define NEURAL_NET_TESTING_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace brh {
+	namespace neural {
+
+/// Long-lived set of worker threads for fork-join style work.
+/// run() hands out task indices to the workers and the calling thread,
+/// then blocks until every index has been processed. Nothing is allocated
+/// per run; workers spin briefly before sleeping so back-to-back runs
+/// (one per inference) don't pay for a full wake-up each time.
+class ThreadPool
+{
+	public:
+		/// @param threadCount Total threads taking part in a run,
+		///                    including the caller. 0 picks one per core.
+		explicit ThreadPool(std::size_t threadCount = 0) :
+			generation_    {0},
+			activeWorkers_ {0},
+			stopping_      {false},
+			taskFunc_      {nullptr},
+			taskContext_   {nullptr},
+			taskCount_     {0},
+			nextTask_      {0} {
+			if (threadCount == 0)
+				threadCount = getHardwareThreadCount();
+
+			workers_.reserve(threadCount - 1);
+
+			for (std::size_t i {1}; i < threadCount; ++i) {
+				workers_.emplace_back(&ThreadPool::workerLoop, this);
+			}
+		}
+
+		ThreadPool(ThreadPool const &) = delete;
+		ThreadPool & operator=(ThreadPool const &) = delete;
+
+		~ThreadPool() {
+			{
+				std::lock_guard<std::mutex> guard (mutex_);
+				stopping_ = true;
+			}
+
+			startCondition_.notify_all();
+
+			for (auto & i : workers_)
+				i.join();
+		}
+
+		/// Threads taking part in a run, the caller included.
+		std::size_t getThreadCount() const {
+			return workers_.size() + 1;
+		}
+
+		/// Calls func(i) once for every i in [0, taskCount) and returns once
+		/// all calls have finished. Concurrent callers are serialized.
+		/// Must not be called from inside one of its own tasks.
+		template <class Func>
+		void run(std::size_t taskCount, Func && func) {
+			using FuncType = typename std::remove_reference<Func>::type;
+
+			if (taskCount == 0)
+				return;
+
+			if (taskCount == 1 || workers_.empty()) {
+				for (std::size_t i {0}; i < taskCount; ++i)
+					func(i);
+
+				return;
+			}
+
+			std::lock_guard<std::mutex> runGuard (runMutex_);
+
+			{
+				std::unique_lock<std::mutex> lock (mutex_);
+
+				// A worker that slept through the previous run may still be
+				// leaving it, wait so it can't claim one of the new indices.
+				doneCondition_.wait(lock, [this] {
+					return activeWorkers_.load() == 0;
+				});
+
+				taskFunc_    = &invokeTask<FuncType>;
+				taskContext_ = static_cast<void *>(&func);
+				taskCount_   = taskCount;
+				nextTask_.store(0);
+				generation_.fetch_add(1, std::memory_order_release);
+			}
+
+			startCondition_.notify_all();
+
+			processTasks(taskFunc_, taskContext_, taskCount_);
+
+			for (std::size_t i {0}; i < SPIN_COUNT; ++i) {
+				if (activeWorkers_.load(std::memory_order_acquire) == 0)
+					return;
+			}
+
+			std::unique_lock<std::mutex> lock (mutex_);
+			doneCondition_.wait(lock, [this] {
+				return activeWorkers_.load() == 0;
+			});
+		}
+
+		static std::size_t getHardwareThreadCount() {
+			auto count = std::thread::hardware_concurrency();
+			return count == 0 ? 1 : count;
+		}
+
+
+	private:
+		using TaskFunc = void (*)(void *, std::size_t);
+
+		/// Polls made on the generation counter before a worker goes to sleep.
+		static constexpr std::size_t SPIN_COUNT {1 << 14};
+
+		template <class Func>
+		static void invokeTask(void * context, std::size_t index) {
+			(*static_cast<Func *>(context))(index);
+		}
+
+		void processTasks(TaskFunc func, void * context, std::size_t count) {
+			std::size_t index;
+
+			while ((index = nextTask_.fetch_add(1)) < count) {
+				func(context, index);
+			}
+		}
+
+		void workerLoop() {
+			std::size_t seenGeneration {0};
+
+			while (true) {
+				for (std::size_t i {0}; i < SPIN_COUNT; ++i) {
+					if (generation_.load(std::memory_order_acquire) != seenGeneration)
+						break;
+				}
+
+				TaskFunc    func;
+				void      * context;
+				std::size_t count;
+
+				{
+					std::unique_lock<std::mutex> lock (mutex_);
+					startCondition_.wait(lock, [&] {
+						return stopping_ || generation_.load() != seenGeneration;
+					});
+
+					if (stopping_)
+						return;
+
+					seenGeneration = generation_.load();
+					activeWorkers_.fetch_add(1);
+
+					func    = taskFunc_;
+					context = taskContext_;
+					count   = taskCount_;
+				}
+
+				processTasks(func, context, count);
+
+				if (activeWorkers_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+					std::lock_guard<std::mutex> guard (mutex_);
+					doneCondition_.notify_all();
+				}
+			}
+		}
+
+
+		std::mutex              runMutex_;
+		std::mutex              mutex_;
+		std::condition_variable startCondition_;
+		std::condition_variable doneCondition_;
+
+		std::atomic<std::size_t> generation_;
+		std::atomic<std::size_t> activeWorkers_;
+		bool                     stopping_;
+
+		TaskFunc                 taskFunc_;
+		void                   * taskContext_;
+		std::size_t              taskCount_;
+		std::atomic<std::size_t> nextTask_;
+
+		std::vector<std::thread> workers_;
+};
+
+	}
+}
+
+#endif